@@ -8,6 +8,7 @@
 #include "abyss.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <queue>
@@ -52,6 +53,7 @@
 #include "stringutil.h"
 #include "terrain.h"
 #include "rltiles/tiledef-dngn.h"
+#include "threads.h"
 #include "tileview.h"
 #include "timed-effects.h"
 #include "traps.h"
@@ -67,9 +69,21 @@ abyss_state abyssal_state;
 
 static ProceduralLayout *abyssLayout = nullptr, *levelLayout = nullptr;
 
-typedef priority_queue<ProceduralSample, vector<ProceduralSample>, ProceduralSamplePQCompare> sample_queue;
+// A priority queue whose entries can be looked over without popping them.
+class sample_queue : public priority_queue<ProceduralSample,
+                                           vector<ProceduralSample>,
+                                           ProceduralSamplePQCompare>
+{
+public:
+    using priority_queue::priority_queue;
+    const vector<ProceduralSample> &entries() const { return c; }
+};
 
 static sample_queue abyss_sample_queue;
+// Samples worked out ahead of time by _prefetch_abyss_samples() for the
+// cells _abyss_apply_terrain() is about to update, indexed by map position.
+static FixedArray<int, GXM, GYM> abyss_prefetch_index(-1);
+static vector<ProceduralSample> abyss_prefetched;
 static vector<dungeon_feature_type> abyssal_features;
 static list<monster*> displaced_monsters;
 
@@ -1119,17 +1133,8 @@ const static RiverLayout rivers(1800, baseLayout);
 // This one is not fixed: [0] is a level pulled from the current game
 static vector<const ProceduralLayout*> complex_vec(2);
 
-static ProceduralSample _abyss_grid(const coord_def &p)
+static const ProceduralLayout &_abyss_layout()
 {
-    const coord_def pt = p + abyssal_state.major_coord;
-
-    if (_in_wastes(pt))
-    {
-        ProceduralSample sample = wastes(pt, abyssal_state.depth);
-        abyss_sample_queue.push(sample);
-        return sample;
-    }
-
     if (abyssLayout == nullptr)
     {
         const level_id lid = _get_random_level();
@@ -1143,14 +1148,99 @@ static ProceduralSample _abyss_grid(const coord_def &p)
             vault_list.push_back("base: " + lid.describe(false));
         }
     }
+    return *abyssLayout;
+}
+
+static ProceduralSample _abyss_grid(const coord_def &p)
+{
+    if (in_bounds(p) && abyss_prefetch_index(p) >= 0)
+    {
+        const ProceduralSample &sample =
+            abyss_prefetched[abyss_prefetch_index(p)];
+        abyss_sample_queue.push(sample);
+        return sample;
+    }
+
+    const coord_def pt = p + abyssal_state.major_coord;
+
+    if (_in_wastes(pt))
+    {
+        ProceduralSample sample = wastes(pt, abyssal_state.depth);
+        abyss_sample_queue.push(sample);
+        return sample;
+    }
 
-    const ProceduralSample sample = (*abyssLayout)(pt, abyssal_state.depth);
+    const ProceduralSample sample = _abyss_layout()(pt, abyssal_state.depth);
     ASSERT(sample.feat() > DNGN_UNSEEN);
 
     abyss_sample_queue.push(sample);
     return sample;
 }
 
+// Don't bother with threads for fewer points than this each.
+static const size_t ABYSS_POINTS_PER_THREAD = 512;
+
+struct abyss_sample_job
+{
+    const ProceduralLayout *layout;
+    uint32_t offset;
+    vector<coord_def> points;
+    vector<ProceduralSample> samples;
+};
+
+static void *_run_abyss_sample_job(void *arg)
+{
+    abyss_sample_job *job = static_cast<abyss_sample_job *>(arg);
+    job->layout->sample(job->points, job->offset, job->samples);
+    return nullptr;
+}
+
+// Sample sampler at points, appending to out. Sampling only reads the
+// layouts, so with abyss_sample_threads the points can be split between
+// threads without changing the results.
+static void _sample_abyss_layout(const ProceduralLayout &sampler,
+                                 const vector<coord_def> &points,
+                                 uint32_t offset,
+                                 vector<ProceduralSample> &out)
+{
+    const int threads = min<int>(Options.abyss_sample_threads,
+                                 points.size() / ABYSS_POINTS_PER_THREAD);
+    if (threads <= 1)
+    {
+        sampler.sample(points, offset, out);
+        return;
+    }
+
+    vector<abyss_sample_job> jobs(threads);
+    for (int i = 0; i < threads; ++i)
+    {
+        jobs[i].layout = &sampler;
+        jobs[i].offset = offset;
+        jobs[i].points.assign(points.begin() + points.size() * i / threads,
+                              points.begin()
+                                  + points.size() * (i + 1) / threads);
+    }
+
+    vector<thread_t> handles(threads);
+    vector<bool> started(threads, false);
+    for (int i = 1; i < threads; ++i)
+    {
+        started[i] = !thread_create_joinable(&handles[i],
+                                             _run_abyss_sample_job, &jobs[i]);
+    }
+    _run_abyss_sample_job(&jobs[0]);
+    for (int i = 1; i < threads; ++i)
+    {
+        if (started[i])
+            thread_join(handles[i]);
+        else
+            _run_abyss_sample_job(&jobs[i]);
+    }
+
+    for (const abyss_sample_job &job : jobs)
+        out.insert(out.end(), job.samples.begin(), job.samples.end());
+}
+
 static cloud_type _cloud_from_feat(const dungeon_feature_type &ft)
 {
     switch (ft)
@@ -1199,38 +1289,50 @@ static dungeon_feature_type _veto_dangerous_terrain(dungeon_feature_type feat)
     return feat;
 }
 
-static void _update_abyss_terrain(const coord_def &p,
+// Whether _update_abyss_terrain() would sample the map position rp.
+static bool _abyss_terrain_updates(const coord_def &rp,
     const map_bitmask &abyss_genlevel_mask, bool morph)
 {
-    const coord_def rp = p - abyssal_state.major_coord;
     // ignore dead coordinates
     if (!in_bounds(rp))
-        return;
+        return false;
 
     const dungeon_feature_type currfeat = env.grid(rp);
 
     // Don't decay vaults.
     if (map_masked(rp, MMT_VAULT))
-        return;
+        return false;
 
     switch (currfeat)
     {
         case DNGN_EXIT_ABYSS:
         case DNGN_ABYSSAL_STAIR:
-            return;
+            return false;
         default:
             break;
     }
 
     if (feat_is_altar(currfeat))
-        return;
+        return false;
 
     if (!abyss_genlevel_mask(rp))
-        return;
+        return false;
 
     if (currfeat != DNGN_UNSEEN && !morph)
+        return false;
+
+    return true;
+}
+
+static void _update_abyss_terrain(const coord_def &p,
+    const map_bitmask &abyss_genlevel_mask, bool morph)
+{
+    const coord_def rp = p - abyssal_state.major_coord;
+    if (!_abyss_terrain_updates(rp, abyss_genlevel_mask, morph))
         return;
 
+    const dungeon_feature_type currfeat = env.grid(rp);
+
     // What should have been there previously?  It might not be because
     // of external changes such as digging.
     const ProceduralSample sample = _abyss_grid(rp);
@@ -1298,6 +1400,83 @@ static void _ensure_player_habitable(bool dig_instead)
     }
 }
 
+/**
+ * Work out, as one batch, the samples for the cells _abyss_apply_terrain()
+ * is sure to update: those due from the sample queue, and those its sweep
+ * over the map updates without a random roll. Sampling is a pure function of
+ * the position and the abyss depth, so this doesn't change what gets placed,
+ * or in what order; _abyss_grid() just finds the answers waiting.
+ */
+static void _prefetch_abyss_samples(const map_bitmask &abyss_genlevel_mask,
+                                    bool morph, bool now, bool used_queue)
+{
+    abyss_prefetch_index.init(-1);
+    abyss_prefetched.clear();
+
+    vector<coord_def> cells;
+    auto want = [&](const coord_def &rp)
+    {
+        if (_abyss_terrain_updates(rp, abyss_genlevel_mask, morph)
+            && abyss_prefetch_index(rp) < 0)
+        {
+            abyss_prefetch_index(rp) = 0;
+            cells.push_back(rp);
+        }
+    };
+
+    if (used_queue)
+    {
+        for (const ProceduralSample &sample : abyss_sample_queue.entries())
+            if (sample.changepoint() < abyssal_state.depth)
+                want(sample.coord() - abyssal_state.major_coord);
+    }
+    for (rectangle_iterator ri(MAPGEN_BORDER); ri; ++ri)
+    {
+        if (map_masked(*ri, MMT_TURNED_TO_FLOOR) ? now : !used_queue)
+            want(*ri);
+    }
+
+    // Row by row, so that neighbouring cells share their noise.
+    sort(cells.begin(), cells.end(), [](const coord_def &a, const coord_def &b)
+         { return a.y != b.y ? a.y < b.y : a.x < b.x; });
+
+    vector<coord_def> waste_cells, waste_points, layout_cells, layout_points;
+    for (const coord_def &rp : cells)
+    {
+        const coord_def pt = rp + abyssal_state.major_coord;
+        if (_in_wastes(pt))
+        {
+            waste_cells.push_back(rp);
+            waste_points.push_back(pt);
+        }
+        else
+        {
+            layout_cells.push_back(rp);
+            layout_points.push_back(pt);
+        }
+    }
+
+    if (!waste_points.empty())
+    {
+        _sample_abyss_layout(wastes, waste_points, abyssal_state.depth,
+                             abyss_prefetched);
+    }
+    if (!layout_points.empty())
+    {
+        _sample_abyss_layout(_abyss_layout(), layout_points,
+                             abyssal_state.depth, abyss_prefetched);
+    }
+
+    int index = 0;
+    for (const coord_def &rp : waste_cells)
+        abyss_prefetch_index(rp) = index++;
+    for (const coord_def &rp : layout_cells)
+    {
+        ASSERT(abyss_prefetched[index].feat() > DNGN_UNSEEN);
+        abyss_prefetch_index(rp) = index++;
+    }
+}
+
 static void _abyss_apply_terrain(const map_bitmask &abyss_genlevel_mask,
                                  bool morph = false, bool now = false)
 {
@@ -1309,6 +1488,8 @@ static void _abyss_apply_terrain(const map_bitmask &abyss_genlevel_mask,
     int altars_wanted = 0;
     bool use_abyss_exit_map = true;
     bool used_queue = false;
+    _prefetch_abyss_samples(abyss_genlevel_mask, morph, now,
+                            morph && !abyss_sample_queue.empty());
     if (morph && !abyss_sample_queue.empty())
     {
         int ii = 0;
@@ -1368,6 +1549,8 @@ static void _abyss_apply_terrain(const map_bitmask &abyss_genlevel_mask,
     }
     if (ii)
         dprf(DIAG_ABYSS, "Nuked %d features", ii);
+    abyss_prefetch_index.init(-1);
+    abyss_prefetched.clear();
     _ensure_player_habitable(false);
     for (rectangle_iterator ri(MAPGEN_BORDER); ri; ++ri)
         ASSERT_RANGE(env.grid(*ri), DNGN_UNSEEN + 1, NUM_FEATURES);
@@ -2193,3 +2376,62 @@ void abyss_maybe_spawn_xp_exit()
     you.props[ABYSS_STAIR_XP_KEY] = EXIT_XP_COST;
     you.props[ABYSS_SPAWNED_XP_EXIT_KEY] = true;
 }
+
+#if defined(DEBUG_DIAGNOSTICS) || defined(DEBUG_TESTS)
+/**
+ * Sample the wastes and the main Abyss layout at every cell of a map-sized
+ * area around rounds random places, cell by cell and as batches, timing
+ * both and counting the cells where they disagree.
+ */
+abyss_sample_bench_result debug_abyss_sample_bench(int rounds)
+{
+    abyss_sample_bench_result result;
+    const bool had_layout = abyssLayout;
+    const ProceduralLayout *layouts[] = { &wastes, &_abyss_layout() };
+
+    rng::subgenerator subgen(rounds);
+    for (int round = 0; round < rounds; ++round)
+    {
+        const coord_def origin(rng::get_uint32() & 0x7FFFFFF,
+                               rng::get_uint32() & 0x7FFFFFF);
+        const uint32_t depth = rng::get_uint32() & 0x7FFFFFFF;
+
+        vector<coord_def> points;
+        for (rectangle_iterator ri(MAPGEN_BORDER); ri; ++ri)
+            points.push_back(*ri + origin);
+
+        for (const ProceduralLayout *sampler : layouts)
+        {
+            vector<ProceduralSample> cells, batch;
+
+            auto start = chrono::steady_clock::now();
+            for (const coord_def &p : points)
+                cells.push_back((*sampler)(p, depth));
+            auto mid = chrono::steady_clock::now();
+            _sample_abyss_layout(*sampler, points, depth, batch);
+            auto end = chrono::steady_clock::now();
+
+            result.cell_ms += chrono::duration_cast<chrono::microseconds>(
+                mid - start).count() / 1000.0;
+            result.batch_ms += chrono::duration_cast<chrono::microseconds>(
+                end - mid).count() / 1000.0;
+
+            ASSERT(batch.size() == cells.size());
+            for (size_t i = 0; i < cells.size(); ++i)
+            {
+                if (cells[i].coord() != batch[i].coord()
+                    || cells[i].feat() != batch[i].feat()
+                    || cells[i].changepoint() != batch[i].changepoint())
+                {
+                    result.mismatches++;
+                }
+            }
+            result.cells += cells.size();
+        }
+    }
+
+    if (!had_layout)
+        destroy_abyss();
+    return result;
+}
+#endif
@@ -46,3 +46,12 @@ bool lugonu_corrupt_level(int power);
 void run_corruption_effects(int duration);
 void set_abyss_state(coord_def coord, uint32_t depth);
 void destroy_abyss();
+
+struct abyss_sample_bench_result
+{
+    int cells = 0;
+    int mismatches = 0;
+    double cell_ms = 0;
+    double batch_ms = 0;
+};
+abyss_sample_bench_result debug_abyss_sample_bench(int rounds);
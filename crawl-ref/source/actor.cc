@@ -8,6 +8,7 @@
 #include "areas.h"
 #include "art-enum.h"
 #include "attack.h"
+#include "beam.h"
 #include "chardump.h"
 #include "directn.h"
 #include "env.h"
@@ -131,6 +132,7 @@ void actor::set_position(const coord_def &c)
     position = c;
     los_actor_moved(this, oldpos);
     areas_actor_moved(this, oldpos);
+    forget_monster_tracers();
 }
 
 bool actor::can_hibernate(bool holi_only, bool intrinsic_only) const
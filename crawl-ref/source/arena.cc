@@ -7,6 +7,7 @@
 
 #include "arena.h"
 
+#include <chrono>
 #include <stdexcept>
 
 #include "act-iter.h"
@@ -858,8 +859,20 @@ namespace arena
         is_respawning = false;
     }
 
+    static void write_trial(bool was_tied, int usecs)
+    {
+        if (file == nullptr || !Options.arena_dump_trials)
+            return;
+
+        fprintf(file, "trial %d: %s %d turns %d ms\n", trials_done,
+                was_tied ? "tie" : faction_a.won ? "a" : "b", turns,
+                usecs / 1000);
+    }
+
     static void do_fight()
     {
+        const auto start = chrono::steady_clock::now();
+
         viewwindow();
         update_screen();
         clear_messages(true);
@@ -953,6 +966,9 @@ namespace arena
         else if (faction_a.won)
             team_a_wins++;
 
+        write_trial(was_tied, chrono::duration_cast<chrono::microseconds>(
+                                  chrono::steady_clock::now() - start).count());
+
         show_fight_banner(true);
 
         string msg;
@@ -1534,7 +1550,7 @@ NORETURN void run_arena(const newgame_def& choice, const string &default_arena_t
         end(0, false, "Results file already open");
     // would be more elegant if arena_tee handled file open/close, but
     // that would need a bunch of refactoring of how the file is handled here.
-    arena::file = fopen("arena.result", "w");
+    arena::file = fopen(Options.arena_result_file.c_str(), "w");
     msg::arena_tee log(&arena::file);
 
     do
@@ -116,8 +116,98 @@ const tracer_info& tracer_info::operator+=(const tracer_info &other)
     return *this;
 }
 
+bool tracer_info::operator==(const tracer_info &other) const
+{
+    return count == other.count && power == other.power
+           && hurt == other.hurt && helped == other.helped
+           && dont_stop == other.dont_stop;
+}
+
 bolt::bolt() : animate(bool(Options.use_animations & UA_BEAM)) {}
 
+static bool _same_ray(const ray_def &a, const ray_def &b)
+{
+    return a.r.start.x == b.r.start.x && a.r.start.y == b.r.start.y
+           && a.r.dir.x == b.r.dir.x && a.r.dir.y == b.r.dir.y
+           && a.on_corner == b.on_corner && a.cycle_idx == b.cycle_idx;
+}
+
+// tile_beam is left out, since fire() sets it before looking at it.
+bool bolt::same_state(const bolt &o) const
+{
+    return origin_spell == o.origin_spell
+           && range == o.range
+           && glyph == o.glyph
+           && colour == o.colour
+           && flavour == o.flavour
+           && real_flavour == o.real_flavour
+           && drop_item == o.drop_item
+           && item == o.item
+           && source == o.source
+           && target == o.target
+           && damage.num == o.damage.num
+           && damage.size == o.damage.size
+           && ench_power == o.ench_power
+           && hit == o.hit
+           && thrower == o.thrower
+           && ex_size == o.ex_size
+           && source_id == o.source_id
+           && source_name == o.source_name
+           && name == o.name
+           && short_name == o.short_name
+           && hit_verb == o.hit_verb
+           && loudness == o.loudness
+           && hit_noise_msg == o.hit_noise_msg
+           && explode_noise_msg == o.explode_noise_msg
+           && pierce == o.pierce
+           && is_explosion == o.is_explosion
+           && aimed_at_spot == o.aimed_at_spot
+           && aux_source == o.aux_source
+           && affects_nothing == o.affects_nothing
+           && effect_known == o.effect_known
+           && effect_wanton == o.effect_wanton
+           && draw_delay == o.draw_delay
+           && explode_delay == o.explode_delay
+           && special_explosion == o.special_explosion
+           && was_missile == o.was_missile
+           && animate == o.animate
+           && ac_rule == o.ac_rule
+#ifdef DEBUG_DIAGNOSTICS
+           && quiet_debug == o.quiet_debug
+#endif
+           && obvious_effect == o.obvious_effect
+           && seen == o.seen
+           && heard == o.heard
+           && path_taken == o.path_taken
+           && extra_range_used == o.extra_range_used
+           && is_tracer == o.is_tracer
+           && is_targeting == o.is_targeting
+           && aimed_at_feet == o.aimed_at_feet
+           && msg_generated == o.msg_generated
+           && noise_generated == o.noise_generated
+           && passed_target == o.passed_target
+           && in_explosion_phase == o.in_explosion_phase
+           && attitude == o.attitude
+           && foe_ratio == o.foe_ratio
+           && hit_count == o.hit_count
+           && foe_info == o.foe_info
+           && friend_info == o.friend_info
+           && chose_ray == o.chose_ray
+           && beam_cancelled == o.beam_cancelled
+           && dont_stop_player == o.dont_stop_player
+           && dont_stop_trees == o.dont_stop_trees
+           && bounces == o.bounces
+           && bounce_pos == o.bounce_pos
+           && reflections == o.reflections
+           && reflector == o.reflector
+           && use_target_as_pos == o.use_target_as_pos
+           && auto_hit == o.auto_hit
+           && _same_ray(ray, o.ray)
+           && can_see_invis == o.can_see_invis
+           && nightvision == o.nightvision
+           && message_cache == o.message_cache;
+}
+
 bool bolt::is_blockable() const
 {
     // BEAM_ELECTRICITY is added here because chain lightning is not
@@ -2048,6 +2138,43 @@ int silver_damages_victim(actor* victim, int damage, string &dmg_msg)
     return ret;
 }
 
+namespace
+{
+    struct tracer_memo_entry
+    {
+        mid_t caster;
+        bool explode_only;
+        bool explosion_hole;
+        bolt before;
+        bolt after;
+    };
+}
+
+static int tracer_memo_depth = 0;
+static vector<tracer_memo_entry> tracer_memo;
+static tracer_memo_stats tracer_stats = { 0, 0, 0 };
+
+monster_tracer_memo::monster_tracer_memo()
+{
+    tracer_memo_depth++;
+}
+
+monster_tracer_memo::~monster_tracer_memo()
+{
+    if (--tracer_memo_depth == 0)
+        tracer_memo.clear();
+}
+
+void forget_monster_tracers()
+{
+    tracer_memo.clear();
+}
+
+tracer_memo_stats get_tracer_memo_stats()
+{
+    return tracer_stats;
+}
+
 //  Used by monsters in "planning" which spell to cast. Fires off a "tracer"
 //  which tells the monster what it'll hit if it breathes/casts etc.
 //
@@ -2056,6 +2183,11 @@ int silver_damages_victim(actor* victim, int damage, string &dmg_msg)
 //
 //  Note that beam properties must be set, as the tracer will take them
 //  into account, as well as the monster's intelligence.
+//
+//  Inside a monster_tracer_memo, a tracer that matches one already fired by
+//  the same caster gets that one's results without being fired again. Beams
+//  carrying an item or a special explosion are always fired, as are tracers
+//  that used the RNG, since skipping them would change later rolls.
 void fire_tracer(const monster* mons, bolt &pbolt, bool explode_only,
                  bool explosion_hole)
 {
@@ -2092,6 +2224,30 @@ void fire_tracer(const monster* mons, bolt &pbolt, bool explode_only,
 
     pbolt.in_explosion_phase = false;
 
+    unique_ptr<bolt> before;
+    if (tracer_memo_depth > 0)
+    {
+        if (pbolt.item || pbolt.special_explosion)
+            tracer_stats.uncacheable++;
+        else
+        {
+            for (const tracer_memo_entry &entry : tracer_memo)
+            {
+                if (entry.caster == mons->mid
+                    && entry.explode_only == explode_only
+                    && entry.explosion_hole == explosion_hole
+                    && entry.before.same_state(pbolt))
+                {
+                    pbolt = entry.after;
+                    tracer_stats.hits++;
+                    return;
+                }
+            }
+            before = make_unique<bolt>(pbolt);
+        }
+    }
+    const uint64_t rng_count = rng::current_generator().get_count();
+
     // Fire!
     if (explode_only)
         pbolt.explode(false, explosion_hole);
@@ -2100,6 +2256,18 @@ void fire_tracer(const monster* mons, bolt &pbolt, bool explode_only,
 
     // Unset tracer flag (convenience).
     pbolt.is_tracer = false;
+
+    if (before)
+    {
+        if (rng::current_generator().get_count() == rng_count)
+        {
+            tracer_memo.push_back({ mons->mid, explode_only, explosion_hole,
+                                    *before, pbolt });
+            tracer_stats.misses++;
+        }
+        else
+            tracer_stats.uncacheable++;
+    }
 }
 
 vector<coord_def> create_feat_splash(coord_def center,
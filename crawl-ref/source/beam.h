@@ -49,6 +49,7 @@ struct tracer_info
     void reset();
 
     const tracer_info &operator += (const tracer_info &other);
+    bool operator == (const tracer_info &other) const;
 };
 
 struct bolt
@@ -171,6 +172,8 @@ public:
     void set_target(const dist &targ);
     void set_agent(const actor *agent);
     void setup_retrace();
+    // Whether firing this beam would behave exactly like firing other.
+    bool same_state(const bolt &other) const;
 
     // Returns YOU_KILL or MON_KILL, depending on the source of the beam.
     killer_type  killer() const;
@@ -330,6 +333,28 @@ bool curare_actor(actor* source, actor* target, int levels, string name,
 int silver_damages_victim(actor* victim, int damage, string &dmg_msg);
 void fire_tracer(const monster* mons, bolt &pbolt,
                   bool explode_only = false, bool explosion_hole = false);
+
+// While one of these is alive, fire_tracer() remembers the tracers it fires,
+// and firing the same tracer from the same caster again reuses the result
+// rather than walking the path again. Scopes nest; what was remembered is
+// forgotten when the outermost one ends, or when any actor moves.
+class monster_tracer_memo
+{
+public:
+    monster_tracer_memo();
+    ~monster_tracer_memo();
+};
+
+void forget_monster_tracers();
+
+struct tracer_memo_stats
+{
+    int hits;
+    int misses;
+    int uncacheable;
+};
+
+tracer_memo_stats get_tracer_memo_stats();
 spret zapping(zap_type ztype, int power, bolt &pbolt,
                    bool needs_tracer = false, const char* msg = nullptr,
                    bool fail = false);
@@ -9,8 +9,15 @@
 #pragma once
 
 #include <bitset>
+#include <cstdint>
 #include <vector>
 
+#if defined(__AVX2__)
+# include <immintrin.h>
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
 #include "debug.h"
 #include "defines.h"
 
@@ -192,3 +199,230 @@ public:
         return *this;
     }
 };
+
+/**
+ * A 2D bit array stored as 8x8 blocks of one 64-bit word each, with a mask
+ * per row of blocks saying which blocks have any bits set. Visiting the set
+ * bits skips empty blocks, so it costs time in proportion to what is set
+ * rather than to the size of the array. Meant for dirty cell tracking.
+ */
+template <unsigned int SIZEX, unsigned int SIZEY> class BlockBitArray
+{
+public:
+    static const unsigned int BLOCKS_X = (SIZEX + 7) / 8;
+    static const unsigned int BLOCKS_Y = (SIZEY + 7) / 8;
+    static_assert(BLOCKS_X <= 32, "one row of blocks must fit in a mask");
+
+    BlockBitArray()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (unsigned int by = 0; by < BLOCKS_Y; ++by)
+        {
+            row_mask[by] = 0;
+            for (unsigned int bx = 0; bx < BLOCKS_X; ++bx)
+                blocks[by][bx] = 0;
+        }
+    }
+
+    inline bool get(int x, int y) const
+    {
+#ifdef ASSERTS
+        if (x < 0 || y < 0 || x >= (int)SIZEX || y >= (int)SIZEY)
+            die("bit array range error: %d,%d / %u,%u", x, y, SIZEX, SIZEY);
+#endif
+        return blocks[y / 8][x / 8] & _bit(x, y);
+    }
+
+    template<class Indexer> inline bool get(const Indexer &i) const
+    {
+        return get(i.x, i.y);
+    }
+
+    inline void set(int x, int y, bool value = true)
+    {
+#ifdef ASSERTS
+        if (x < 0 || y < 0 || x >= (int)SIZEX || y >= (int)SIZEY)
+            die("bit array range error: %d,%d / %u,%u", x, y, SIZEX, SIZEY);
+#endif
+        uint64_t &block = blocks[y / 8][x / 8];
+        if (value)
+        {
+            block |= _bit(x, y);
+            row_mask[y / 8] |= 1u << (x / 8);
+        }
+        else
+        {
+            block &= ~_bit(x, y);
+            if (!block)
+                row_mask[y / 8] &= ~(1u << (x / 8));
+        }
+    }
+
+    template<class Indexer> inline void set(const Indexer &i, bool value = true)
+    {
+        set(i.x, i.y, value);
+    }
+
+    bool any() const
+    {
+        for (unsigned int by = 0; by < BLOCKS_Y; ++by)
+            if (row_mask[by])
+                return true;
+        return false;
+    }
+
+    // Calls f(x, y) for each set bit, in the same row by row order as a
+    // plain scan of the array. f may clear bits as it goes.
+    template<class F> void for_each_set(F f) const
+    {
+        for (unsigned int by = 0; by < BLOCKS_Y; ++by)
+        {
+            if (!row_mask[by])
+                continue;
+
+            for (unsigned int y = by * 8; y < by * 8 + 8 && y < SIZEY; ++y)
+            {
+                for (uint32_t mask = row_mask[by]; mask; mask &= mask - 1)
+                {
+                    const unsigned int bx = _lowest_bit(mask);
+                    for (unsigned int row = (blocks[by][bx] >> (y % 8 * 8))
+                                            & 0xff;
+                         row; row &= row - 1)
+                    {
+                        f(bx * 8 + _lowest_bit(row), y);
+                    }
+                }
+            }
+        }
+    }
+
+protected:
+    static inline uint64_t _bit(int x, int y)
+    {
+        return uint64_t(1) << (y % 8 * 8 + x % 8);
+    }
+
+    static inline unsigned int _lowest_bit(uint32_t v)
+    {
+        unsigned int n = 0;
+        for (; !(v & 1); v >>= 1)
+            ++n;
+        return n;
+    }
+
+    uint64_t blocks[BLOCKS_Y][BLOCKS_X];
+    uint32_t row_mask[BLOCKS_Y];
+};
+
+/**
+ * A fixed-size bit vector stored as 32-byte aligned 64-bit words, whose set
+ * operations work on whole words, using AVX2 or SSE2 when the compiler
+ * targets them. Meant for hot loops that combine large bit sets (LOS ray
+ * sets); it never allocates.
+ */
+template <unsigned int SIZE> class WideBitVector
+{
+public:
+    // Rounded up to whole 256-bit blocks, so the vector loops need no tail.
+    static const unsigned int NWORDS = (SIZE + 255) / 256 * 4;
+
+    WideBitVector()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (unsigned int w = 0; w < NWORDS; ++w)
+            data[w] = 0;
+    }
+
+    inline bool get(unsigned int i) const
+    {
+#ifdef ASSERTS
+        if (i >= SIZE)
+            die("bit vector range error: %d / %u", (int)i, SIZE);
+#endif
+        return data[i / 64] & (uint64_t(1) << (i % 64));
+    }
+
+    inline void set(unsigned int i, bool value = true)
+    {
+#ifdef ASSERTS
+        if (i >= SIZE)
+            die("bit vector range error: %d / %u", (int)i, SIZE);
+#endif
+        if (value)
+            data[i / 64] |= uint64_t(1) << (i % 64);
+        else
+            data[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+
+    inline uint64_t word(unsigned int w) const
+    {
+        return data[w];
+    }
+
+    // *this |= x
+    inline WideBitVector<SIZE>& operator|=(const WideBitVector<SIZE>& x)
+    {
+#if defined(__AVX2__)
+        for (unsigned int w = 0; w < NWORDS; w += 4)
+        {
+            __m256i *d = reinterpret_cast<__m256i*>(data + w);
+            const __m256i *o = reinterpret_cast<const __m256i*>(x.data + w);
+            _mm256_store_si256(d, _mm256_or_si256(_mm256_load_si256(d),
+                                                  _mm256_load_si256(o)));
+        }
+#elif defined(__SSE2__)
+        for (unsigned int w = 0; w < NWORDS; w += 2)
+        {
+            __m128i *d = reinterpret_cast<__m128i*>(data + w);
+            const __m128i *o = reinterpret_cast<const __m128i*>(x.data + w);
+            _mm_store_si128(d, _mm_or_si128(_mm_load_si128(d),
+                                            _mm_load_si128(o)));
+        }
+#else
+        for (unsigned int w = 0; w < NWORDS; ++w)
+            data[w] |= x.data[w];
+#endif
+        return *this;
+    }
+
+    // *this |= (x & y), without a temporary.
+    inline void or_and(const WideBitVector<SIZE>& x,
+                       const WideBitVector<SIZE>& y)
+    {
+#if defined(__AVX2__)
+        for (unsigned int w = 0; w < NWORDS; w += 4)
+        {
+            __m256i *d = reinterpret_cast<__m256i*>(data + w);
+            const __m256i *a = reinterpret_cast<const __m256i*>(x.data + w);
+            const __m256i *b = reinterpret_cast<const __m256i*>(y.data + w);
+            _mm256_store_si256(d, _mm256_or_si256(_mm256_load_si256(d),
+                                  _mm256_and_si256(_mm256_load_si256(a),
+                                                   _mm256_load_si256(b))));
+        }
+#elif defined(__SSE2__)
+        for (unsigned int w = 0; w < NWORDS; w += 2)
+        {
+            __m128i *d = reinterpret_cast<__m128i*>(data + w);
+            const __m128i *a = reinterpret_cast<const __m128i*>(x.data + w);
+            const __m128i *b = reinterpret_cast<const __m128i*>(y.data + w);
+            _mm_store_si128(d, _mm_or_si128(_mm_load_si128(d),
+                               _mm_and_si128(_mm_load_si128(a),
+                                             _mm_load_si128(b))));
+        }
+#else
+        for (unsigned int w = 0; w < NWORDS; ++w)
+            data[w] |= x.data[w] & y.data[w];
+#endif
+    }
+
+protected:
+    alignas(32) uint64_t data[NWORDS];
+};
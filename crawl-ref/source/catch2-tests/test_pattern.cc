@@ -0,0 +1,146 @@
+#include <random>
+
+#include "catch.hpp"
+
+#include "AppHdr.h"
+
+#include "pattern.h"
+
+// Patterns are built from short, overlapping pieces of a small alphabet, so
+// that literals share prefixes and suffixes and strings often contain them.
+static const char *_pattern_pieces[] =
+{
+    "a", "b", "ab", "ba", "aba", "bab", "abab", "A", "Ab", "x", "yz", " ",
+    // Escaped and bracketed text
+    "\\.", "[ab]", "[^a]", "[]a]",
+    // Anchors and quantifiers
+    "^", "$", ".", "*", "+", "?", ".*", "+?", "{2}", "{1,3}",
+    // Things that make the matcher give up and run the regex
+    "|", "(ab)", "(a|b)", "\\w", "\\b", "\\d",
+};
+
+static const char _text_chars[] = "abAB xyz.";
+
+static string _random_pattern(mt19937 &rng)
+{
+    string pattern;
+    const int pieces = uniform_int_distribution<int>(0, 4)(rng);
+    for (int i = 0; i < pieces; ++i)
+    {
+        pattern += _pattern_pieces[uniform_int_distribution<size_t>(
+                       0, ARRAYSZ(_pattern_pieces) - 1)(rng)];
+    }
+    return pattern;
+}
+
+static string _random_text(mt19937 &rng)
+{
+    string text;
+    const int len = uniform_int_distribution<int>(0, 12)(rng);
+    for (int i = 0; i < len; ++i)
+    {
+        text += _text_chars[uniform_int_distribution<size_t>(
+                    0, ARRAYSZ(_text_chars) - 2)(rng)];
+    }
+    return text;
+}
+
+// What pattern_list_matcher replaced: each pattern tried in turn.
+static int _first_match(const vector<text_pattern> &patterns,
+                        bool match_empty, const string &s,
+                        const vector<int> &candidates)
+{
+    for (const int i : candidates)
+    {
+        if ((match_empty && patterns[i].empty()) || patterns[i].matches(s))
+            return i;
+    }
+    return -1;
+}
+
+TEST_CASE("pattern_list_matcher agrees with matching patterns in turn",
+          "[single-file]")
+{
+    const bool match_empty = GENERATE(false, true);
+    mt19937 rng(match_empty ? 1 : 2);
+
+    for (int list = 0; list < 300; ++list)
+    {
+        vector<text_pattern> patterns;
+        pattern_list_matcher matcher;
+        const int size = uniform_int_distribution<int>(1, 12)(rng);
+        for (int i = 0; i < size; ++i)
+        {
+            const bool icase = uniform_int_distribution<int>(0, 1)(rng);
+            patterns.emplace_back(_random_pattern(rng), icase);
+            matcher.add(patterns.back(), match_empty);
+        }
+
+        vector<int> all(size), some;
+        for (int i = 0; i < size; ++i)
+        {
+            all[i] = i;
+            if (uniform_int_distribution<int>(0, 1)(rng))
+                some.push_back(i);
+        }
+
+        for (int t = 0; t < 40; ++t)
+        {
+            const string text = _random_text(rng);
+            CAPTURE(list, text);
+            INFO("patterns: " << [&]() {
+                string desc;
+                for (const text_pattern &p : patterns)
+                {
+                    desc += "\"" + p.tostring() + "\""
+                            + (p.icase() ? "i " : " ");
+                }
+                return desc;
+            }());
+            REQUIRE(matcher.first_match(text)
+                    == _first_match(patterns, match_empty, text, all));
+            REQUIRE(matcher.first_match(text, some)
+                    == _first_match(patterns, match_empty, text, some));
+        }
+    }
+}
+
+TEST_CASE("pattern_list_matcher handles overlapping literals",
+          "[single-file]")
+{
+    pattern_list_matcher matcher;
+    matcher.add(text_pattern("abab"));
+    matcher.add(text_pattern("bab"));
+    matcher.add(text_pattern("ba"));
+    matcher.add(text_pattern("BA", true));
+
+    REQUIRE(matcher.first_match("xababx") == 0);
+    REQUIRE(matcher.first_match("xbabx") == 1);
+    REQUIRE(matcher.first_match("aba") == 2);
+    REQUIRE(matcher.first_match("xbAx") == 3);
+    REQUIRE(matcher.first_match("abb") == -1);
+}
+
+TEST_CASE("pattern_list_matcher respects anchors", "[single-file]")
+{
+    pattern_list_matcher matcher;
+    matcher.add(text_pattern("^You feel"));
+    matcher.add(text_pattern("hungry$"));
+    matcher.add(text_pattern("feel"));
+
+    REQUIRE(matcher.first_match("You feel hungry") == 0);
+    REQUIRE(matcher.first_match("Now you feel hungry") == 1);
+    REQUIRE(matcher.first_match("You are hungry.") == -1);
+    REQUIRE(matcher.first_match("They feel hungry now") == 2);
+}
+
+TEST_CASE("pattern_list_matcher falls back to the regex", "[single-file]")
+{
+    pattern_list_matcher matcher;
+    matcher.add(text_pattern("(orc|goblin) (priest|wizard)"));
+    matcher.add(text_pattern("ogre.*mage", true));
+
+    REQUIRE(matcher.first_match("The goblin wizard casts a spell.") == 0);
+    REQUIRE(matcher.first_match("The orc warrior hits you.") == -1);
+    REQUIRE(matcher.first_match("The OGRE MAGE casts a spell.") == 1);
+}
@@ -33,19 +33,95 @@ static void _clua_throttle_hook(lua_State *, lua_Debug *);
 #ifndef NO_CUSTOM_ALLOCATOR
 static void *_clua_allocator(void *ud, void *ptr, size_t osize, size_t nsize);
 #endif
+static int  _clua_gc_sentinel(lua_State *);
 static int  _clua_guarded_pcall(lua_State *);
 static int  _clua_require(lua_State *);
 static int  _clua_dofile(lua_State *);
 static int  _clua_loadfile(lua_State *);
 static string _get_persist_file();
 
+// Most of what Lua allocates is small strings, tables and closures that come
+// and go at a high rate. Blocks up to MAX_SIZE bytes are carved out of large
+// chunks and kept on free lists by size class; the chunks are only freed
+// along with the VM.
+class clua_pool
+{
+public:
+    clua_pool() : free_lists(), chunks() { }
+
+    ~clua_pool()
+    {
+        for (char *chunk : chunks)
+            free(chunk);
+    }
+
+    static bool pooled(size_t size)
+    {
+        return size && size <= MAX_SIZE;
+    }
+
+    static bool same_class(size_t a, size_t b)
+    {
+        return pooled(a) && pooled(b) && size_class(a) == size_class(b);
+    }
+
+    void *allocate(size_t size)
+    {
+        const int cls = size_class(size);
+        if (!free_lists[cls])
+            refill(cls);
+        free_block *block = free_lists[cls];
+        if (block)
+            free_lists[cls] = block->next;
+        return block;
+    }
+
+    void release(void *ptr, size_t size)
+    {
+        free_block *block = static_cast<free_block *>(ptr);
+        block->next = free_lists[size_class(size)];
+        free_lists[size_class(size)] = block;
+    }
+
+private:
+    // Lua needs no more alignment than a double or a pointer.
+    static const size_t GRANULE = 8;
+    static const size_t MAX_SIZE = 256;
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    struct free_block
+    {
+        free_block *next;
+    };
+
+    static int size_class(size_t size)
+    {
+        return (size - 1) / GRANULE;
+    }
+
+    void refill(int cls)
+    {
+        const size_t block_size = (cls + 1) * GRANULE;
+        char *chunk = static_cast<char *>(malloc(CHUNK_SIZE));
+        if (!chunk)
+            return;
+        chunks.push_back(chunk);
+        for (size_t off = 0; off + block_size <= CHUNK_SIZE; off += block_size)
+            release(chunk + off, block_size);
+    }
+
+    free_block *free_lists[MAX_SIZE / GRANULE];
+    vector<char *> chunks;
+};
+
 CLua::CLua(bool managed)
     : error(), managed_vm(managed), shutting_down(false),
       throttle_unit_lines(50000),
       throttle_sleep_ms(0), throttle_sleep_start(2),
       throttle_sleep_end(800), n_throttle_sleeps(0), mixed_call_depth(0),
       lua_call_depth(0), max_mixed_call_depth(8),
-      max_lua_call_depth(100), memory_used(0),
+      max_lua_call_depth(100), memory_used(0), stats(),
+      pool(make_unique<clua_pool>()), gc_pause(0), gc_stepmul(0),
       _state(nullptr), sourced_files(), uniqindex(0)
 {
 }
@@ -115,6 +191,22 @@ void CLua::gc()
     lua_gc(state(), LUA_GCCOLLECT, 0);
 }
 
+void CLua::set_gc_params(int pause, int stepmul)
+{
+    gc_pause = pause;
+    gc_stepmul = stepmul;
+    if (_state)
+        apply_gc_params();
+}
+
+void CLua::apply_gc_params()
+{
+    if (gc_pause > 0)
+        lua_gc(_state, LUA_GCSETPAUSE, gc_pause);
+    if (gc_stepmul > 0)
+        lua_gc(_state, LUA_GCSETSTEPMUL, gc_stepmul);
+}
+
 void CLua::save(writer &outf)
 {
     if (!_state)
@@ -724,8 +816,9 @@ void CLua::init_lua()
 # endif
     _state = luaL_newstate();
 #else
-    // Throttle memory usage in managed (clua) VMs
-    _state = managed_vm? lua_newstate(_clua_allocator, this) : luaL_newstate();
+    // Pool small allocations, and throttle memory usage in managed (clua)
+    // VMs.
+    _state = lua_newstate(_clua_allocator, this);
 #endif
     if (!_state)
         end(1, false, "Unable to create Lua state.");
@@ -777,6 +870,19 @@ void CLua::init_lua()
 
     lua_pushlightuserdata(_state, this);
     setregistry("__clua");
+
+    // Collection cycles are counted by a sentinel that is never referenced,
+    // so every cycle finalises it; its finaliser makes the next one.
+    lua_newtable(_state);
+    lua_pushcfunction(_state, _clua_gc_sentinel);
+    lua_setfield(_state, -2, "__gc");
+    setregistry("__clua_gc_sentinel");
+    lua_newuserdata(_state, 1);
+    getregistry("__clua_gc_sentinel");
+    lua_setmetatable(_state, -2);
+    lua_pop(_state, 1);
+
+    apply_gc_params();
 }
 
 static int lua_loadstring(lua_State *ls)
@@ -1095,27 +1201,85 @@ static int _clua_panic(lua_State *ls)
 }
 
 #ifndef NO_CUSTOM_ALLOCATOR
+static void _clua_release(clua_pool &pool, void *ptr, size_t size)
+{
+    if (clua_pool::pooled(size))
+        pool.release(ptr, size);
+    else
+        free(ptr);
+}
+
 static void *_clua_allocator(void *ud, void *ptr, size_t osize, size_t nsize)
 {
     CLua *cl = static_cast<CLua *>(ud);
-    cl->memory_used += nsize - osize;
+    clua_pool &pool(*cl->pool);
+    lua_vm_stats &stats(cl->stats);
 
-    if (nsize > osize && cl->memory_used >= CLUA_MAX_MEMORY_USE * 1024
-        && cl->mixed_call_depth)
+    // Lua passes osize == 0 when ptr is null.
+    if (!nsize)
     {
+        if (ptr)
+        {
+            _clua_release(pool, ptr, osize);
+            cl->memory_used -= osize;
+            ++stats.frees;
+        }
         return nullptr;
     }
 
-    if (!nsize)
+    if (nsize > osize && cl->managed_vm
+        && cl->memory_used + long(nsize - osize) >= CLUA_MAX_MEMORY_USE * 1024
+        && cl->mixed_call_depth)
     {
-        free(ptr);
         return nullptr;
     }
+
+    void *res;
+    if (ptr && clua_pool::same_class(osize, nsize))
+        res = ptr;
+    else if (ptr && !clua_pool::pooled(osize) && !clua_pool::pooled(nsize))
+        res = realloc(ptr, nsize);
+    else
+    {
+        res = clua_pool::pooled(nsize) ? pool.allocate(nsize) : malloc(nsize);
+        if (res && ptr)
+        {
+            memcpy(res, ptr, min(osize, nsize));
+            _clua_release(pool, ptr, osize);
+        }
+    }
+    if (!res)
+        return nullptr;
+
+    if (ptr)
+        ++stats.reallocs;
     else
-        return realloc(ptr, nsize);
+        ++stats.allocs;
+    if (clua_pool::pooled(nsize))
+        ++stats.pooled;
+    if (nsize > osize)
+        stats.bytes_allocated += nsize - osize;
+    cl->memory_used += long(nsize) - long(osize);
+    stats.peak_memory = max(stats.peak_memory, cl->memory_used);
+    return res;
 }
 #endif
 
+static int _clua_gc_sentinel(lua_State *ls)
+{
+    CLua &vm(CLua::get_vm(ls));
+    ++vm.stats.gc_cycles;
+    if (!vm.shutting_down)
+    {
+        lua_newuserdata(ls, 1);
+        lua_pushstring(ls, "__clua_gc_sentinel");
+        lua_gettable(ls, LUA_REGISTRYINDEX);
+        lua_setmetatable(ls, -2);
+        lua_pop(ls, 1);
+    }
+    return 0;
+}
+
 static void _clua_throttle_hook(lua_State *ls, lua_Debug *dbg)
 {
     UNUSED(dbg);
@@ -9,6 +9,7 @@ extern "C" {
 #include <cstdarg>
 #include <cstdio>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -18,6 +19,19 @@ extern "C" {
 using std::vector;
 
 class CLua;
+class clua_pool;
+
+// Allocation and garbage collection counts for one Lua VM.
+struct lua_vm_stats
+{
+    unsigned long long allocs;          // New blocks.
+    unsigned long long reallocs;        // Blocks resized.
+    unsigned long long frees;           // Blocks freed.
+    unsigned long long pooled;          // Allocations served by the pool.
+    unsigned long long bytes_allocated; // Total bytes requested.
+    long peak_memory;                   // Highest memory_used seen.
+    unsigned long long gc_cycles;       // Completed collection cycles.
+};
 
 class lua_stack_cleaner
 {
@@ -106,6 +120,10 @@ public:
     void load_persist();
     void gc();
 
+    // Set the incremental collector's pause and step multiplier (see
+    // lua_gc); zero leaves Lua's default.
+    void set_gc_params(int pause, int stepmul);
+
     void setglobal(const char *name);
     void getglobal(const char *name);
 
@@ -167,10 +185,14 @@ public:
     int max_lua_call_depth;
 
     long memory_used;
+    lua_vm_stats stats;
+    unique_ptr<clua_pool> pool;
 
     static const int MAX_THROTTLE_SLEEPS = 100;
 
 private:
+    int gc_pause, gc_stepmul;
+
     lua_State *_state;
     typedef set<string> sfset;
     sfset sourced_files;
@@ -180,6 +202,7 @@ private:
 
 private:
     void init_lua();
+    void apply_gc_params();
     void set_error(int err, lua_State *ls = nullptr);
     void init_throttle();
 
@@ -180,47 +180,85 @@ function dgn_map_run_hook(hook_name)
   dgn_run_hooks_in_environment(dgn.MAP_GLOBAL_HOOKS, hook_name)
 end
 
+-- Assignments to globals in a map environment that hide one of its wrapped
+-- functions are noted, so that the function can be put back for the next
+-- chunk run in the environment.
+local function dgn_map_env_newindex(env, key, value)
+   local meta_meta = getmetatable(env)
+   if rawget(meta_meta.__index, key) ~= nil then
+      meta_meta.shadowed[key] = true
+   end
+   rawset(env, key, value)
+end
+
 -- Wraps a map_def into a Lua environment (a table) such that
 -- functions run in the environment (with setfenv) can directly
 -- address the map with function calls such as name(), tags(), etc.
 --
 -- This function caches the environments it creates, so that successive runs
--- of Lua chunks from the same map will use the same environment.
+-- of Lua chunks from the same map will use the same environment. The wrapped
+-- functions are kept in a table of their own behind the environment, which
+-- survives the environment being flushed and is only rebuilt for a different
+-- map object, so starting a map over with a fresh environment is cheap.
+-- dgn._map_wrapper_builds counts the rebuilds.
 function dgn_map_meta_wrap(map, tab)
    if not dgn._map_envs then
       dgn._map_envs = { }
    end
+   if not dgn._map_wrappers then
+      dgn._map_wrappers = { }
+   end
 
    local name = dgn.name(map)
-   local meta = dgn._map_envs[name]
+   local id = dgn.map_id(map)
+
+   -- The map may have the same name, but be a different C++ object. The
+   -- userdata is new on every call, so compare the objects by id.
+   local wrapped = dgn._map_wrappers[name]
+   if not wrapped or wrapped.id ~= id or wrapped.tab ~= tab then
+      local fns = { }
+      for fn, val in pairs(tab) do
+         fns[fn] = function (...)
+                      return crawl.err_trace(val, map, ...)
+                   end
+      end
 
+      -- Convenience global variable, e.g. mapgrd[x][y] = 'x'
+      fns['mapgrd'] = dgn.mapgrd_table(map)
+
+      setmetatable(fns, { __index = _G })
+      wrapped = { id = id, tab = tab, fns = fns }
+      dgn._map_wrappers[name] = wrapped
+      dgn._map_wrapper_builds = (dgn._map_wrapper_builds or 0) + 1
+   end
+
+   local meta = dgn._map_envs[name]
    if not meta then
       meta = { }
       dgn_init_hook_tables(meta)
-      local meta_meta = { __index = _G }
-      setmetatable(meta, meta_meta)
+      setmetatable(meta, { __newindex = dgn_map_env_newindex,
+                           shadowed = { } })
       dgn._map_envs[name] = meta
    end
 
-   -- We must set this each time - the map may have the same name, but
-   -- be a different C++ object.
-   for fn, val in pairs(tab) do
-      meta[fn] = function (...)
-                    return crawl.err_trace(val, map, ...)
-                 end
+   local meta_meta = getmetatable(meta)
+   meta_meta.__index = wrapped.fns
+   if next(meta_meta.shadowed) then
+      for key, _ in pairs(meta_meta.shadowed) do
+         rawset(meta, key, nil)
+      end
+      meta_meta.shadowed = { }
    end
 
-   -- Convenience global variable, e.g. mapgrd[x][y] = 'x'
-   meta['mapgrd'] = dgn.mapgrd_table(map)
-
-   meta['_G'] = meta
-   meta.wrapped_instance = map
+   rawset(meta, '_G', meta)
+   rawset(meta, 'wrapped_instance', map)
    return meta
 end
 
 -- Discards accumulated map environments.
 function dgn_flush_map_environments()
   dgn._map_envs = nil
+  dgn._map_wrappers = nil
   dgn.MAP_GLOBAL_HOOKS = { }
   dgn_init_hook_tables(dgn.MAP_GLOBAL_HOOKS)
 end
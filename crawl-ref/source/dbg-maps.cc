@@ -7,10 +7,18 @@
 
 #include "dbg-maps.h"
 
+#include <cerrno>
+#include <chrono>
+#ifdef UNIX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include "branch.h"
 #include "chardump.h"
 #include "crash.h"
 #include "dbg-objstat.h"
+#include "dlua.h"
 #include "dungeon.h"
 #include "env.h"
 #include "initfile.h"
@@ -18,11 +26,16 @@
 #include "maps.h"
 #include "message.h"
 #include "ng-init.h"
+#include "options.h"
 #include "player.h"
+#include "random.h"
 #include "shopping.h"
 #include "state.h"
 #include "stringutil.h"
+#include "syscalls.h"
 #include "tag-version.h"
+#include "tags.h"
+#include "version.h"
 #include "view.h"
 
 #ifdef DEBUG_STATISTICS
@@ -47,12 +60,37 @@ static int build_attempts = 0, level_vetoes = 0;
 // Map from message to counts.
 static map<string, int> veto_messages;
 
+// The iterations built, with how long each took in microseconds.
+static vector<pair<int, uint64_t> > iteration_times;
+
+// Time spent running each map's Lua: number of runs and microseconds.
+static map<string, pair<int, uint64_t> > map_lua_times;
+// Lua chunk cache use merged from shards, and the counts at the last reset,
+// since the cache's own counts cover the whole process.
+static dlua_chunk_cache_stats merged_chunk_stats, base_chunk_stats;
+
 void mapstat_report_map_build_start()
 {
     build_attempts++;
     map_builds[level_id::current()].first++;
 }
 
+void mapstat_report_map_lua_time(const string &map_name, uint64_t usecs)
+{
+    pair<int, uint64_t> &times = map_lua_times[map_name];
+    times.first++;
+    times.second += usecs;
+}
+
+static dlua_chunk_cache_stats _chunk_cache_stats()
+{
+    const dlua_chunk_cache_stats &now = dlua_chunk_cache_counts();
+    dlua_chunk_cache_stats stats = merged_chunk_stats;
+    stats.hits += now.hits - base_chunk_stats.hits;
+    stats.loads += now.loads - base_chunk_stats.loads;
+    return stats;
+}
+
 void mapstat_report_map_veto(const string &message)
 {
     level_vetoes++;
@@ -230,6 +268,484 @@ static bool _build_dungeon()
     return true;
 }
 
+static bool _build_iteration(int i)
+{
+    const auto start = chrono::steady_clock::now();
+
+    clear_messages();
+    mprf("On %d of %d; %d g, %d fail, %u err%s, %u uniq, "
+         "%d try, %d (%.2f%%) vetoes",
+         i, SysEnv.map_gen_iters, levels_tried, levels_failed,
+         (unsigned int)errors.size(),
+         last_error.empty() ? "" : (" (" + last_error + ")").c_str(),
+         (unsigned int)use_count.size(), build_attempts, level_vetoes,
+         build_attempts ? level_vetoes * 100.0 / build_attempts : 0.0);
+    dlua.callfn("dgn_clear_data", "");
+    you.uniq_map_tags.clear();
+    you.uniq_map_names.clear();
+    you.uniq_map_tags_abyss.clear();
+    you.uniq_map_names_abyss.clear();
+    you.unique_creatures.reset();
+    initialise_branch_depths();
+    init_level_connectivity();
+    if (!_build_dungeon())
+        return false;
+    if (crawl_state.obj_stat_gen)
+        objstat_iteration_stats();
+
+    iteration_times.emplace_back(i,
+        chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+static void _reset_map_stats()
+{
+    try_count.clear();
+    use_count.clear();
+    success_count.clear();
+    level_mapcounts.clear();
+    map_builds.clear();
+    level_mapsused.clear();
+    map_levelsused.clear();
+    errors.clear();
+    last_error.clear();
+    levels_tried = levels_failed = 0;
+    build_attempts = level_vetoes = 0;
+    veto_messages.clear();
+    mapstat_reset_selection_stats();
+    map_lua_times.clear();
+    merged_chunk_stats = dlua_chunk_cache_stats();
+    base_chunk_stats = dlua_chunk_cache_counts();
+}
+
+static void _marshall_level(writer &th, const level_id &lev)
+{
+    marshallSigned(th, lev.branch);
+    marshallSigned(th, lev.depth);
+}
+
+static level_id _unmarshall_level(reader &th)
+{
+    const branch_type br = static_cast<branch_type>(unmarshallSigned(th));
+    return level_id(br, unmarshallSigned(th));
+}
+
+static void _marshall_counts(writer &th, const map<string, int> &counts)
+{
+    marshallUnsigned(th, counts.size());
+    for (const auto &entry : counts)
+    {
+        marshallString(th, entry.first);
+        marshallSigned(th, entry.second);
+    }
+}
+
+static void _unmarshall_counts(reader &th, map<string, int> &counts)
+{
+    for (uint64_t n = unmarshallUnsigned(th); n > 0; --n)
+    {
+        const string key = unmarshallString(th);
+        counts[key] += unmarshallSigned(th);
+    }
+}
+
+static void _save_map_stats(writer &th)
+{
+    _marshall_counts(th, try_count);
+    _marshall_counts(th, use_count);
+    _marshall_counts(th, success_count);
+    _marshall_counts(th, veto_messages);
+
+    marshallUnsigned(th, level_mapcounts.size());
+    for (const auto &entry : level_mapcounts)
+    {
+        _marshall_level(th, entry.first);
+        marshallSigned(th, entry.second);
+    }
+
+    marshallUnsigned(th, map_builds.size());
+    for (const auto &entry : map_builds)
+    {
+        _marshall_level(th, entry.first);
+        marshallSigned(th, entry.second.first);
+        marshallSigned(th, entry.second.second);
+    }
+
+    // map_levelsused is the same information as level_mapsused, inverted.
+    marshallUnsigned(th, level_mapsused.size());
+    for (const auto &entry : level_mapsused)
+    {
+        _marshall_level(th, entry.first);
+        marshallUnsigned(th, entry.second.size());
+        for (const string &name : entry.second)
+            marshallString(th, name);
+    }
+
+    marshallUnsigned(th, errors.size());
+    for (const auto &entry : errors)
+    {
+        marshallString(th, entry.first);
+        marshallString(th, entry.second);
+    }
+    marshallString(th, last_error);
+
+    marshallSigned(th, levels_tried);
+    marshallSigned(th, levels_failed);
+    marshallSigned(th, build_attempts);
+    marshallSigned(th, level_vetoes);
+
+    const map_selection_stats &sel = mapstat_selection_stats();
+    marshallUnsigned(th, sel.queries);
+    marshallUnsigned(th, sel.maps_examined);
+    marshallUnsigned(th, sel.maps_eligible);
+    marshallUnsigned(th, sel.usecs);
+
+    marshallUnsigned(th, map_lua_times.size());
+    for (const auto &entry : map_lua_times)
+    {
+        marshallString(th, entry.first);
+        marshallSigned(th, entry.second.first);
+        marshallUnsigned(th, entry.second.second);
+    }
+
+    const dlua_chunk_cache_stats chunks = _chunk_cache_stats();
+    marshallUnsigned(th, chunks.hits);
+    marshallUnsigned(th, chunks.loads);
+}
+
+static void _load_map_stats(reader &th)
+{
+    _unmarshall_counts(th, try_count);
+    _unmarshall_counts(th, use_count);
+    _unmarshall_counts(th, success_count);
+    _unmarshall_counts(th, veto_messages);
+
+    for (uint64_t n = unmarshallUnsigned(th); n > 0; --n)
+    {
+        const level_id lev = _unmarshall_level(th);
+        level_mapcounts[lev] += unmarshallSigned(th);
+    }
+
+    for (uint64_t n = unmarshallUnsigned(th); n > 0; --n)
+    {
+        const level_id lev = _unmarshall_level(th);
+        map_builds[lev].first += unmarshallSigned(th);
+        map_builds[lev].second += unmarshallSigned(th);
+    }
+
+    for (uint64_t n = unmarshallUnsigned(th); n > 0; --n)
+    {
+        const level_id lev = _unmarshall_level(th);
+        for (uint64_t m = unmarshallUnsigned(th); m > 0; --m)
+        {
+            const string name = unmarshallString(th);
+            level_mapsused[lev].insert(name);
+            map_levelsused[name].insert(lev);
+        }
+    }
+
+    for (uint64_t n = unmarshallUnsigned(th); n > 0; --n)
+    {
+        const string name = unmarshallString(th);
+        errors[name] = unmarshallString(th);
+    }
+    const string error = unmarshallString(th);
+    if (!error.empty())
+        last_error = error;
+
+    levels_tried += unmarshallSigned(th);
+    levels_failed += unmarshallSigned(th);
+    build_attempts += unmarshallSigned(th);
+    level_vetoes += unmarshallSigned(th);
+
+    map_selection_stats sel;
+    sel.queries = unmarshallUnsigned(th);
+    sel.maps_examined = unmarshallUnsigned(th);
+    sel.maps_eligible = unmarshallUnsigned(th);
+    sel.usecs = unmarshallUnsigned(th);
+    mapstat_add_selection_stats(sel);
+
+    for (uint64_t n = unmarshallUnsigned(th); n > 0; --n)
+    {
+        pair<int, uint64_t> &times = map_lua_times[unmarshallString(th)];
+        times.first += unmarshallSigned(th);
+        times.second += unmarshallUnsigned(th);
+    }
+
+    merged_chunk_stats.hits += unmarshallUnsigned(th);
+    merged_chunk_stats.loads += unmarshallUnsigned(th);
+}
+
+// Sharded builds split the iterations into contiguous ranges, each built by
+// a process of its own. Every iteration is seeded from the base seed and its
+// index alone, so the totals don't depend on how many shards there are.
+// After each iteration a shard writes everything it has gathered so far to
+// its shard file; a later run with the same arguments picks up from there,
+// and once every shard is complete their totals are merged for the reports.
+
+static const char *shard_magic = "DCSS stat shard 1";
+
+struct stat_shard
+{
+    int index;
+    int first;      // first iteration
+    int last;       // one past the last iteration
+    int done;       // iterations finished so far
+    uint64_t seed;  // base seed of the whole run
+};
+
+static string _shard_file(int index)
+{
+    return make_stringf("%sstat_shard%d.dat",
+                        crawl_state.obj_stat_gen ? "obj" : "map", index);
+}
+
+// Anything that would change what a shard builds, besides its seed and
+// iteration range.
+static string _shard_settings()
+{
+    return make_stringf("%s|%s|%s|%s",
+                        crawl_state.obj_stat_gen ? "objstat" : "mapstat",
+                        Version::Long,
+                        SysEnv.map_gen_range
+                            ? SysEnv.map_gen_range->describe().c_str() : "",
+                        crawl_state.force_map.c_str());
+}
+
+static uint64_t _iteration_seed(uint64_t seed, int iteration)
+{
+    return rng::PcgRNG(seed, iteration).get_uint64();
+}
+
+static void _reset_stats()
+{
+    if (crawl_state.obj_stat_gen)
+        objstat_reset_stats();
+    else
+        _reset_map_stats();
+    iteration_times.clear();
+}
+
+static bool _save_shard(const stat_shard &shard)
+{
+    vector<unsigned char> buf;
+    writer outf(&buf);
+
+    marshallString(outf, shard_magic);
+    marshallString(outf, _shard_settings());
+    marshallUnsigned(outf, shard.seed);
+    marshallSigned(outf, shard.first);
+    marshallSigned(outf, shard.last);
+    marshallSigned(outf, shard.done);
+
+    marshallUnsigned(outf, iteration_times.size());
+    for (const auto &entry : iteration_times)
+    {
+        marshallSigned(outf, entry.first);
+        marshallUnsigned(outf, entry.second);
+    }
+
+    if (crawl_state.obj_stat_gen)
+        objstat_save_stats(outf);
+    else
+        _save_map_stats(outf);
+
+    // Write a new file and move it into place, so that an interruption
+    // leaves the previous checkpoint intact.
+    const string file = _shard_file(shard.index);
+    const string tmp = file + ".tmp";
+    FILE *fp = fopen_u(tmp.c_str(), "wb");
+    bool ok = fp && fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+    if (fp)
+        ok = !fclose(fp) && ok;
+    if (!ok || rename_u(tmp.c_str(), file.c_str()))
+    {
+        fprintf(stderr, "Unable to write %s: %s\n", file.c_str(),
+                strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read a shard file written by an earlier run.
+ *
+ * @param shard The shard to read. Its seed is set from the file if it is
+ *              zero, and must otherwise match; its progress is set from the
+ *              file.
+ * @param stats Whether to add the file's statistics and iteration times to
+ *              those gathered so far, or only read its progress.
+ * @returns False if there is no file, or it is damaged or from a run with
+ *          different settings. The statistics may then be partly merged.
+ */
+static bool _load_shard(stat_shard &shard, bool stats)
+{
+    mapped_file file(_shard_file(shard.index));
+    if (!file.valid())
+        return false;
+
+    reader inf(file.data(), file.size());
+    try
+    {
+        if (unmarshallString(inf) != shard_magic
+            || unmarshallString(inf) != _shard_settings())
+        {
+            return false;
+        }
+
+        const uint64_t seed = unmarshallUnsigned(inf);
+        if (shard.seed && seed != shard.seed)
+            return false;
+
+        const int first = unmarshallSigned(inf);
+        const int last = unmarshallSigned(inf);
+        const int done = unmarshallSigned(inf);
+        if (first != shard.first || last != shard.last
+            || done < 0 || done > last - first)
+        {
+            return false;
+        }
+        shard.seed = seed;
+        shard.done = done;
+        if (!stats)
+            return true;
+
+        for (uint64_t n = unmarshallUnsigned(inf); n > 0; --n)
+        {
+            const int iteration = unmarshallSigned(inf);
+            iteration_times.emplace_back(iteration, unmarshallUnsigned(inf));
+        }
+
+        if (crawl_state.obj_stat_gen)
+            return objstat_load_stats(inf);
+        _load_map_stats(inf);
+        return true;
+    }
+    catch (const short_read_exception &E)
+    {
+        return false;
+    }
+}
+
+// Build the rest of a shard's iterations, resuming from its file if it has
+// one.
+static bool _build_shard(stat_shard shard)
+{
+    _reset_stats();
+    if (!_load_shard(shard, true))
+    {
+        _reset_stats();
+        shard.done = 0;
+    }
+    else if (shard.done)
+    {
+        printf("Shard %d: resuming after %d of %d iteration(s).\n",
+               shard.index, shard.done, shard.last - shard.first);
+        fflush(stdout);
+    }
+
+    for (int i = shard.first + shard.done; i < shard.last; ++i)
+    {
+        rng::seed(_iteration_seed(shard.seed, i));
+        if (!_build_iteration(i))
+            return false;
+        shard.done++;
+        if (!_save_shard(shard))
+            return false;
+
+        printf("Shard %d: iteration %d (%d of %d) took %.1f s.\n",
+               shard.index, i + 1, shard.done, shard.last - shard.first,
+               iteration_times.back().second / 1000000.0);
+        fflush(stdout);
+    }
+    return true;
+}
+
+static bool _build_shards()
+{
+    const int num_shards = min(SysEnv.map_gen_shards, SysEnv.map_gen_iters);
+    vector<stat_shard> shards;
+    for (int i = 0; i < num_shards; ++i)
+    {
+        shards.push_back({i, SysEnv.map_gen_iters * i / num_shards,
+                          SysEnv.map_gen_iters * (i + 1) / num_shards, 0, 0});
+    }
+
+    // An explicit -seed decides; otherwise carry on with the seed of an
+    // earlier run's shards, so that they can be resumed.
+    uint64_t seed = Options.seed;
+    for (int i = 0; !seed && i < num_shards; ++i)
+    {
+        stat_shard shard = shards[i];
+        if (_load_shard(shard, false))
+            seed = shard.seed;
+    }
+    if (!seed)
+        seed = crawl_state.seed;
+    for (stat_shard &shard : shards)
+        shard.seed = seed;
+
+    printf("Building %d iteration(s) in %d shard(s) with seed %" PRIu64
+           ".\n", SysEnv.map_gen_iters, num_shards, seed);
+    fflush(nullptr);
+
+    vector<stat_shard> leftover;
+#ifdef UNIX
+    vector<pair<pid_t, int> > children;
+    for (const stat_shard &shard : shards)
+    {
+        const pid_t pid = fork();
+        if (pid == 0)
+            _exit(_build_shard(shard) ? 0 : 1);
+        else if (pid == -1)
+            leftover.push_back(shard);
+        else
+            children.emplace_back(pid, shard.index);
+    }
+
+    for (const auto &child : children)
+    {
+        int status;
+        if (waitpid(child.first, &status, 0) == -1 || !WIFEXITED(status)
+            || WEXITSTATUS(status))
+        {
+            printf("Shard %d failed.\n", child.second);
+        }
+    }
+#else
+    leftover = shards;
+#endif
+
+    // Anything that couldn't be forked is built here, one after another.
+    for (const stat_shard &shard : leftover)
+        if (!_build_shard(shard))
+            printf("Shard %d failed.\n", shard.index);
+
+    printf("Merging shards.\n");
+    fflush(stdout);
+    _reset_stats();
+    bool complete = true;
+    for (stat_shard &shard : shards)
+    {
+        if (!_load_shard(shard, true))
+        {
+            printf("Unable to read %s.\n", _shard_file(shard.index).c_str());
+            return false;
+        }
+        if (shard.done < shard.last - shard.first)
+        {
+            printf("Shard %d is incomplete, with %d of %d iteration(s); "
+                   "run again to resume it.\n", shard.index, shard.done,
+                   shard.last - shard.first);
+            complete = false;
+        }
+    }
+    printf("Finished.\n");
+    fflush(stdout);
+    return complete;
+}
+
 /**
  * Build dungeon levels for mapstat or objstat.
  *
@@ -247,32 +763,17 @@ bool mapstat_build_levels()
 {
     if (!generated_levels.size())
         _dungeon_places();
+    if (SysEnv.map_gen_shards)
+        return _build_shards();
+
     printf("Iteration: ");
     fflush(stdout);
     for (int i = 0; i < SysEnv.map_gen_iters; ++i)
     {
-        clear_messages();
-        mprf("On %d of %d; %d g, %d fail, %u err%s, %u uniq, "
-             "%d try, %d (%.2f%%) vetoes",
-             i, SysEnv.map_gen_iters, levels_tried, levels_failed,
-             (unsigned int)errors.size(),
-             last_error.empty() ? "" : (" (" + last_error + ")").c_str(),
-             (unsigned int)use_count.size(), build_attempts, level_vetoes,
-             build_attempts ? level_vetoes * 100.0 / build_attempts : 0.0);
         printf("%d..", i + 1);
         fflush(stdout);
-        dlua.callfn("dgn_clear_data", "");
-        you.uniq_map_tags.clear();
-        you.uniq_map_names.clear();
-        you.uniq_map_tags_abyss.clear();
-        you.uniq_map_names_abyss.clear();
-        you.unique_creatures.reset();
-        initialise_branch_depths();
-        init_level_connectivity();
-        if (!_build_dungeon())
+        if (!_build_iteration(i))
             return false;
-        if (crawl_state.obj_stat_gen)
-            objstat_iteration_stats();
     }
     printf("Finished.\n");
     fflush(stdout);
@@ -341,6 +842,22 @@ static void _write_map_stats()
     fprintf(outf, "Levels attempted: %d, built: %d, failed: %d\n",
             levels_tried, levels_tried - levels_failed,
             levels_failed);
+
+    const map_selection_stats &sel = mapstat_selection_stats();
+    fprintf(outf, "Vault selection: %u queries, %.3f s total "
+                  "(%.1f us/query), %.1f maps examined and %.1f eligible "
+                  "per query\n",
+            sel.queries, sel.usecs / 1000000.0,
+            sel.queries ? (double) sel.usecs / sel.queries : 0.0,
+            sel.queries ? (double) sel.maps_examined / sel.queries : 0.0,
+            sel.queries ? (double) sel.maps_eligible / sel.queries : 0.0);
+    fprintf(outf, "%s\n", mapstat_describe_iteration_times().c_str());
+    const dlua_chunk_cache_stats chunks = _chunk_cache_stats();
+    fprintf(outf, "Lua chunks: %" PRIu64 " compiled or loaded, %" PRIu64
+                  " reused (%.1f%%)\n",
+            chunks.loads, chunks.hits,
+            chunks.hits ? chunks.hits * 100.0 / (chunks.hits + chunks.loads)
+                        : 0.0);
     if (!errors.empty())
     {
         fprintf(outf, "\n\nMap errors:\n");
@@ -463,6 +980,25 @@ static void _write_map_stats()
                 succ, uses, tries, entry.second.c_str());
     }
 
+    if (!map_lua_times.empty())
+    {
+        fprintf(outf, "\n\nMaps by Lua time (total ms, runs, mean ms), "
+                      "including subvaults and hooks:\n\n");
+        multimap<uint64_t, string> sortedtimes;
+        for (const auto &entry : map_lua_times)
+            sortedtimes.insert(make_pair(entry.second.second, entry.first));
+
+        int count = 0;
+        for (auto i = sortedtimes.rbegin();
+             i != sortedtimes.rend() && count < 100; ++i)
+        {
+            const int runs = map_lua_times[i->second].first;
+            fprintf(outf, "%3d) %9.1f, %6d, %7.2f: %s\n", ++count,
+                    i->first / 1000.0, runs, i->first / 1000.0 / runs,
+                    i->second.c_str());
+        }
+    }
+
     fprintf(outf, "\n\nMaps and where used:\n\n");
     for (const auto &entry : map_levelsused)
     {
@@ -490,6 +1026,41 @@ static void _write_map_stats()
     printf("\n");
 }
 
+string mapstat_describe_iteration_times()
+{
+    if (iteration_times.empty())
+        return "No iterations built";
+
+    uint64_t total = 0;
+    pair<int, uint64_t> slowest = iteration_times[0];
+    for (const auto &entry : iteration_times)
+    {
+        total += entry.second;
+        if (entry.second > slowest.second)
+            slowest = entry;
+    }
+    return make_stringf("Iteration time: %.1f s mean, %.1f s slowest "
+                        "(iteration %d)",
+                        total / 1000000.0 / iteration_times.size(),
+                        slowest.second / 1000000.0, slowest.first + 1);
+}
+
+void mapstat_write_iteration_times(const string &out_file)
+{
+    FILE *outf = fopen_u(out_file.c_str(), "w");
+    if (!outf)
+    {
+        printf("Unable to open %s: %s\n", out_file.c_str(), strerror(errno));
+        return;
+    }
+
+    fprintf(outf, "Iteration\tSeconds\n");
+    for (const auto &entry : iteration_times)
+        fprintf(outf, "%d\t%.3f\n", entry.first + 1, entry.second / 1000000.0);
+    fclose(outf);
+    printf("Wrote iteration times to %s.\n", out_file.c_str());
+}
+
 bool mapstat_find_forced_map()
 {
     const map_def *map = find_map_by_name(crawl_state.force_map);
@@ -536,9 +1107,14 @@ void mapstat_generate_stats()
            (int) generated_levels.size(), branch_count);
     fflush(stdout);
 
-    mapstat_build_levels();
+    if (!mapstat_build_levels())
+    {
+        printf("Map stats incomplete; not writing mapstat.log.\n");
+        return;
+    }
 
     _write_map_stats();
+    mapstat_write_iteration_times("mapstat_timing.log");
     printf("Map stats complete.\n");
 }
 
@@ -14,7 +14,10 @@ void mapstat_report_map_success(const string &map_name);
 void mapstat_report_error(const map_def &map, const string &err);
 void mapstat_report_map_build_start();
 void mapstat_report_map_veto(const string &message);
+void mapstat_report_map_lua_time(const string &map_name, uint64_t usecs);
 void mapstat_generate_stats();
 bool mapstat_build_levels();
 bool mapstat_find_forced_map();
+string mapstat_describe_iteration_times();
+void mapstat_write_iteration_times(const string &out_file);
 #endif
@@ -36,6 +36,7 @@
 #include "stepdown.h"
 #include "stringutil.h"
 #include "tag-version.h"
+#include "tags.h"
 #include "version.h"
 
 #ifdef DEBUG_STATISTICS
@@ -880,6 +881,215 @@ void objstat_iteration_stats()
     }
 }
 
+void objstat_reset_stats()
+{
+    item_recs.clear();
+    weapon_brands.clear();
+    armour_brands.clear();
+    missile_brands.clear();
+    monster_recs.clear();
+    feature_recs.clear();
+    _init_stats();
+}
+
+// Shard files name each stat field once, in a table ahead of the values, and
+// refer to it by index after that.
+struct stat_field_ids
+{
+    map<string, int> ids;
+    vector<string> names;
+
+    int id(const string &field)
+    {
+        auto it = ids.find(field);
+        if (it != ids.end())
+            return it->second;
+        ids[field] = names.size();
+        names.push_back(field);
+        return names.size() - 1;
+    }
+};
+
+static bool _is_min_field(const string &field)
+{
+    return ends_with(field, "Min");
+}
+
+static bool _is_max_field(const string &field)
+{
+    return ends_with(field, "Max");
+}
+
+// Only non-zero values are written. The per-iteration minimum and maximum
+// can legitimately be zero, so a missing one is read back as zero rather
+// than left alone.
+static void _marshall_stats(writer &th, const map<string, double> &stats,
+                            stat_field_ids &fields)
+{
+    vector<pair<int, int64_t> > values;
+    for (const auto &entry : stats)
+    {
+        if (!entry.second || entry.first == "NumForIter")
+            continue;
+        ASSERT(isfinite(entry.second));
+        values.emplace_back(fields.id(entry.first), (int64_t) entry.second);
+    }
+
+    marshallUnsigned(th, values.size());
+    for (const auto &value : values)
+    {
+        marshallUnsigned(th, value.first);
+        marshallSigned(th, value.second);
+    }
+}
+
+static bool _unmarshall_stats(reader &th, map<string, double> &stats,
+                              const vector<string> &fields)
+{
+    map<string, double> shard;
+    for (uint64_t count = unmarshallUnsigned(th); count > 0; --count)
+    {
+        const uint64_t id = unmarshallUnsigned(th);
+        if (id >= fields.size())
+            return false;
+        shard[fields[id]] = unmarshallSigned(th);
+    }
+
+    for (auto &entry : stats)
+    {
+        if (_is_min_field(entry.first))
+            entry.second = min(entry.second, lookup(shard, entry.first, 0.0));
+        else if (_is_max_field(entry.first))
+            entry.second = max(entry.second, lookup(shard, entry.first, 0.0));
+    }
+
+    for (const auto &entry : shard)
+    {
+        if (!_is_min_field(entry.first) && !_is_max_field(entry.first))
+            stats[entry.first] += entry.second;
+    }
+    return true;
+}
+
+static void _marshall_counts(writer &th, const vector<int> &counts)
+{
+    marshallUnsigned(th, count_if(counts.begin(), counts.end(),
+                                  [](int n) { return n != 0; }));
+    for (unsigned int i = 0; i < counts.size(); i++)
+    {
+        if (counts[i])
+        {
+            marshallUnsigned(th, i);
+            marshallSigned(th, counts[i]);
+        }
+    }
+}
+
+static bool _unmarshall_counts(reader &th, vector<int> &counts)
+{
+    for (uint64_t count = unmarshallUnsigned(th); count > 0; --count)
+    {
+        const uint64_t i = unmarshallUnsigned(th);
+        if (i >= counts.size())
+            return false;
+        counts[i] += unmarshallSigned(th);
+    }
+    return true;
+}
+
+/**
+ * Write the statistics gathered so far, for a sharded objstat run to merge
+ * later with objstat_load_stats(). The records must have been set up for
+ * the same levels in both places.
+ */
+void objstat_save_stats(writer &outf)
+{
+    vector<unsigned char> body;
+    writer bodyf(&body);
+    stat_field_ids fields;
+
+    marshallUnsigned(bodyf, item_recs.size());
+    for (const auto &entry : item_recs)
+    {
+        const level_id &lev = entry.first;
+        marshallSigned(bodyf, lev.branch);
+        marshallSigned(bodyf, lev.depth);
+
+        for (const auto &base_recs : entry.second)
+            for (const auto &stats : base_recs)
+                _marshall_stats(bodyf, stats, fields);
+
+        for (const auto &item_brands : weapon_brands[lev])
+            for (const auto &counts : item_brands)
+                _marshall_counts(bodyf, counts);
+        for (const auto &item_brands : armour_brands[lev])
+            for (const auto &counts : item_brands)
+                _marshall_counts(bodyf, counts);
+        for (const auto &counts : missile_brands[lev])
+            _marshall_counts(bodyf, counts);
+
+        for (const auto &mentry : monster_recs[lev])
+            _marshall_stats(bodyf, mentry.second, fields);
+        for (const auto &fentry : feature_recs[lev])
+            _marshall_stats(bodyf, fentry.second, fields);
+    }
+
+    marshallUnsigned(outf, fields.names.size());
+    for (const string &name : fields.names)
+        marshallString(outf, name);
+    outf.write(body.data(), body.size());
+}
+
+/**
+ * Add statistics written by objstat_save_stats() to those gathered so far.
+ *
+ * @returns False if the statistics were for a different set of levels or
+ * were damaged, in which case the records are left partly merged.
+ */
+bool objstat_load_stats(reader &inf)
+{
+    vector<string> fields(unmarshallUnsigned(inf));
+    for (string &name : fields)
+        name = unmarshallString(inf);
+
+    if (unmarshallUnsigned(inf) != item_recs.size())
+        return false;
+
+    for (auto &entry : item_recs)
+    {
+        const level_id &lev = entry.first;
+        const int branch = unmarshallSigned(inf);
+        const int depth = unmarshallSigned(inf);
+        if (branch != lev.branch || depth != lev.depth)
+            return false;
+
+        for (auto &base_recs : entry.second)
+            for (auto &stats : base_recs)
+                if (!_unmarshall_stats(inf, stats, fields))
+                    return false;
+
+        for (auto &item_brands : weapon_brands[lev])
+            for (auto &counts : item_brands)
+                if (!_unmarshall_counts(inf, counts))
+                    return false;
+        for (auto &item_brands : armour_brands[lev])
+            for (auto &counts : item_brands)
+                if (!_unmarshall_counts(inf, counts))
+                    return false;
+        for (auto &counts : missile_brands[lev])
+            if (!_unmarshall_counts(inf, counts))
+                return false;
+
+        for (auto &mentry : monster_recs[lev])
+            if (!_unmarshall_stats(inf, mentry.second, fields))
+                return false;
+        for (auto &fentry : feature_recs[lev])
+            if (!_unmarshall_stats(inf, fentry.second, fields))
+                return false;
+    }
+    return true;
+}
+
 static void _write_stat_headers(const vector<string> &fields, string desc)
 {
     fprintf(stat_outf, "%s\tLevel", desc.c_str());
@@ -1238,8 +1448,10 @@ static void _write_stat_info()
             "Number of branches: %d\n"
             "%s"
             "Number of levels: %d\n"
+            "%s\n"
             "Version: %s\n", SysEnv.map_gen_iters, num_branches,
-            all_desc.c_str(), num_levels, Version::Long);
+            all_desc.c_str(), num_levels,
+            mapstat_describe_iteration_times().c_str(), Version::Long);
 
     fclose(stat_outf);
     printf("Wrote Objstat Info to %s.\n", out_file.c_str());
@@ -1290,6 +1502,10 @@ static void _write_object_stats()
 
     printf("Wrote Feature stats to %s.\n", out_file.c_str());
     fclose(stat_outf);
+
+    out_file = make_stringf("%s%s%s", stat_out_prefix, "Timing",
+                            stat_out_ext);
+    mapstat_write_iteration_times(out_file);
 }
 
 void objstat_generate_stats()
@@ -6,9 +6,15 @@
 #pragma once
 
 #ifdef DEBUG_STATISTICS
+class reader;
+class writer;
+
 void objstat_record_item(const item_def &item);
 void objstat_generate_stats();
 void objstat_record_monster(const monster *mons);
 void objstat_record_feature(dungeon_feature_type feat_type, bool vault);
 void objstat_iteration_stats();
+void objstat_reset_stats();
+void objstat_save_stats(writer &outf);
+bool objstat_load_stats(reader &inf);
 #endif
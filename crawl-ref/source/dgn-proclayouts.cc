@@ -66,6 +66,84 @@ static uint32_t _get_changepoint(const worley::noise_datum &n, const double scal
     return max(1, (int) floor((n.distance[1] - n.distance[0]) * scale) - 5);
 }
 
+// Worley noise at each of points, at the coordinates given by
+// to_noise(index, x, y, z).
+template <typename F>
+static vector<worley::noise_datum> _worley_many(const vector<coord_def> &points,
+                                                F to_noise)
+{
+    const size_t count = points.size();
+    vector<double> x(count), y(count), z(count);
+    for (size_t i = 0; i < count; ++i)
+        to_noise(i, x[i], y[i], z[i]);
+
+    vector<worley::noise_datum> noise(count);
+    worley::noise_many(x.data(), y.data(), z.data(), count, noise.data());
+    return noise;
+}
+
+// The samples of a batch, where some points are worked out directly and the
+// rest are handed on to other layouts, which sample their share as batches
+// of their own. Indexing gives the samples back in the order they were added.
+class sample_batch
+{
+    public:
+        sample_batch(size_t layouts) : points(layouts), samples(layouts) { }
+
+        void add(const ProceduralSample &sample)
+        {
+            where.emplace_back(-1, own.size());
+            own.push_back(sample);
+        }
+
+        void hand_on(size_t layout, const coord_def &p)
+        {
+            where.emplace_back(layout, points[layout].size());
+            points[layout].push_back(p);
+        }
+
+        void sample(size_t index, const ProceduralLayout &layout,
+                    const uint32_t offset)
+        {
+            if (!points[index].empty())
+                layout.sample(points[index], offset, samples[index]);
+        }
+
+        const ProceduralSample &operator[](size_t i) const
+        {
+            const pair<int, size_t> &w = where[i];
+            return w.first < 0 ? own[w.second] : samples[w.first][w.second];
+        }
+
+    private:
+        vector<pair<int, size_t>> where;
+        vector<ProceduralSample> own;
+        vector<vector<coord_def>> points;
+        vector<vector<ProceduralSample>> samples;
+};
+
+void ProceduralLayout::sample(const vector<coord_def> &points,
+                              const uint32_t offset,
+                              vector<ProceduralSample> &out) const
+{
+    out.reserve(out.size() + points.size());
+    for (const coord_def &p : points)
+        out.push_back((*this)(p, offset));
+}
+
+uint8_t WorleyLayout::_choose(const coord_def &p, const worley::noise_datum &n,
+                              coord_def &pd) const
+{
+    const uint8_t size = layouts.size();
+    bool parity = n.id[0] % 4;
+    uint32_t id = n.id[0] / 4;
+    const uint8_t choice = parity
+        ? id % size
+        : min(id % size, (id / size) % size);
+    pd = p + id;
+    return (choice + seed) % size;
+}
+
 ProceduralSample
 WorleyLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -76,19 +154,47 @@ WorleyLayout::operator()(const coord_def &p, const uint32_t offset) const
     worley::noise_datum n = worley::noise(x, y, z + seed);
 
     const uint32_t changepoint = offset + _get_changepoint(n, offset_scale);
-    const uint8_t size = layouts.size();
-    bool parity = n.id[0] % 4;
-    uint32_t id = n.id[0] / 4;
-    const uint8_t choice = parity
-        ? id % size
-        : min(id % size, (id / size) % size);
-    const coord_def pd = p + id;
-    ProceduralSample sample = (*layouts[(choice + seed) % size])(pd, offset);
+    coord_def pd;
+    const uint8_t which = _choose(p, n, pd);
+    ProceduralSample sample = (*layouts[which])(pd, offset);
 
     return ProceduralSample(p, sample.feat(),
                 min(changepoint, sample.changepoint()));
 }
 
+void WorleyLayout::sample(const vector<coord_def> &points,
+                          const uint32_t offset,
+                          vector<ProceduralSample> &out) const
+{
+    const double offset_scale = 5000.0;
+    const vector<worley::noise_datum> noise = _worley_many(points,
+        [&](size_t i, double &x, double &y, double &z)
+        {
+            x = points[i].x / scale;
+            y = points[i].y / scale;
+            z = offset / offset_scale + seed;
+        });
+
+    sample_batch batch(layouts.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        coord_def pd;
+        const uint8_t which = _choose(points[i], noise[i], pd);
+        batch.hand_on(which, pd);
+    }
+    for (size_t j = 0; j < layouts.size(); ++j)
+        batch.sample(j, *layouts[j], offset);
+
+    out.reserve(out.size() + points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const uint32_t changepoint =
+            offset + _get_changepoint(noise[i], offset_scale);
+        out.emplace_back(points[i], batch[i].feat(),
+                         min(changepoint, batch[i].changepoint()));
+    }
+}
+
 ProceduralSample
 ChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -100,25 +206,46 @@ ChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
 }
 
 ProceduralSample
-RoilingChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
+RoilingChaosLayout::_sample(const coord_def &p, const uint32_t offset,
+                            const worley::noise_datum &n) const
 {
     const double scale = (density - 350) + 4800;
-    double x = p.x;
-    double y = p.y;
-    double z = offset / scale;
-    worley::noise_datum n = worley::noise(x, y, z);
     const uint32_t changepoint = offset + _get_changepoint(n, scale);
     ProceduralSample sample = ChaosLayout(n.id[0] + seed, density)(p, offset);
     return ProceduralSample(p, sample.feat(), min(sample.changepoint(), changepoint));
 }
 
 ProceduralSample
-WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
+RoilingChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
+    const double scale = (density - 350) + 4800;
     double x = p.x;
     double y = p.y;
-    double z = offset / 3;
-    worley::noise_datum n = worley::noise(x, y, z);
+    double z = offset / scale;
+    return _sample(p, offset, worley::noise(x, y, z));
+}
+
+void RoilingChaosLayout::sample(const vector<coord_def> &points,
+                                const uint32_t offset,
+                                vector<ProceduralSample> &out) const
+{
+    const double scale = (density - 350) + 4800;
+    const vector<worley::noise_datum> noise = _worley_many(points,
+        [&](size_t i, double &x, double &y, double &z)
+        {
+            x = points[i].x;
+            y = points[i].y;
+            z = offset / scale;
+        });
+    out.reserve(out.size() + points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        out.push_back(_sample(points[i], offset, noise[i]));
+}
+
+ProceduralSample
+WastesLayout::_sample(const coord_def &p, const uint32_t offset,
+                      const worley::noise_datum &n) const
+{
     const uint32_t changepoint = offset + _get_changepoint(n, 3);
     ProceduralSample sample = ChaosLayout(n.id[0], 10)(p, offset);
     dungeon_feature_type feat = feat_is_solid(sample.feat())
@@ -127,40 +254,148 @@ WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
 }
 
 ProceduralSample
-RiverLayout::operator()(const coord_def &p, const uint32_t offset) const
+WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
+{
+    double x = p.x;
+    double y = p.y;
+    double z = offset / 3;
+    return _sample(p, offset, worley::noise(x, y, z));
+}
+
+void WastesLayout::sample(const vector<coord_def> &points,
+                          const uint32_t offset,
+                          vector<ProceduralSample> &out) const
+{
+    const vector<worley::noise_datum> noise = _worley_many(points,
+        [&](size_t i, double &x, double &y, double &z)
+        {
+            x = points[i].x;
+            y = points[i].y;
+            z = offset / 3;
+        });
+    out.reserve(out.size() + points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        out.push_back(_sample(points[i], offset, noise[i]));
+}
+
+// Whether p is in a river, and if so what it's made of.
+bool RiverLayout::_river(const coord_def &p, const worley::noise_datum &n,
+                         dungeon_feature_type &feat) const
 {
-    const double scale = 10000;
     const double scalar = 90.0;
-    double x = (p.x + perlin::fBM(p.x/4.0, p.y/4.0, seed, 5) * 3) / scalar;
-    double y = (p.y + perlin::fBM(p.x/4.0 + 3.7, p.y/4.0 + 1.9, seed + 4, 5) * 3) / scalar;
-    worley::noise_datum n = worley::noise(x, y, offset / scale + seed);
-    const uint32_t changepoint = offset + _get_changepoint(n, scale);
     if ((n.id[0] ^ n.id[1] ^ seed) % 4)
-        return layout(p, offset);
+        return false;
 
     double delta = n.distance[1] - n.distance[0];
     if (delta < 1.5/scalar)
     {
-        dungeon_feature_type feat = DNGN_SHALLOW_WATER;
+        feat = DNGN_SHALLOW_WATER;
         uint64_t hash = hash3(p.x, p.y, n.id[0] + seed);
         if (!(hash % 5))
             feat = DNGN_DEEP_WATER;
         if (!(hash % 23))
             feat = DNGN_TREE;
-        return ProceduralSample(p, feat, changepoint);
+        return true;
     }
+    return false;
+}
+
+ProceduralSample
+RiverLayout::operator()(const coord_def &p, const uint32_t offset) const
+{
+    const double scale = 10000;
+    const double scalar = 90.0;
+    double x = (p.x + perlin::fBM(p.x/4.0, p.y/4.0, seed, 5) * 3) / scalar;
+    double y = (p.y + perlin::fBM(p.x/4.0 + 3.7, p.y/4.0 + 1.9, seed + 4, 5) * 3) / scalar;
+    worley::noise_datum n = worley::noise(x, y, offset / scale + seed);
+    const uint32_t changepoint = offset + _get_changepoint(n, scale);
+    dungeon_feature_type feat;
+    if (_river(p, n, feat))
+        return ProceduralSample(p, feat, changepoint);
     return layout(p, offset);
 }
 
+void RiverLayout::sample(const vector<coord_def> &points,
+                         const uint32_t offset,
+                         vector<ProceduralSample> &out) const
+{
+    const double scale = 10000;
+    const double scalar = 90.0;
+    const size_t count = points.size();
+
+    vector<double> x(count), y(count), x2(count), y2(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        x[i] = points[i].x/4.0;
+        y[i] = points[i].y/4.0;
+        x2[i] = points[i].x/4.0 + 3.7;
+        y2[i] = points[i].y/4.0 + 1.9;
+    }
+    vector<double> fbm_x(count), fbm_y(count);
+    perlin::fBM_many(x.data(), y.data(), seed, 5, count, fbm_x.data());
+    perlin::fBM_many(x2.data(), y2.data(), seed + 4, 5, count, fbm_y.data());
+
+    const vector<worley::noise_datum> noise = _worley_many(points,
+        [&](size_t i, double &nx, double &ny, double &nz)
+        {
+            nx = (points[i].x + fbm_x[i] * 3) / scalar;
+            ny = (points[i].y + fbm_y[i] * 3) / scalar;
+            nz = offset / scale + seed;
+        });
+
+    sample_batch batch(1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        dungeon_feature_type feat;
+        if (_river(points[i], noise[i], feat))
+        {
+            const uint32_t changepoint =
+                offset + _get_changepoint(noise[i], scale);
+            batch.add(ProceduralSample(points[i], feat, changepoint));
+        }
+        else
+            batch.hand_on(0, points[i]);
+    }
+    batch.sample(0, layout, offset);
+
+    out.reserve(out.size() + count);
+    for (size_t i = 0; i < count; ++i)
+        out.push_back(batch[i]);
+}
+
 ProceduralSample
 NewAbyssLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
     const double scale = 1.0 / 3.2;
-    uint64_t base = hash3(p.x, p.y, seed);
     worley::noise_datum noise = worley::noise(
             p.x * scale,
             p.y * scale,
             offset / 1000.0);
+    return _sample(p, offset, noise);
+}
+
+void NewAbyssLayout::sample(const vector<coord_def> &points,
+                            const uint32_t offset,
+                            vector<ProceduralSample> &out) const
+{
+    const double scale = 1.0 / 3.2;
+    const vector<worley::noise_datum> noise = _worley_many(points,
+        [&](size_t i, double &x, double &y, double &z)
+        {
+            x = points[i].x * scale;
+            y = points[i].y * scale;
+            z = offset / 1000.0;
+        });
+    out.reserve(out.size() + points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        out.push_back(_sample(points[i], offset, noise[i]));
+}
+
+ProceduralSample
+NewAbyssLayout::_sample(const coord_def &p, const uint32_t offset,
+                        const worley::noise_datum &noise) const
+{
+    uint64_t base = hash3(p.x, p.y, seed);
     dungeon_feature_type feat = DNGN_FLOOR;
 
     int dist = noise.distance[0] * 100;
@@ -280,6 +515,26 @@ LevelLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, feat, offset + 4096);
 }
 
+void LevelLayout::sample(const vector<coord_def> &points,
+                         const uint32_t offset,
+                         vector<ProceduralSample> &out) const
+{
+    sample_batch batch(1);
+    for (const coord_def &p : points)
+    {
+        const dungeon_feature_type feat = grid(clip(p));
+        if (feat == DNGN_UNSEEN)
+            batch.hand_on(0, p);
+        else
+            batch.add(ProceduralSample(p, feat, offset + 4096));
+    }
+    batch.sample(0, layout, offset);
+
+    out.reserve(out.size() + points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        out.push_back(batch[i]);
+}
+
 ProceduralSample
 NoiseLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -58,6 +58,11 @@ class ProceduralLayout
     public:
         virtual ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const = 0;
+        // Append to out the samples operator() would give at each of
+        // points, in order. Layouts built on noise override this to share
+        // the work between neighbouring points.
+        virtual void sample(const vector<coord_def> &points,
+            const uint32_t offset, vector<ProceduralSample> &out) const;
         virtual ~ProceduralLayout() { }
 };
 
@@ -101,7 +106,12 @@ class WorleyLayout : public ProceduralLayout
             seed(_seed), layouts(_layouts), scale(_scale) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
+        uint8_t _choose(const coord_def &p, const worley::noise_datum &n,
+            coord_def &pd) const;
+
         const uint32_t seed;
         const vector<const ProceduralLayout*> layouts;
         const float scale;
@@ -133,7 +143,12 @@ class RoilingChaosLayout : public ProceduralLayout
             seed(_seed), density(_density) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
+        ProceduralSample _sample(const coord_def &p, const uint32_t offset,
+            const worley::noise_datum &n) const;
+
         const uint32_t seed;
         const uint32_t density;
 };
@@ -145,6 +160,11 @@ class WastesLayout : public ProceduralLayout
         WastesLayout() { };
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
+    private:
+        ProceduralSample _sample(const coord_def &p, const uint32_t offset,
+            const worley::noise_datum &n) const;
 };
 
 class RiverLayout : public ProceduralLayout
@@ -154,7 +174,12 @@ class RiverLayout : public ProceduralLayout
             seed(_seed), layout(_layout) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
+        bool _river(const coord_def &p, const worley::noise_datum &n,
+            dungeon_feature_type &feat) const;
+
         const uint32_t seed;
         const ProceduralLayout &layout;
 };
@@ -166,7 +191,12 @@ class NewAbyssLayout : public ProceduralLayout
         NewAbyssLayout(uint32_t _seed) : seed(_seed) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
+        ProceduralSample _sample(const coord_def &p, const uint32_t offset,
+            const worley::noise_datum &noise) const;
+
         const uint32_t seed;
 };
 
@@ -179,6 +209,8 @@ class LevelLayout : public ProceduralLayout
             const ProceduralLayout &_layout);
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
         feature_grid grid;
         uint32_t seed;
@@ -21,6 +21,60 @@ static int dlua_compiled_chunk_writer(lua_State *ls, const void *p,
     return 0;
 }
 
+// Functions loaded from compiled chunks are kept in a registry table of the
+// interpreter, keyed by their bytecode. Maps are resolved over and over during
+// level generation, and the same chunk would otherwise be undumped each time.
+// The key includes the chunk's whole bytecode, so copies of a map_def share
+// the entry and a changed chunk never matches a stale one.
+static const char *DLUA_CHUNK_CACHE = "dlua_chunk_cache";
+static dlua_chunk_cache_stats chunk_cache_stats;
+
+const dlua_chunk_cache_stats &dlua_chunk_cache_counts()
+{
+    return chunk_cache_stats;
+}
+
+static bool _push_cached_chunk(lua_State *ls, const string &compiled)
+{
+    lua_getfield(ls, LUA_REGISTRYINDEX, DLUA_CHUNK_CACHE);
+    if (!lua_istable(ls, -1))
+    {
+        lua_pop(ls, 1);
+        return false;
+    }
+    lua_pushlstring(ls, compiled.data(), compiled.size());
+    lua_rawget(ls, -2);
+    lua_remove(ls, -2);
+    if (!lua_isfunction(ls, -1))
+    {
+        lua_pop(ls, 1);
+        return false;
+    }
+
+    // dgn_run_map() sets a map's environment on the function before each
+    // call; anything else expects a freshly loaded chunk's globals.
+    lua_pushvalue(ls, LUA_GLOBALSINDEX);
+    lua_setfenv(ls, -2);
+    return true;
+}
+
+// Remember the function on top of the stack, leaving it there.
+static void _cache_chunk(lua_State *ls, const string &compiled)
+{
+    lua_getfield(ls, LUA_REGISTRYINDEX, DLUA_CHUNK_CACHE);
+    if (!lua_istable(ls, -1))
+    {
+        lua_pop(ls, 1);
+        lua_newtable(ls);
+        lua_pushvalue(ls, -1);
+        lua_setfield(ls, LUA_REGISTRYINDEX, DLUA_CHUNK_CACHE);
+    }
+    lua_pushlstring(ls, compiled.data(), compiled.size());
+    lua_pushvalue(ls, -3);
+    lua_rawset(ls, -3);
+    lua_pop(ls, 1);
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // dlua_chunk
 
@@ -151,9 +205,21 @@ int dlua_chunk::load(CLua &interp)
 {
     if (!compiled.empty())
     {
-        return check_op(interp,
-                         interp.loadbuffer(compiled.c_str(), compiled.length(),
-                                           context.c_str()));
+        if (_push_cached_chunk(interp, compiled))
+        {
+            chunk_cache_stats.hits++;
+            error.clear();
+            return 0;
+        }
+
+        chunk_cache_stats.loads++;
+        const int err = check_op(interp,
+                                 interp.loadbuffer(compiled.c_str(),
+                                                   compiled.length(),
+                                                   context.c_str()));
+        if (!err)
+            _cache_chunk(interp, compiled);
+        return err;
     }
 
     if (empty())
@@ -162,6 +228,7 @@ int dlua_chunk::load(CLua &interp)
         return E_CHUNK_LOAD_FAILURE;
     }
 
+    chunk_cache_stats.loads++;
     int err = check_op(interp,
                         interp.loadstring(chunk.c_str(), context.c_str()));
     if (err)
@@ -175,6 +242,8 @@ int dlua_chunk::load(CLua &interp)
         lua_pop(interp, 2);
     }
     compiled = out.str();
+    if (!err)
+        _cache_chunk(interp, compiled);
     return err;
 }
 
@@ -72,4 +72,12 @@ public:
     void read(reader&);
 };
 
+struct dlua_chunk_cache_stats
+{
+    uint64_t hits = 0;    // loads served by an already-loaded function
+    uint64_t loads = 0;   // chunks compiled or undumped
+};
+
+const dlua_chunk_cache_stats &dlua_chunk_cache_counts();
+
 void init_dungeon_lua();
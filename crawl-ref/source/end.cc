@@ -23,7 +23,6 @@
 #include "initfile.h"
 #include "invent.h"
 #include "item-prop.h"
-#include "los.h"
 #include "macro.h"
 #include "message.h"
 #include "misc.h"
@@ -85,7 +84,6 @@ void cio_cleanup()
 // Clear some globally defined variables.
 static void _clear_globals_on_exit()
 {
-    clear_rays_on_exit();
     clear_zap_info_on_exit();
     destroy_abyss();
 }
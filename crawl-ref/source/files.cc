@@ -1826,6 +1826,20 @@ bool pregen_dungeon(const level_id &stopping_point)
         ui::progress_popup progress("Generating dungeon...\n\n", 35);
         progress.advance_progress();
 
+        // The levels themselves have to be built one at a time: they share
+        // their branch's rng, and uniques, artefacts and unique vaults
+        // placed on one level affect the next. But each saved level can be
+        // compressed while the next one is built.
+        you.save->set_background_compression(true);
+        ON_UNWIND
+        {
+            you.save->set_background_compression(false);
+            const background_stats &bg = you.save->get_background_stats();
+            dprf("Compressed %d levels in %d ms, %d ms of it while building.",
+                 bg.chunks, bg.compress_ms, bg.compress_ms - bg.wait_ms);
+        };
+        bool generated = true;
+
         for (const level_id &new_level : to_generate)
         {
             string status = "\nbuilding ";
@@ -1851,10 +1865,13 @@ bool pregen_dungeon(const level_id &stopping_point)
 
             // (save chunk existence is checked above, so isn't relevant here)
             if (!generate_level(new_level))
-                return false; // level failed to generate -- bail immediately
+            {
+                generated = false; // level failed to generate -- bail now
+                break;
+            }
         }
 
-        return true;
+        return generated;
     }
 }
 
@@ -3106,6 +3123,15 @@ bool is_existing_level(const level_id &level)
     return you.save && you.save->has_chunk(level.describe());
 }
 
+// Write the current level to the save and read it straight back, as a
+// level excursion does. Only used to time the save code.
+void reload_current_level()
+{
+    const level_id here = level_id::current();
+    _save_level(here);
+    _load_level(here);
+}
+
 void delete_level(const level_id &level)
 {
     travel_cache.erase_level_info(level);
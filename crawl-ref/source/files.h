@@ -103,6 +103,7 @@ bool save_exists(const string& filename);
 bool restore_game(const string& filename);
 
 bool is_existing_level(const level_id &level);
+void reload_current_level();
 
 class level_excursion
 {
@@ -49,6 +49,7 @@
 #include "state.h"
 #include "status.h"
 #include "stringutil.h"
+#include "syscalls.h"
 #ifdef USE_TILE
  #include "tilepick.h"
 #endif
@@ -63,11 +64,41 @@ using namespace ui;
 
 #define SCORE_VERSION "0.1"
 
-// enough memory allocated to snarf in the scorefile entries
+// The ranked scores, as raw scorefile lines with their points. Entries are
+// only parsed into hs_list when something looks at them.
+struct score_line
+{
+    int points;
+    string line;
+};
+
+static vector<score_line> hs_lines;
 static unique_ptr<scorefile_entry> hs_list[SCORE_FILE_ENTRIES];
 static int hs_list_size = 0;
 static bool hs_list_initalized = false;
 
+// The index kept beside the scores file: a header, then the points and
+// length in bytes of each line of the file in order. It lets the scores be
+// merged and loaded without parsing the lines; view_size, and each line
+// ending where the index says, tell when the file was rewritten without it.
+static const uint32_t SCORE_INDEX_MAGIC = 0x44435349; // "DCSI"
+static const uint32_t SCORE_INDEX_VERSION = 1;
+
+struct score_index_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t unused;
+    uint64_t view_size;
+};
+
+struct score_index_entry
+{
+    int32_t points;
+    uint32_t length;
+};
+
 static FILE *_hs_open(const char *mode, const string &filename);
 static void  _hs_close(FILE *handle);
 static bool  _hs_read(FILE *scores, scorefile_entry &dest);
@@ -76,6 +107,8 @@ static time_t _parse_time(const string &st);
 static string _xlog_escape(const string &s);
 static string _xlog_unescape(const string &s);
 static vector<string> _xlog_split_fields(const string &s);
+static bool _load_score_view();
+static bool _merge_score_journal();
 
 static string _score_file_name()
 {
@@ -92,98 +125,58 @@ static string _score_file_name()
     return ret;
 }
 
-static string _log_file_name()
+static string _score_journal_name()
 {
-    return Options.shared_dir + "logfile" + crawl_state.game_type_qualifier();
+    return _score_file_name() + ".journal";
 }
 
-int hiscores_new_entry(const scorefile_entry &ne)
+static string _score_index_name()
 {
-    unwind_bool score_update(crawl_state.updating_scores, true);
-
-    FILE *scores;
-    int i;
-    bool inserted = false;
-    int newest_entry = -1;
-
-    // open highscore file (reading) -- nullptr is fatal!
-    //
-    // Opening as a+ instead of r+ to force an exclusive lock (see
-    // hs_open) and to create the file if it's not there already.
-    scores = _hs_open("a+", _score_file_name());
-    if (scores == nullptr)
-        end(1, true, "failed to open score file for writing");
+    return _score_file_name() + ".idx";
+}
 
-    // we're at the end of the file, seek back to beginning.
-    fseek(scores, 0, SEEK_SET);
+static string _log_file_name()
+{
+    return Options.shared_dir + "logfile" + crawl_state.game_type_qualifier();
+}
 
-    // read highscore file, inserting new entry at appropriate point,
-    for (i = 0; i < SCORE_FILE_ENTRIES; i++)
+static scorefile_entry &_hs_entry(int i)
+{
+    ASSERT_RANGE(i, 0, hs_list_size);
+    if (!hs_list[i])
     {
         hs_list[i].reset(new scorefile_entry);
-        if (_hs_read(scores, *hs_list[i]) == false)
-            break;
-
-        // compare points..
-        if (!inserted && ne.get_score() >= hs_list[i]->get_score())
-        {
-            newest_entry = i;           // for later printing
-            inserted = true;
-            // copy read entry to i+1th position
-            // Fixed a nasty overflow bug here -- Sharp
-            if (i+1 < SCORE_FILE_ENTRIES)
-            {
-                hs_list[i + 1] = move(hs_list[i]);
-                hs_list[i].reset(new scorefile_entry(ne));
-                i++;
-            }
-            else
-                *hs_list[i] = ne; // copy new entry to current position
-        }
-    }
-
-    // special case: lowest score, with room
-    if (!inserted && i < SCORE_FILE_ENTRIES)
-    {
-        newest_entry = i;
-        inserted = true;
-        // copy new entry
-        hs_list[i].reset(new scorefile_entry(ne));
-        i++;
-    }
-
-    hs_list_size = i;
-    hs_list_initalized = true;
-
-    // If we've still not inserted it, it's not a highscore.
-    if (!inserted)
-    {
-        _hs_close(scores);
-        return -1;
+        hs_list[i]->parse(hs_lines[i].line);
     }
+    return *hs_list[i];
+}
 
-    // The old code closed and reopened the score file, leading to a
-    // race condition where one Crawl process could overwrite the
-    // other's highscore. Now we truncate and rewrite the file without
-    // closing it.
-    if (ftruncate(fileno(scores), 0))
-        end(1, true, "unable to truncate scorefile");
+int hiscores_new_entry(const scorefile_entry &ne)
+{
+    unwind_bool score_update(crawl_state.updating_scores, true);
 
-    rewind(scores);
+    // Adding the game to the journal holds its lock for a single write, so
+    // games ending together don't queue behind each other here. Whoever
+    // updates the scores next merges it into the ranked view.
+    const string line = ne.raw_string();
+    FILE *journal = _hs_open("a", _score_journal_name());
+    if (journal == nullptr)
+        end(1, true, "failed to open score file for writing");
+    fputs(line.c_str(), journal);
+    _hs_close(journal);
 
-    // write scorefile entries.
-    for (i = 0; i < hs_list_size; i++)
-    {
-        _hs_write(scores, *hs_list[i]);
+    // If another game has the scores file locked, this one stays in the
+    // journal for the next merge, and is ranked from the scores file and
+    // the journal as they stand.
+    if (!_merge_score_journal() && !_load_score_view())
+        end(1, true, "failed to read score file");
 
-        // Leave in memory. Does this anyway if !inserted.
-        // Can write cleanup function if nessicary??
-        // hs_list[i].reset(nullptr);
-    }
+    // If it isn't in the view, it's not a highscore.
+    for (int i = 0; i < hs_list_size; i++)
+        if (hs_lines[i].line == line)
+            return i;
 
-    // close scorefile.
-    _hs_close(scores);
-    return newest_entry;
+    return -1;
 }
 
 void logfile_new_entry(const scorefile_entry &ne)
@@ -231,27 +224,7 @@ static void _hiscores_print_entry(const scorefile_entry &se,
 // Reads hiscores file to memory
 void hiscores_read_to_memory()
 {
-    FILE *scores;
-    int i;
-
-    // open highscore file (reading)
-    scores = _hs_open("r", _score_file_name());
-    if (scores == nullptr)
-        return;
-
-    // read highscore file
-    for (i = 0; i < SCORE_FILE_ENTRIES; i++)
-    {
-        hs_list[i].reset(new scorefile_entry);
-        if (_hs_read(scores, *hs_list[i]) == false)
-            break;
-    }
-
-    hs_list_size = i;
-    hs_list_initalized = true;
-
-    //close off
-    _hs_close(scores);
+    _load_score_view();
 }
 
 // Writes all entries in the scorefile to stdout in human-readable form.
@@ -259,27 +232,41 @@ void hiscores_print_all(int display_count, int format)
 {
     unwind_bool scorefile_display(crawl_state.updating_scores, true);
 
-    FILE *scores = _hs_open("r", _score_file_name());
-    if (scores == nullptr)
+    if (_score_file_name() == "-")
+    {
+        for (int entry = 0; display_count <= 0 || entry < display_count;
+             ++entry)
+        {
+            scorefile_entry se;
+            if (!_hs_read(stdin, se))
+                break;
+
+            if (format == -1)
+                printf("%s", se.raw_string().c_str());
+            else
+                _hiscores_print_entry(se, entry, format, printf);
+        }
+        return;
+    }
+
+    // Games still waiting in the journal are shown in their places too,
+    // without writing anything.
+    if (!_load_score_view())
     {
         // will only happen from command line
         puts("No scores.");
         return;
     }
 
-    for (int entry = 0; display_count <= 0 || entry < display_count; ++entry)
+    for (int entry = 0; entry < hs_list_size
+                        && (display_count <= 0 || entry < display_count);
+         ++entry)
     {
-        scorefile_entry se;
-        if (!_hs_read(scores, se))
-            break;
-
         if (format == -1)
-            printf("%s", se.raw_string().c_str());
+            printf("%s", _hs_entry(entry).raw_string().c_str());
         else
-            _hiscores_print_entry(se, entry, format, printf);
+            _hiscores_print_entry(_hs_entry(entry), entry, format, printf);
     }
-
-    _hs_close(scores);
 }
 
 // Displays high scores using curses. For output to the console, use
@@ -317,7 +304,7 @@ string hiscores_print_list(int display_count, int format, int newest_entry, int&
         if (i == newest_entry)
             ret += "<yellow>";
 
-        _hiscores_print_entry(*hs_list[i], i, format, [&ret](const char */*fmt*/, const char *s){
+        _hiscores_print_entry(_hs_entry(i), i, format, [&ret](const char */*fmt*/, const char *s){
             ret += string(s);
         });
 
@@ -456,24 +443,11 @@ UIHiscoresMenu::UIHiscoresMenu()
 
 void UIHiscoresMenu::_construct_hiscore_table()
 {
-    FILE *scores = _hs_open("r", _score_file_name());
-
-    if (scores == nullptr)
+    if (!_load_score_view())
         return;
 
-    int i;
-    // read highscore file
-    for (i = 0; i < SCORE_FILE_ENTRIES; i++)
-    {
-        hs_list[i].reset(new scorefile_entry);
-        if (_hs_read(scores, *hs_list[i]) == false)
-            break;
-    }
-
-    _hs_close(scores);
-
-    for (int j=0; j<i; j++)
-        _add_hiscore_row(*hs_list[j], j);
+    for (int j = 0; j < hs_list_size; j++)
+        _add_hiscore_row(_hs_entry(j), j);
 }
 
 void UIHiscoresMenu::_add_hiscore_row(scorefile_entry& se, int id)
@@ -485,7 +459,7 @@ void UIHiscoresMenu::_add_hiscore_row(scorefile_entry& se, int id)
     tmp->set_margin_for_sdl(2);
     btn->set_child(move(tmp));
     btn->on_activate_event([id](const ActivateEvent&) {
-        _show_morgue(*hs_list[id]);
+        _show_morgue(_hs_entry(id));
         return true;
     });
     btn->on_focusin_event([this, se](const FocusEvent&) {
@@ -650,6 +624,261 @@ static void _hs_write(FILE *scores, scorefile_entry &se)
     fprintf(scores, "%s", se.raw_string().c_str());
 }
 
+// The points of a scorefile line, without parsing the rest of it.
+static int _xlog_points(const string &line)
+{
+    for (const string &field : _xlog_split_fields(line))
+        if (starts_with(field, "sc="))
+            return atoi(field.c_str() + 3);
+    return 0;
+}
+
+static string _read_whole_file(FILE *handle)
+{
+    string contents;
+    char buf[4096];
+    size_t got;
+    while ((got = fread(buf, 1, sizeof buf, handle)) > 0)
+        contents.append(buf, got);
+    return contents;
+}
+
+// Split text into lines, keeping their newlines, and skipping any that
+// aren't xlog lines.
+static vector<score_line> _split_score_lines(const string &text)
+{
+    vector<score_line> lines;
+    string::size_type start = 0;
+    while (start < text.length())
+    {
+        string::size_type end = text.find('\n', start);
+        end = end == string::npos ? text.length() : end + 1;
+        string line = text.substr(start, end - start);
+        start = end;
+
+        if (line.empty() || line[0] == ':' || line[0] == '\n')
+        {
+            dprf("Corrupted xlog-line: %s", line.c_str());
+            continue;
+        }
+        const int points = _xlog_points(line);
+        lines.push_back({ points, move(line) });
+    }
+    return lines;
+}
+
+// Split the scores file by its index, or by lines if the index is missing
+// or doesn't match the file.
+static vector<score_line> _read_score_view(FILE *view, bool &indexed)
+{
+    fseek(view, 0, SEEK_SET);
+    const string text = _read_whole_file(view);
+
+    vector<score_line> lines;
+    FILE *index = fopen_u(_score_index_name().c_str(), "rb");
+    if (index)
+    {
+        score_index_header header;
+        if (fread(&header, sizeof header, 1, index) == 1
+            && header.magic == SCORE_INDEX_MAGIC
+            && header.version == SCORE_INDEX_VERSION
+            && header.view_size == text.length()
+            && header.count <= SCORE_FILE_ENTRIES)
+        {
+            vector<score_index_entry> entries(header.count);
+            size_t pos = 0;
+            if (fread(entries.data(), sizeof(score_index_entry),
+                      entries.size(), index) == entries.size())
+            {
+                for (const score_index_entry &entry : entries)
+                {
+                    if (!entry.length || pos + entry.length > text.length()
+                        || text[pos + entry.length - 1] != '\n')
+                    {
+                        break;
+                    }
+                    lines.push_back({ entry.points,
+                                      text.substr(pos, entry.length) });
+                    pos += entry.length;
+                }
+            }
+            if (pos != text.length())
+                lines.clear();
+        }
+        fclose(index);
+    }
+
+    indexed = !lines.empty() || text.empty();
+    if (!indexed)
+        lines = _split_score_lines(text);
+    if (lines.size() > SCORE_FILE_ENTRIES)
+        lines.resize(SCORE_FILE_ENTRIES);
+    return lines;
+}
+
+// Rewrite the scores file and its index, making sure both are on disk.
+static bool _write_score_view(FILE *view, const vector<score_line> &lines)
+{
+    // Truncate and rewrite the file without closing it, so that another
+    // Crawl process can't get in between.
+    if (ftruncate(fileno(view), 0))
+        end(1, true, "unable to truncate scorefile");
+    rewind(view);
+
+    score_index_header header = { SCORE_INDEX_MAGIC, SCORE_INDEX_VERSION,
+                                  (uint32_t) lines.size(), 0, 0 };
+    vector<score_index_entry> entries;
+    for (const score_line &sl : lines)
+    {
+        fputs(sl.line.c_str(), view);
+        entries.push_back({ sl.points, (uint32_t) sl.line.length() });
+        header.view_size += sl.line.length();
+    }
+    if (fflush(view) || fdatasync(fileno(view)))
+        return false;
+
+    // Written while the scores file is still locked; if this fails, the
+    // index no longer matches the file and will be rebuilt from it.
+    FILE *index = fopen_u(_score_index_name().c_str(), "wb");
+    if (!index)
+        return false;
+    fwrite(&header, sizeof header, 1, index);
+    fwrite(entries.data(), sizeof(score_index_entry), entries.size(), index);
+    const bool synced = !fflush(index) && !fdatasync(fileno(index));
+    fclose(index);
+    return synced;
+}
+
+// Insert a game into the ranked scores below the first better one, as long
+// as it makes the top SCORE_FILE_ENTRIES.
+static void _insert_score(vector<score_line> &lines, score_line sl)
+{
+    auto pos = find_if(lines.begin(), lines.end(),
+                       [&sl](const score_line &other)
+                       { return sl.points >= other.points; });
+    if (pos == lines.end() && lines.size() >= SCORE_FILE_ENTRIES)
+        return;
+    lines.insert(pos, move(sl));
+    if (lines.size() > SCORE_FILE_ENTRIES)
+        lines.pop_back();
+}
+
+// Rank the games from the journal among the scores, and return how many
+// there were. A game already in the scores, because a merge was cut short
+// before it emptied the journal, isn't added again.
+static int _insert_journal_scores(vector<score_line> &lines,
+                                  const string &journal)
+{
+    vector<score_line> pending = _split_score_lines(journal);
+    for (score_line &sl : pending)
+    {
+        if (none_of(lines.begin(), lines.end(),
+                    [&sl](const score_line &other)
+                    { return other.line == sl.line; }))
+        {
+            _insert_score(lines, move(sl));
+        }
+    }
+    return pending.size();
+}
+
+static void _set_score_view(vector<score_line> lines)
+{
+    if (lines.size() > SCORE_FILE_ENTRIES)
+        lines.resize(SCORE_FILE_ENTRIES);
+    hs_lines = move(lines);
+    hs_list_size = hs_lines.size();
+    for (auto &entry : hs_list)
+        entry.reset();
+    hs_list_initalized = true;
+}
+
+/**
+ * Load the ranked scores into memory, with any games waiting in the journal
+ * ranked among them. Nothing is written, so only shared locks are taken.
+ *
+ * @return Whether the scores file or the journal could be read.
+ */
+static bool _load_score_view()
+{
+    vector<score_line> lines;
+
+    FILE *view = _hs_open("r", _score_file_name());
+    if (view == stdin)
+        lines = _split_score_lines(_read_whole_file(view));
+    else if (view)
+    {
+        bool indexed;
+        lines = _read_score_view(view, indexed);
+    }
+    bool found = view != nullptr;
+
+    // The journal is read while the scores file is still locked, so that a
+    // merge can't move games out of it in between.
+    if (view != stdin)
+    {
+        if (FILE *journal = _hs_open("r", _score_journal_name()))
+        {
+            _insert_journal_scores(lines, _read_whole_file(journal));
+            _hs_close(journal);
+            found = true;
+        }
+    }
+    _hs_close(view);
+
+    if (!found)
+        return false;
+
+    _set_score_view(move(lines));
+    return true;
+}
+
+/**
+ * Merge the games waiting in the journal into the scores file, and load the
+ * result into memory. If another process has the scores file locked, this
+ * doesn't wait for it; the games stay in the journal for the next merge.
+ *
+ * @return Whether the scores file could be locked for the merge.
+ */
+static bool _merge_score_journal()
+{
+    const string name = _score_file_name();
+    if (name == "-")
+        return false;
+
+    // Opening as a+ rather than r+ to create the file if it's not there
+    // already.
+    FILE *view = fopen_u(name.c_str(), "a+");
+    if (!view)
+        return false;
+    if (!lock_file(fileno(view), true))
+    {
+        fclose(view);
+        return false;
+    }
+
+    bool indexed;
+    vector<score_line> lines = _read_score_view(view, indexed);
+
+    FILE *journal = _hs_open("r+", _score_journal_name());
+    const int pending = journal
+        ? _insert_journal_scores(lines, _read_whole_file(journal)) : 0;
+
+    bool written = true;
+    if (pending || !indexed)
+        written = _write_score_view(view, lines);
+
+    // The games only leave the journal once the scores file and its index
+    // are safely on disk.
+    if (pending && written && ftruncate(fileno(journal), 0))
+        end(1, true, "unable to truncate score journal");
+    _hs_close(journal);
+    _hs_close(view);
+
+    _set_score_view(move(lines));
+    return true;
+}
+
 static const char *kill_method_names[] =
 {
     "mon", "pois", "cloud", "beam", "lava", "water",
@@ -229,6 +229,8 @@ const vector<GameOption*> game_options::build_options_list()
         new BoolGameOption(SIMPLE_NAME(arena_dump_msgs), false),
         new BoolGameOption(SIMPLE_NAME(arena_dump_msgs_all), false),
         new BoolGameOption(SIMPLE_NAME(arena_list_eq), false),
+        new BoolGameOption(SIMPLE_NAME(arena_dump_trials), false),
+        new StringGameOption(SIMPLE_NAME(arena_result_file), "arena.result"),
         new BoolGameOption(SIMPLE_NAME(default_manual_training), false),
         new BoolGameOption(SIMPLE_NAME(one_SDL_sound_channel), false),
         new BoolGameOption(SIMPLE_NAME(sounds_on), true),
@@ -260,6 +262,9 @@ const vector<GameOption*> game_options::build_options_list()
         new IntGameOption(SIMPLE_NAME(hp_warning), 30, 0, 100),
         new IntGameOption(magic_point_warning, {"mp_warning"}, 0, 0, 100),
         new IntGameOption(SIMPLE_NAME(autofight_warning), 0, 0, 1000),
+        new IntGameOption(SIMPLE_NAME(lua_gc_pause), 0, 0, 1000),
+        new IntGameOption(SIMPLE_NAME(lua_gc_stepmul), 0, 0, 1000),
+        new IntGameOption(SIMPLE_NAME(abyss_sample_threads), 1, 1, 64),
         // These need to be odd, hence allow +1.
         new IntGameOption(SIMPLE_NAME(view_max_width),
                       max(VIEW_BASE_WIDTH, VIEW_MIN_WIDTH),
@@ -408,6 +413,7 @@ const vector<GameOption*> game_options::build_options_list()
         new StringGameOption(SIMPLE_NAME(fsim_mode), ""),
         new StringGameOption(SIMPLE_NAME(fsim_mons), ""),
         new IntGameOption(SIMPLE_NAME(fsim_rounds), 4000, 1000, 500000),
+        new IntGameOption(SIMPLE_NAME(fsim_jobs), 1, 1, 64),
 #endif
 #if !defined(DGAMELAUNCH) || defined(DGL_REMEMBER_NAME)
         new BoolGameOption(SIMPLE_NAME(remember_name), true),
@@ -979,8 +985,12 @@ static string _get_save_path(string subdir)
     return _resolve_dir(SysEnv.crawl_dir, subdir);
 }
 
+static unsigned int _options_generation = 0;
+
 void game_options::reset_options()
 {
+    generation = ++_options_generation;
+
     // XXX: do we really need to rebuild the list and map every time?
     // Will they ever change within a single execution of Crawl?
     // GameOption::value's value will change of course, but not the reference.
@@ -1069,6 +1079,8 @@ void game_options::reset_options()
     arena_dump_msgs        = false;
     arena_dump_msgs_all    = false;
     arena_list_eq          = false;
+    arena_dump_trials      = false;
+    arena_result_file      = "arena.result";
 
     // Sort only pickup menus by default.
     sort_menus.clear();
@@ -2007,6 +2019,9 @@ void game_options::fixup_options()
 
     if (!check_mkdir("Morgue directory", &morgue_dir))
         end(1, false, "Cannot create morgue directory '%s'", morgue_dir.c_str());
+
+    clua.set_gc_params(lua_gc_pause, lua_gc_stepmul);
+    dlua.set_gc_params(lua_gc_pause, lua_gc_stepmul);
 }
 
 static int _str_to_killcategory(const string &s)
@@ -2505,6 +2520,8 @@ void game_options::read_option_line(const string &str, bool runscript)
         else                                                                   \
             _opt.push_back(_conv(part));                                       \
     }
+    generation = ++_options_generation;
+
     string key    = "";
     string subkey = "";
     string field  = "";
@@ -3885,6 +3902,7 @@ enum commandline_option_type
     CLO_OBJSTAT,
     CLO_ITERATIONS,
     CLO_FORCE_MAP,
+    CLO_SHARDS,
     CLO_ARENA,
     CLO_DUMP_MAPS,
     CLO_TEST,
@@ -3918,6 +3936,7 @@ enum commandline_option_type
     CLO_WEBTILES_SOCKET,
     CLO_AWAIT_CONNECTION,
     CLO_PRINT_WEBTILES_OPTIONS,
+    CLO_WEBTILES_PACKED_MAP,
 #endif
 
     CLO_NOPS
@@ -3927,14 +3946,16 @@ static const char *cmd_ops[] =
 {
     "scores", "name", "species", "background", "dir", "rc", "rcdir", "tscores",
     "vscores", "scorefile", "morgue", "macro", "mapstat", "dump-disconnect",
-    "objstat", "iters", "force-map", "arena", "dump-maps", "test", "script",
-    "builddb", "help", "version", "seed", "pregen", "save-version", "sprint",
+    "objstat", "iters", "force-map", "shards", "arena", "dump-maps", "test",
+    "script", "builddb", "help", "version", "seed", "pregen", "save-version",
+    "sprint",
     "extra-opt-first", "extra-opt-last", "sprint-map", "edit-save",
     "print-charset", "tutorial", "wizard", "explore", "no-save", "gdb",
     "no-gdb", "nogdb", "throttle", "no-throttle", "playable-json",
     "branches-json", "save-json", "gametypes-json", "bones",
 #ifdef USE_TILE_WEB
     "webtiles-socket", "await-connection", "print-webtiles-options",
+    "webtiles-packed-map",
 #endif
 };
 
@@ -4686,6 +4707,7 @@ bool parse_args(int argc, char **argv, bool rc_only)
 
     SysEnv.rcdirs.clear();
     SysEnv.map_gen_iters = 0;
+    SysEnv.map_gen_shards = 0;
 
     if (argc < 2)           // no args!
         return true;
@@ -4877,6 +4899,20 @@ bool parse_args(int argc, char **argv, bool rc_only)
 #endif
             break;
 
+        case CLO_SHARDS:
+#ifdef DEBUG_STATISTICS
+            if (!next_is_param || !isadigit(*next_arg))
+                end(1, false, "Integer argument required for -%s\n", arg);
+            else
+            {
+                SysEnv.map_gen_shards = min(max(atoi(next_arg), 1), 256);
+                nextUsed = true;
+            }
+#else
+            end(1, false, "%s", dbg_stat_err);
+#endif
+            break;
+
         case CLO_ARENA:
             if (!rc_only)
             {
@@ -5127,6 +5163,10 @@ bool parse_args(int argc, char **argv, bool rc_only)
             tiles.m_await_connection = true;
             break;
 
+        case CLO_WEBTILES_PACKED_MAP:
+            tiles.m_packed_map = true;
+            break;
+
         case CLO_PRINT_WEBTILES_OPTIONS:
             if (!rc_only)
             {
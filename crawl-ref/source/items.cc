@@ -14,6 +14,7 @@
 #include <cstring>
 #include <functional> // mem_fn
 #include <limits>
+#include <unordered_map>
 
 #include "adjust.h"
 #include "areas.h"
@@ -2866,6 +2867,39 @@ static int _autopickup_subtype(const item_def &item)
     }
 }
 
+// The index of the first force_autopickup pattern matching the item name, or
+// -1 if none do. The patterns only see the name, so remember the answer for
+// each name until the options change; big piles of the same items share
+// their names.
+static int _force_autopickup_match(const string &iname)
+{
+    static pattern_list_matcher matcher;
+    static unordered_map<string, int> verdicts;
+    static unsigned int generation = 0;
+
+    if (generation != Options.generation)
+    {
+        matcher.clear();
+        for (const pair<text_pattern, bool>& option : Options.force_autopickup)
+            matcher.add(option.first);
+        verdicts.clear();
+        generation = Options.generation;
+    }
+
+    auto cached = verdicts.find(iname);
+    if (cached != verdicts.end())
+        return cached->second;
+
+    // Item names include quantities and inscriptions, so don't let the
+    // cache grow without bound.
+    if (verdicts.size() >= 4096)
+        verdicts.clear();
+
+    const int match = matcher.first_match(iname);
+    verdicts[iname] = match;
+    return match;
+}
+
 static bool _is_option_autopickup(const item_def &item, bool ignore_force)
 {
     if (item.base_type < NUM_OBJECT_CLASSES)
@@ -2900,9 +2934,9 @@ static bool _is_option_autopickup(const item_def &item, bool ignore_force)
 #endif
 
     // Check for initial settings
-    for (const pair<text_pattern, bool>& option : Options.force_autopickup)
-        if (option.first.matches(iname))
-            return option.second;
+    const int option = _force_autopickup_match(iname);
+    if (option != -1)
+        return Options.force_autopickup[option].second;
 
     return Options.autopickups[item.base_type];
 }
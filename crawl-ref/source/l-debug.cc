@@ -5,7 +5,9 @@
 
 #include "l-libs.h"
 
+#include "abyss.h"
 #include "act-iter.h"
+#include "beam.h"
 #include "branch.h"
 #include "chardump.h"
 #include "cluautil.h"
@@ -20,13 +22,19 @@
 #include "mon-act.h"
 #include "mon-cast.h"
 #include "mon-death.h"
+#include "mon-pathfind.h"
+#include "mon-pick.h"
 #include "mon-poly.h"
 #include "ng-setup.h"
+#include "package.h"
 #include "religion.h"
 #include "stairs.h"
 #include "state.h"
 #include "stringutil.h"
+#include "terrain.h"
+#include "tiles-build-specific.h"
 #include "tileview.h"
+#include "travel.h"
 #include "unwind.h"
 #include "view.h"
 #include "wiz-dgn.h"
@@ -87,8 +95,81 @@ LUAFN(debug_enter_dungeon)
     return 0;
 }
 
-LUAWRAP(debug_down_stairs, down_stairs(DNGN_STONE_STAIRS_DOWN_I))
-LUAWRAP(debug_up_stairs, up_stairs(DNGN_STONE_STAIRS_UP_I))
+// Usage: down_stairs(<feature>), up_stairs(<feature>)
+// Takes stone stairs, or the named stair or portal feature if given.
+static dungeon_feature_type _stairs_arg(lua_State *ls,
+                                        dungeon_feature_type deflt)
+{
+    if (!lua_isstring(ls, 1))
+        return deflt;
+
+    const dungeon_feature_type feat =
+        dungeon_feature_by_name(lua_tostring(ls, 1));
+    if (feat == DNGN_UNSEEN)
+        luaL_argerror(ls, 1, "unknown feature");
+    return feat;
+}
+
+LUAWRAP(debug_down_stairs,
+        down_stairs(_stairs_arg(ls, DNGN_STONE_STAIRS_DOWN_I)))
+LUAWRAP(debug_up_stairs, up_stairs(_stairs_arg(ls, DNGN_STONE_STAIRS_UP_I)))
+LUAWRAP(debug_map_level, fully_map_level())
+
+// Usage: update_travel_cache()
+// Records the current level in the travel cache the way arriving on it
+// would, linking its stone stairs to those of neighbouring levels already
+// recorded.
+LUAFN(debug_update_travel_cache)
+{
+    UNUSED(ls);
+    travel_cache.update();
+    for (rectangle_iterator ri(1); ri; ++ri)
+        travel_cache.know_stair(*ri);
+    return 0;
+}
+
+// Usage: link_stairs("placename", x, y, "otherplace", x2, y2)
+// Tells the travel cache that the stairs at x,y on one level lead to x2,y2
+// on the other, and back.
+LUAFN(debug_link_stairs)
+{
+    try
+    {
+        const level_pos from(level_id::parse_level_id(luaL_checkstring(ls, 1)),
+                             coord_def(luaL_safe_checkint(ls, 2),
+                                       luaL_safe_checkint(ls, 3)));
+        const level_pos to(level_id::parse_level_id(luaL_checkstring(ls, 4)),
+                           coord_def(luaL_safe_checkint(ls, 5),
+                                     luaL_safe_checkint(ls, 6)));
+        travel_cache.get_level_info(from.id).update_stair(from.pos, to);
+        travel_cache.get_level_info(to.id).update_stair(to.pos, from);
+    }
+    catch (const bad_level_id &err)
+    {
+        luaL_error(ls, err.what());
+    }
+    return 0;
+}
+
+// Usage: travel_distance("placename")
+// Returns the length of the interlevel travel route to the given level, or
+// nil if travel doesn't know one.
+LUAFN(debug_travel_distance)
+{
+    try
+    {
+        const level_id id = level_id::parse_level_id(luaL_checkstring(ls, 1));
+        const int dist = interlevel_travel_distance(id);
+        if (dist == -1)
+            return 0;
+        PLUARET(number, dist);
+    }
+    catch (const bad_level_id &err)
+    {
+        luaL_error(ls, err.what());
+    }
+    return 0;
+}
 
 LUAFN(debug_flush_map_memory)
 {
@@ -149,11 +230,12 @@ LUAFN(debug_vault_names)
 
 LUAFN(_debug_test_explore)
 {
-    UNUSED(ls);
 #ifdef WIZARD
-    debug_test_explore();
-#endif
+    PLUARET(number, debug_test_explore());
+#else
+    UNUSED(ls);
     return 0;
+#endif
 }
 
 LUAFN(debug_bouncy_beam)
@@ -533,6 +615,241 @@ LUAFN(debug_check_moncasts)
     return 1;
 }
 
+// Usage: monster_path(mx, my, tx, ty[, range])
+// Find a path for the monster at (mx, my) to (tx, ty), as monsters do when
+// tracking a target. Returns the number of steps, or nil if there is none.
+LUAFN(debug_monster_path)
+{
+    COORDS(mpos, 1, 2);
+    COORDS(dest, 3, 4);
+    monster *mon = monster_at(mpos);
+    if (!mon)
+        return 0;
+
+    monster_pathfind mp;
+    if (!lua_isnoneornil(ls, 5))
+        mp.set_range(luaL_safe_checkint(ls, 5));
+    if (!mp.init_pathfind(mon, dest))
+        return 0;
+    PLUARET(number, mp.backtrack().size() - 1);
+}
+
+// Usage: reload_level([count])
+// Save the current level and load it back, count times. Uses a temporary
+// save if there is none (e.g. in test mode).
+LUAFN(debug_reload_level)
+{
+    const int count = lua_isnoneornil(ls, 1) ? 1 : luaL_safe_checkint(ls, 1);
+    const bool temp_save = !you.save;
+    if (temp_save)
+        you.save = new package();
+
+    for (int i = 0; i < count; ++i)
+        reload_current_level();
+
+    if (temp_save)
+    {
+        you.save->unlink();
+        delete you.save;
+        you.save = nullptr;
+    }
+    return 0;
+}
+
+// Usage: handle_monsters([turns])
+// Let monsters act for the given number of player turns (default 1), as
+// after player actions of normal speed.
+LUAFN(debug_handle_monsters)
+{
+    const int turns = lua_isnoneornil(ls, 1) ? 1 : luaL_safe_checkint(ls, 1);
+    unwind_var<int> time_taken(you.time_taken, BASELINE_DELAY);
+    for (int i = 0; i < turns; ++i)
+        handle_monsters(true);
+    return 0;
+}
+
+static CLua &_debug_lua_vm(lua_State *ls, int ndx)
+{
+    const string vm = luaL_optstring(ls, ndx, "dlua");
+    if (vm == "clua")
+        return clua;
+    if (vm != "dlua")
+        luaL_argerror(ls, ndx, "expected \"clua\" or \"dlua\"");
+    return dlua;
+}
+
+static void _debug_set_stat(lua_State *ls, const char *name, double value)
+{
+    lua_pushstring(ls, name);
+    lua_pushnumber(ls, value);
+    lua_rawset(ls, -3);
+}
+
+// Usage: lua_stats([vm])
+// Returns a table of allocation and collection counts for the "clua" (user
+// script) or "dlua" (default) interpreter.
+LUAFN(debug_lua_stats)
+{
+    const CLua &vm(_debug_lua_vm(ls, 1));
+    lua_newtable(ls);
+    _debug_set_stat(ls, "memory", vm.memory_used);
+    _debug_set_stat(ls, "peak_memory", vm.stats.peak_memory);
+    _debug_set_stat(ls, "allocs", vm.stats.allocs);
+    _debug_set_stat(ls, "reallocs", vm.stats.reallocs);
+    _debug_set_stat(ls, "frees", vm.stats.frees);
+    _debug_set_stat(ls, "pooled", vm.stats.pooled);
+    _debug_set_stat(ls, "bytes_allocated", vm.stats.bytes_allocated);
+    _debug_set_stat(ls, "gc_cycles", vm.stats.gc_cycles);
+    return 1;
+}
+
+// Usage: lua_gc_params(pause, stepmul[, vm])
+// Overrides the lua_gc_pause and lua_gc_stepmul options for one interpreter;
+// 0 restores Lua's default.
+LUAFN(debug_lua_gc_params)
+{
+    const int pause = luaL_safe_checkint(ls, 1);
+    const int stepmul = luaL_safe_checkint(ls, 2);
+    CLua &vm(_debug_lua_vm(ls, 3));
+    vm.set_gc_params(pause > 0 ? pause : 200, stepmul > 0 ? stepmul : 200);
+    return 0;
+}
+
+// Usage: store_key_stats()
+// Returns the number of property keys looked up through the interned key
+// cache, how many of those missed it, and the number of string
+// allocations the hits avoided.
+LUAFN(debug_store_key_stats)
+{
+    const store_key_stats &stats = get_store_key_stats();
+    lua_pushnumber(ls, stats.lookups);
+    lua_pushnumber(ls, stats.misses);
+    lua_pushnumber(ls, stats.allocs_saved);
+    return 3;
+}
+
+// Usage: tracer_memo_stats()
+// Returns the number of monster tracers answered from the tracer memo, the
+// number fired and remembered, and the number that couldn't be remembered.
+LUAFN(debug_tracer_memo_stats)
+{
+    const tracer_memo_stats stats = get_tracer_memo_stats();
+    lua_pushnumber(ls, stats.hits);
+    lua_pushnumber(ls, stats.misses);
+    lua_pushnumber(ls, stats.uncacheable);
+    return 3;
+}
+
+#ifdef DEBUG
+// Usage: monster_queue_stats()
+// Returns what the last monster turn did: the number of monsters queued
+// to act, moves made, stale queue entries, and entries pushed.
+LUAFN(debug_monster_queue_stats)
+{
+    const monster_queue_stats &stats = last_monster_queue_stats();
+    lua_pushnumber(ls, stats.queued);
+    lua_pushnumber(ls, stats.actions);
+    lua_pushnumber(ls, stats.stale);
+    lua_pushnumber(ls, stats.pushes);
+    return 4;
+}
+#endif
+
+#if defined(DEBUG_DIAGNOSTICS) || defined(DEBUG_TESTS)
+// Usage: store_key_bench(rounds)
+// Looks up each of the player's property keys rounds times, by temporary
+// string as before and through the interned key cache. Returns the number
+// of lookups and the milliseconds each way took.
+LUAFN(debug_store_key_bench)
+{
+    const store_key_bench_result result
+        = store_key_bench(you.props, luaL_safe_checkint(ls, 1));
+    lua_pushnumber(ls, result.lookups);
+    lua_pushnumber(ls, result.string_ms);
+    lua_pushnumber(ls, result.interned_ms);
+    return 3;
+}
+
+// Usage: monpick_bench(rounds)
+// Picks monsters rounds times at every depth of every branch population,
+// with and without a veto, through the pick tables and through the
+// reference pick. Returns the number of picks and the milliseconds each
+// took.
+LUAFN(debug_monpick_bench)
+{
+    const monpick_bench_result result =
+        debug_monpick_bench(luaL_safe_checkint(ls, 1));
+    lua_pushnumber(ls, result.picks);
+    lua_pushnumber(ls, result.table_ms);
+    lua_pushnumber(ls, result.reference_ms);
+    return 3;
+}
+
+// Usage: abyss_sample_bench(rounds)
+// Samples the Abyss layouts over a map-sized area around rounds random
+// places, cell by cell and in batches. Returns the number of cells, how many
+// of them the two disagreed on, and the milliseconds each took.
+LUAFN(debug_abyss_sample_bench)
+{
+    const abyss_sample_bench_result result =
+        debug_abyss_sample_bench(luaL_safe_checkint(ls, 1));
+    lua_pushnumber(ls, result.cells);
+    lua_pushnumber(ls, result.mismatches);
+    lua_pushnumber(ls, result.cell_ms);
+    lua_pushnumber(ls, result.batch_ms);
+    return 4;
+}
+
+// Usage: tracer_memo_check(rounds)
+// Fires every beam spell tracer of every monster on the level twice, with
+// and without the tracer memo, under rounds different seeds. Returns the
+// number of tracers, how many gave different results through the memo, and
+// the milliseconds each way took.
+LUAFN(debug_tracer_memo_check)
+{
+    const tracer_memo_check_result result =
+        debug_tracer_memo_check(luaL_safe_checkint(ls, 1));
+    lua_pushnumber(ls, result.tracers);
+    lua_pushnumber(ls, result.mismatches);
+    lua_pushnumber(ls, result.fresh_ms);
+    lua_pushnumber(ls, result.memo_ms);
+    return 4;
+}
+#endif
+
+#ifdef USE_TILE_WEB
+// Usage: webtiles_send_everything(packed)
+// Send the whole game state to webtiles clients, as for a new spectator,
+// with or without packed map cells. Returns the number of bytes sent.
+LUAFN(debug_webtiles_send_everything)
+{
+    PLUARET(number, tiles.measure_send_everything(lua_toboolean(ls, 1)));
+}
+
+// Usage: webtiles_send_map(full)
+// Send the map to webtiles clients as the next redraw would, or in full.
+// Returns the number of bytes sent.
+LUAFN(debug_webtiles_send_map)
+{
+    PLUARET(number, tiles.measure_send_map(lua_toboolean(ls, 1)));
+}
+
+// Usage: webtiles_map_stats()
+// Returns the number of map messages built, how many of them were full,
+// the number of cells sent and copied to the client's view, and the
+// milliseconds spent building them.
+LUAFN(debug_webtiles_map_stats)
+{
+    const map_send_stats &stats = tiles.get_map_send_stats();
+    lua_pushnumber(ls, stats.sends);
+    lua_pushnumber(ls, stats.full_sends);
+    lua_pushnumber(ls, stats.cells);
+    lua_pushnumber(ls, stats.copied);
+    lua_pushnumber(ls, stats.ms);
+    return 5;
+}
+#endif
+
 const struct luaL_reg debug_dlib[] =
 {
 { "goto_place", debug_goto_place },
@@ -540,6 +857,10 @@ const struct luaL_reg debug_dlib[] =
 { "enter_dungeon", debug_enter_dungeon },
 { "down_stairs", debug_down_stairs },
 { "up_stairs", debug_up_stairs },
+{ "map_level", debug_map_level },
+{ "update_travel_cache", debug_update_travel_cache },
+{ "link_stairs", debug_link_stairs },
+{ "travel_distance", debug_travel_distance },
 { "flush_map_memory", debug_flush_map_memory },
 { "builder_ignore_depth", debug_builder_ignore_depth },
 { "generate_level", debug_generate_level },
@@ -565,5 +886,26 @@ const struct luaL_reg debug_dlib[] =
 { "reset_rng", debug_reset_rng },
 { "get_rng_state", debug_get_rng_state },
 { "check_moncasts", debug_check_moncasts },
+{ "monster_path", debug_monster_path },
+{ "reload_level", debug_reload_level },
+{ "handle_monsters", debug_handle_monsters },
+{ "store_key_stats", debug_store_key_stats },
+{ "tracer_memo_stats", debug_tracer_memo_stats },
+{ "lua_stats", debug_lua_stats },
+{ "lua_gc_params", debug_lua_gc_params },
+#ifdef DEBUG
+{ "monster_queue_stats", debug_monster_queue_stats },
+#endif
+#if defined(DEBUG_DIAGNOSTICS) || defined(DEBUG_TESTS)
+{ "store_key_bench", debug_store_key_bench },
+{ "monpick_bench", debug_monpick_bench },
+{ "abyss_sample_bench", debug_abyss_sample_bench },
+{ "tracer_memo_check", debug_tracer_memo_check },
+#endif
+#ifdef USE_TILE_WEB
+{ "webtiles_send_everything", debug_webtiles_send_everything },
+{ "webtiles_send_map", debug_webtiles_send_map },
+{ "webtiles_map_stats", debug_webtiles_map_stats },
+#endif
 { nullptr, nullptr }
 };
@@ -88,6 +88,8 @@ static int dgn_depth_proc(lua_State *ls, depth_ranges &dr, int s)
 static int dgn_depth(lua_State *ls)
 {
     MAP(ls, 1, map);
+    if (lua_gettop(ls) > 1)
+        map_def_changed(*map);
     return dgn_depth_proc(ls, map->depths, 2);
 }
 
@@ -109,6 +111,7 @@ static int dgn_place(lua_State *ls)
                 luaL_error(ls, err.what());
             }
         }
+        map_def_changed(*map);
     }
     PLUARET(string, map->place.describe().c_str());
 }
@@ -145,6 +148,7 @@ static int dgn_tags(lua_State *ls)
             const char *s = luaL_checkstring(ls, 2);
             map->add_tags(s);
         }
+        map_def_changed(*map);
     }
     PLUARET(string, map->tags_string().c_str());
 }
@@ -165,6 +169,8 @@ static int dgn_tags_remove(lua_State *ls)
         const string axee = luaL_checkstring(ls, i);
         map->remove_tags(axee);
     }
+    if (top > 1)
+        map_def_changed(*map);
     PLUARET(string, map->tags_string().c_str());
 }
 
@@ -565,6 +571,15 @@ static int dgn_name(lua_State *ls)
     PLUARET(string, map->name.c_str());
 }
 
+// Each call pushes a new userdata for the map, so these never compare equal;
+// the map_def pointer identifies the C++ object behind them.
+static int dgn_map_id(lua_State *ls)
+{
+    MAP(ls, 1, map);
+    lua_pushlightuserdata(ls, map);
+    return 1;
+}
+
 typedef
     flood_find<map_def::map_feature_finder, map_def::map_bounds_check>
     map_flood_finder;
@@ -1773,6 +1788,7 @@ const struct luaL_reg dgn_dlib[] =
 { "reset_level", _dgn_reset_level },
 
 { "name", dgn_name },
+{ "map_id", dgn_map_id },
 { "depth", dgn_depth },
 { "place", dgn_place },
 { "desc", dgn_desc },
@@ -7,8 +7,10 @@
 
 #include "cluautil.h"
 #include "coord.h"
+#include "coordit.h"
 #include "losglobal.h"
 #include "los.h"
+#include "los-def.h"
 #include "ray.h"
 #include "stringutil.h"
 
@@ -57,11 +59,94 @@ LUAFN(los_cell_see_cell)
     PLUARET(number, cell_see_cell(p, q, LOS_DEFAULT));
 }
 
+static int _los_grid_visible(const los_grid &sh)
+{
+    int visible = 0;
+    for (int x = -LOS_MAX_RANGE; x <= LOS_MAX_RANGE; ++x)
+        for (int y = -LOS_MAX_RANGE; y <= LOS_MAX_RANGE; ++y)
+            if (sh(coord_def(x, y)))
+                visible++;
+    return visible;
+}
+
+/*** Compute LOS from a cell, bypassing the cell_see_cell cache.
+ * In debug builds, reference=true uses the ray set code from before
+ * losight() was vectorised, as a baseline.
+ * @tparam int x
+ * @tparam int y
+ * @tparam[opt=false] boolean reference
+ * @treturn int the number of visible cells
+ * @function losight
+ */
+LUAFN(los_losight)
+{
+    GETCOORD(c, 1, 2, map_bounds);
+    los_grid sh;
+#if defined(DEBUG_DIAGNOSTICS) || defined(DEBUG_TESTS)
+    if (lua_toboolean(ls, 3))
+        losight_reference(sh, c);
+    else
+#endif
+        losight(sh, c);
+    PLUARET(number, _los_grid_visible(sh));
+}
+
+#if defined(DEBUG_DIAGNOSTICS) || defined(DEBUG_TESTS)
+/*** Compare losight() from a cell against the ray set code it replaced.
+ * Debug builds only.
+ * @tparam int x
+ * @tparam int y
+ * @treturn int the number of cells on which the two disagree
+ * @treturn int the number of cells the reference sees
+ * @function losight_diff
+ */
+LUAFN(los_losight_diff)
+{
+    GETCOORD(c, 1, 2, map_bounds);
+    los_grid sh, ref;
+    losight(sh, c);
+    losight_reference(ref, c);
+    int diff = 0;
+    for (int x = -LOS_MAX_RANGE; x <= LOS_MAX_RANGE; ++x)
+        for (int y = -LOS_MAX_RANGE; y <= LOS_MAX_RANGE; ++y)
+            if (sh(coord_def(x, y)) != ref(coord_def(x, y)))
+                diff++;
+    lua_pushnumber(ls, diff);
+    lua_pushnumber(ls, _los_grid_visible(ref));
+    return 2;
+}
+#endif
+
+/*** Statistics of the cell_see_cell cache.
+ * @treturn int lookups answered from the cache
+ * @treturn int lookups that had to recompute LOS
+ * @treturn int cache entries invalidated by opacity changes
+ * @treturn int whole-cache flushes
+ * @function cache_stats
+ */
+LUAFN(los_get_cache_stats)
+{
+    const los_cache_stats &stats = get_los_cache_stats();
+    lua_pushnumber(ls, stats.hits);
+    lua_pushnumber(ls, stats.misses);
+    lua_pushnumber(ls, stats.invalidated);
+    lua_pushnumber(ls, stats.flushes);
+    return 4;
+}
+
+LUAWRAP(los_reset_cache_stats, reset_los_cache_stats())
+
 const struct luaL_reg los_dlib[] =
 {
     { "findray", los_find_ray },
     { "make_ray", los_make_ray },
     { "cell_see_cell", los_cell_see_cell },
+    { "losight", los_losight },
+#if defined(DEBUG_DIAGNOSTICS) || defined(DEBUG_TESTS)
+    { "losight_diff", los_losight_diff },
+#endif
+    { "cache_stats", los_get_cache_stats },
+    { "reset_cache_stats", los_reset_cache_stats },
     { nullptr, nullptr }
 };
 
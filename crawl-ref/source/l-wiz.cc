@@ -22,26 +22,81 @@ module "crawl"
 // Non-user-accessible bindings (dlua).
 //
 
-LUAFN(wiz_quick_fsim)
+static bool _set_fsim_args(lua_State *ls)
 {
-    // quick and dirty, get av effective damage. Will crash if
-    // monster can't be placed.
     string mon_name = luaL_checkstring(ls, 1);
     monster_type mtype = get_monster_by_name(mon_name, true);
     if (mtype == MONS_PROGRAM_BUG)
     {
         string err = make_stringf("No such monster: '%s'.", mon_name.c_str());
-        return luaL_argerror(ls, 1, err.c_str());
+        luaL_argerror(ls, 1, err.c_str());
+        return false;
     }
     const int fsim_rounds = luaL_safe_checkint(ls, 2);
+    if (fsim_rounds < 1)
+    {
+        luaL_argerror(ls, 2, "must be at least 1");
+        return false;
+    }
 
     Options.fsim_mons = mon_name;
     Options.fsim_rounds = fsim_rounds;
+    return true;
+}
+
+LUAFN(wiz_quick_fsim)
+{
+    // quick and dirty, get av effective damage. Will crash if
+    // monster can't be placed.
+    if (!_set_fsim_args(ls))
+        return 0;
 
     fight_data fdata = wizard_quick_fsim_raw(false);
     PLUARET(number, fdata.player.av_eff_dam);
 }
 
+static void _push_fsim_stats(lua_State *ls, const fight_damage_stats &stats)
+{
+    lua_newtable(ls);
+    const pair<const char *, double> fields[] =
+    {
+        { "hits",       stats.hits },
+        { "av_hit_dam", stats.av_hit_dam },
+        { "max_dam",    stats.max_dam },
+        { "accuracy",   stats.accuracy },
+        { "av_dam",     stats.av_dam },
+        { "av_time",    stats.av_time },
+        { "av_speed",   stats.av_speed },
+        { "av_eff_dam", stats.av_eff_dam },
+    };
+    for (const auto &field : fields)
+    {
+        lua_pushstring(ls, field.first);
+        lua_pushnumber(ls, field.second);
+        lua_rawset(ls, -3);
+    }
+}
+
+// Usage: fsim("monster", rounds, <defend>)
+// Returns a table with "player" and "monster" tables of fight statistics,
+// as shown by the quick fight simulation. Will crash if the monster can't be
+// placed.
+LUAFN(wiz_fsim)
+{
+    if (!_set_fsim_args(ls))
+        return 0;
+
+    fight_data fdata = wizard_quick_fsim_raw(lua_toboolean(ls, 3));
+    lua_newtable(ls);
+    lua_pushstring(ls, "player");
+    _push_fsim_stats(ls, fdata.player);
+    lua_rawset(ls, -3);
+    lua_pushstring(ls, "monster");
+    _push_fsim_stats(ls, fdata.monster);
+    lua_rawset(ls, -3);
+    return 1;
+}
+
 LUAWRAP(wiz_identify_all_items, wizard_identify_all_items())
 
 LUAWRAP(wiz_map_level, wizard_map_level())
@@ -49,6 +104,7 @@ LUAWRAP(wiz_map_level, wizard_map_level())
 static const struct luaL_reg wiz_dlib[] =
 {
 { "quick_fsim", wiz_quick_fsim },
+{ "fsim", wiz_fsim },
 { "identify_all_items", wiz_identify_all_items},
 { "map_level", wiz_map_level},
 { nullptr, nullptr }
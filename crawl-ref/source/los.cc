@@ -70,15 +70,29 @@ struct los_ray;
 static vector<los_ray> fullrays;
 static vector<coord_def> ray_coords;
 
+// Upper bound on the number of minimal cellrays (there are 428 at
+// LOS_RADIUS 8), so that the ray sets used by losight() can be
+// fixed-size and never allocate.
+#define LOS_MAX_CELLRAYS 512
+typedef WideBitVector<LOS_MAX_CELLRAYS> ray_set;
+
 // These store all unique minimal cellrays. For each i,
 // cellray i ends in cellray_ends[i] and passes through
 // thoses cells p that have blockrays(p)[i] set. In other
 // words, blockrays(p)[i] is set iff an opaque cell p blocks
 // the cellray with index i.
 static vector<coord_def> cellray_ends;
-typedef FixedArray<bit_vector*, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> blockrays_t;
+typedef FixedArray<ray_set, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> blockrays_t;
 static blockrays_t blockrays;
 
+// For each cell p, the (distinct) end cells of the minimal cellrays
+// that p blocks. Only the visibility of these cells can change when
+// the opacity of p changes; used by the global LOS cache to invalidate
+// selectively.
+typedef FixedArray<vector<coord_def>, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1>
+        shadowed_cells_t;
+static shadowed_cells_t shadowed_cells;
+
 // We also store the minimal cellrays by target position
 // for efficient retrieval by find_ray.
 // XXX: Consider condensing this representation.
@@ -87,9 +101,8 @@ static FixedArray<vector<cellray>, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> min_cellray
 
 // Temporary arrays used in losight() to track which rays
 // are blocked or have seen a smoke cloud.
-// Allocated when doing the precomputations.
-static bit_vector *dead_rays     = nullptr;
-static bit_vector *smoke_rays    = nullptr;
+static ray_set dead_rays;
+static ray_set smoke_rays;
 
 class quadrant_iterator : public rectangle_iterator
 {
@@ -101,14 +114,6 @@ public:
     }
 };
 
-void clear_rays_on_exit()
-{
-    delete dead_rays;
-    delete smoke_rays;
-    for (quadrant_iterator qi; qi; ++qi)
-        delete blockrays(*qi);
-}
-
 // LOS radius.
 int los_radius = LOS_DEFAULT_RANGE;
 
@@ -389,7 +394,7 @@ static void _create_blockrays()
     // Cellrays are numbered according to the index of their end
     // cell in ray_coords.
     const int n_cellrays = ray_coords.size();
-    blockrays_t all_blockrays;
+    FixedArray<bit_vector*, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> all_blockrays;
     for (quadrant_iterator qi; qi; ++qi)
         all_blockrays(*qi) = new bit_vector(n_cellrays);
 
@@ -410,27 +415,32 @@ static void _create_blockrays()
     // Determine minimal cellrays and store their indices in ray_coords.
     vector<int> min_indices = _find_minimal_cellrays();
     const int n_min_rays    = min_indices.size();
+    ASSERT(n_min_rays <= LOS_MAX_CELLRAYS);
     cellray_ends.resize(n_min_rays);
     for (int i = 0; i < n_min_rays; ++i)
         cellray_ends[i] = ray_coords[min_indices[i]];
 
     // Compress blockrays accordingly.
     for (quadrant_iterator qi; qi; ++qi)
-    {
-        blockrays(*qi) = new bit_vector(n_min_rays);
         for (int i = 0; i < n_min_rays; ++i)
-        {
-            blockrays(*qi)->set(i, all_blockrays(*qi)
-                                   ->get(min_indices[i]));
-        }
-    }
+            blockrays(*qi).set(i, all_blockrays(*qi)->get(min_indices[i]));
 
     // We can throw away all_blockrays now.
     for (quadrant_iterator qi; qi; ++qi)
         delete all_blockrays(*qi);
 
-    dead_rays  = new bit_vector(n_min_rays);
-    smoke_rays = new bit_vector(n_min_rays);
+    // Collect the cells whose visibility depends on each cell.
+    for (quadrant_iterator qi; qi; ++qi)
+    {
+        FixedBitArray<LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> seen;
+        for (int i = 0; i < n_min_rays; ++i)
+        {
+            if (!blockrays(*qi).get(i) || seen(cellray_ends[i]))
+                continue;
+            seen.set(cellray_ends[i]);
+            shadowed_cells(*qi).push_back(cellray_ends[i]);
+        }
+    }
 
     dprf("Cellrays: %d Fullrays: %u Minimal cellrays: %u",
           n_cellrays, (unsigned int)fullrays.size(), n_min_rays);
@@ -535,6 +545,18 @@ static int _imbalance(ray_def ray, const coord_def& target)
     return imb;
 }
 
+const vector<coord_def>& los_shadowed_cells(const coord_def& p)
+{
+    ASSERT(p.x >= 0);
+    ASSERT(p.y >= 0);
+    ASSERT(p.rdist() <= LOS_MAX_RANGE);
+
+    // Ensure the precalculations have been done.
+    raycast();
+
+    return shadowed_cells(p);
+}
+
 void cellray::calc_params()
 {
     coord_def trg = target();
@@ -796,8 +818,8 @@ static void _losight_quadrant(los_grid& sh, const los_param& dat, int sx, int sy
 {
     const unsigned int num_cellrays = cellray_ends.size();
 
-    dead_rays->reset();
-    smoke_rays->reset();
+    dead_rays.reset();
+    smoke_rays.reset();
 
     for (quadrant_iterator qi; qi; ++qi)
     {
@@ -809,12 +831,12 @@ static void _losight_quadrant(los_grid& sh, const los_param& dat, int sx, int sy
         {
         case OPC_OPAQUE:
             // Block the appropriate rays.
-            *dead_rays |= *blockrays(*qi);
+            dead_rays |= blockrays(*qi);
             break;
         case OPC_HALF:
             // Block rays which have already seen a cloud.
-            *dead_rays  |= (*smoke_rays & *blockrays(*qi));
-            *smoke_rays |= *blockrays(*qi);
+            dead_rays.or_and(smoke_rays, blockrays(*qi));
+            smoke_rays |= blockrays(*qi);
             break;
         default:
             break;
@@ -822,12 +844,17 @@ static void _losight_quadrant(los_grid& sh, const los_param& dat, int sx, int sy
     }
 
     // Ray calculation done. Now work out which cells in this
-    // quadrant are visible.
-    for (unsigned int rayidx = 0; rayidx < num_cellrays; ++rayidx)
+    // quadrant are visible. Skip whole words of dead rays.
+    for (unsigned int w = 0; w * 64 < num_cellrays; ++w)
     {
-        // make the cells seen by this ray at this point visible
-        if (!dead_rays->get(rayidx))
+        uint64_t alive = ~dead_rays.word(w);
+        for (unsigned int rayidx = w * 64; alive && rayidx < num_cellrays;
+             ++rayidx, alive >>= 1)
         {
+            // make the cells seen by this ray at this point visible
+            if (!(alive & 1))
+                continue;
+
             // This ray is alive, thus the end cell is visible.
             const coord_def p = coord_def(sx * cellray_ends[rayidx].x,
                                           sy * cellray_ends[rayidx].y);
@@ -880,6 +907,85 @@ void losight(los_grid& sh, const coord_def& center,
     sh(o) = true;
 }
 
+#if defined(DEBUG_DIAGNOSTICS) || defined(DEBUG_TESTS)
+// The ray set kernel from before the sets were WideBitVectors: heap
+// bit_vectors combined a word at a time, with a temporary for every smoke
+// cell. Its blockrays are copied from the current ones on first use.
+static vector<unique_ptr<bit_vector>> reference_blockrays;
+
+static void _losight_quadrant_reference(los_grid& sh, const los_param& dat,
+                                        int sx, int sy)
+{
+    const unsigned int num_cellrays = cellray_ends.size();
+    static bit_vector dead(num_cellrays), smoke(num_cellrays);
+
+    dead.reset();
+    smoke.reset();
+
+    for (quadrant_iterator qi; qi; ++qi)
+    {
+        coord_def p = coord_def(sx*(qi->x), sy*(qi->y));
+        if (!dat.los_bounds(p))
+            continue;
+
+        const bit_vector &rays
+            = *reference_blockrays[qi->x * (LOS_MAX_RANGE + 1) + qi->y];
+        switch (dat.opacity(p))
+        {
+        case OPC_OPAQUE:
+            dead |= rays;
+            break;
+        case OPC_HALF:
+            dead |= (smoke & rays);
+            smoke |= rays;
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (unsigned int rayidx = 0; rayidx < num_cellrays; ++rayidx)
+    {
+        if (!dead.get(rayidx))
+        {
+            const coord_def p = coord_def(sx * cellray_ends[rayidx].x,
+                                          sy * cellray_ends[rayidx].y);
+            if (dat.los_bounds(p))
+                sh(p) = true;
+        }
+    }
+}
+
+void losight_reference(los_grid& sh, const coord_def& center,
+                       const opacity_func& opc, const circle_def& bounds)
+{
+    const los_param& dat = los_param_funcs(center, opc, bounds);
+
+    sh.init(false);
+    raycast();
+
+    if (reference_blockrays.empty())
+    {
+        reference_blockrays.resize((LOS_MAX_RANGE + 1) * (LOS_MAX_RANGE + 1));
+        for (quadrant_iterator qi; qi; ++qi)
+        {
+            auto rays = make_unique<bit_vector>(cellray_ends.size());
+            for (unsigned int i = 0; i < cellray_ends.size(); ++i)
+                rays->set(i, blockrays(*qi).get(i));
+            reference_blockrays[qi->x * (LOS_MAX_RANGE + 1) + qi->y]
+                = move(rays);
+        }
+    }
+
+    const int quadrant_x[4] = {  1, -1, -1,  1 };
+    const int quadrant_y[4] = {  1,  1, -1, -1 };
+    for (int q = 0; q < 4; ++q)
+        _losight_quadrant_reference(sh, dat, quadrant_x[q], quadrant_y[q]);
+
+    sh(coord_def(0, 0)) = true;
+}
+#endif
+
 opacity_type mons_opacity(const monster* mon, los_type how)
 {
     // no regard for LOS_ARENA
@@ -41,10 +41,17 @@ bool cell_see_cell_nocache(const coord_def& p1, const coord_def& p2);
 
 typedef SquareArray<bool, LOS_MAX_RANGE> los_grid;
 
-void clear_rays_on_exit();
+// Offsets in the positive quadrant whose visibility from the origin
+// depends on the opacity of the cell at offset p.
+const vector<coord_def>& los_shadowed_cells(const coord_def& p);
 void losight(los_grid& sh, const coord_def& center,
              const opacity_func &opc = opc_default,
              const circle_def &bds = BDS_DEFAULT);
+// losight() through the ray set code it used before WideBitVector, as a
+// baseline for benchmarks. Only in debug builds.
+void losight_reference(los_grid& sh, const coord_def& center,
+                       const opacity_func &opc = opc_default,
+                       const circle_def &bds = BDS_DEFAULT);
 
 void los_actor_moved(const actor* act, const coord_def& oldpos);
 void los_monster_died(const monster* mon);
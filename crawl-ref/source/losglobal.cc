@@ -5,6 +5,7 @@
 #include "coord.h"
 #include "coordit.h"
 #include "libutil.h"
+#include "los.h"
 #include "los-def.h"
 
 #define LOS_KNOWN 4
@@ -17,6 +18,8 @@ typedef halflos_t globallos_t[GXM][GYM];
 
 static globallos_t globallos;
 
+static los_cache_stats cache_stats;
+
 static losfield_t* _lookup_globallos(const coord_def& p, const coord_def& q)
 {
     COMPILE_CHECK(LOS_KNOWN * 2 <= sizeof(losfield_t) * 8);
@@ -58,22 +61,44 @@ static void _save_los(los_def* los, los_type l)
         }
 }
 
-// Opacity at p has changed.
+// Opacity at p has changed. Forget exactly those cached pairs with a
+// minimal cellray through p; nothing else can have changed.
 void invalidate_los_around(const coord_def& p)
 {
-    int x1 = max(p.x - LOS_MAX_RANGE, 0);
-    int y1 = max(p.y - LOS_MAX_RANGE, 0);
-    int x2 = min(p.x, GXM - 1);
-    int y2 = min(p.y + LOS_MAX_RANGE, GYM - 1);
-    for (int y = y1; y <= y2; y++)
-        for (int x = x1; x <= x2; x++)
-            memset(globallos[x][y], 0, sizeof(halflos_t));
+    for (rectangle_iterator ri(p, LOS_MAX_RANGE); ri; ++ri)
+    {
+        const coord_def o = *ri;
+        if (!map_bounds(o))
+            continue;
+
+        const coord_def d = p - o;
+        // A cell on an axis lies in two quadrants, the origin in all four.
+        for (int sx = -1; sx <= 1; sx += 2)
+            for (int sy = -1; sy <= 1; sy += 2)
+            {
+                if (d.x * sx < 0 || d.y * sy < 0)
+                    continue;
+
+                const coord_def ad(d.x * sx, d.y * sy);
+                for (const coord_def &t : los_shadowed_cells(ad))
+                {
+                    const coord_def q(o.x + t.x * sx, o.y + t.y * sy);
+                    losfield_t* flags = _lookup_globallos(o, q);
+                    if (flags && *flags)
+                    {
+                        *flags = 0;
+                        cache_stats.invalidated++;
+                    }
+                }
+            }
+    }
 }
 
 void invalidate_los()
 {
     for (rectangle_iterator ri(0); ri; ++ri)
         memset(globallos[ri->x][ri->y], 0, sizeof(halflos_t));
+    cache_stats.flushes++;
 }
 
 static void _update_globallos_at(const coord_def& p, los_type l)
@@ -124,8 +149,23 @@ bool cell_see_cell(const coord_def& p, const coord_def& q, los_type l)
         return false; // outside range
 
     if (!(*flags & (l << LOS_KNOWN)))
+    {
+        cache_stats.misses++;
         _update_globallos_at(p, l);
+    }
+    else
+        cache_stats.hits++;
 
     ASSERT(*flags & (l << LOS_KNOWN));
     return *flags & l;
 }
+
+const los_cache_stats& get_los_cache_stats()
+{
+    return cache_stats;
+}
+
+void reset_los_cache_stats()
+{
+    cache_stats = los_cache_stats();
+}
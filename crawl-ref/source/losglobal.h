@@ -6,3 +6,15 @@ void invalidate_los_around(const coord_def& p);
 void invalidate_los();
 
 bool cell_see_cell(const coord_def& p, const coord_def& q, los_type l);
+
+// Counters for the cell_see_cell cache, for debugging and profiling.
+struct los_cache_stats
+{
+    unsigned int hits = 0;        // lookups answered from the cache
+    unsigned int misses = 0;      // lookups that recomputed a full LOS
+    unsigned int invalidated = 0; // entries dropped by opacity changes
+    unsigned int flushes = 0;     // whole-cache flushes
+};
+
+const los_cache_stats& get_los_cache_stats();
+void reset_los_cache_stats();
@@ -560,6 +560,11 @@ static void _show_commandline_options_help()
          "iterations");
     puts("  -force-map <map>    For -mapstat and -objstat, alway choose the "
          "      given map on every level.");
+    puts("  -shards <num>       For -mapstat and -objstat, split the iterations "
+         "between");
+    puts("      <num> processes, checkpointing each so that an interrupted "
+         "run resumes");
+    puts("      where it left off.");
 #endif
     puts("");
     puts("Miscellaneous options:");
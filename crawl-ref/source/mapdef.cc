@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
@@ -20,6 +21,7 @@
 #include "cluautil.h"
 #include "colour.h"
 #include "coordit.h"
+#include "dbg-maps.h"
 #include "describe.h"
 #include "dgn-height.h"
 #include "dungeon.h"
@@ -43,6 +45,7 @@
 #include "shopping.h"
 #include "spl-book.h"
 #include "spl-util.h"
+#include "state.h"
 #include "stringutil.h"
 #include "tag-version.h"
 #include "terrain.h"
@@ -2178,6 +2181,16 @@ bool depth_ranges::is_usable_in(const level_id &lid) const
     return any_matched;
 }
 
+// Could is_usable_in() be true for some level of this branch? Ranges given
+// as absolute dungeon depths may match in any branch.
+bool depth_ranges::might_match_branch(branch_type br) const
+{
+    for (const level_range &lr : depths)
+        if (!lr.deny && (lr.branch == br || lr.branch == NUM_BRANCHES))
+            return true;
+    return false;
+}
+
 void depth_ranges::add_depths(const depth_ranges &other_depths)
 {
     depths.insert(depths.end(),
@@ -2573,8 +2586,44 @@ void map_def::set_file(const string &s)
     cache_name = get_cache_name(s);
 }
 
+#ifdef DEBUG_STATISTICS
+// Times a map's Lua for mapstat. Lua run from inside another map's Lua, such
+// as its hooks or the subvaults it places, counts towards the outermost map.
+class map_lua_timer
+{
+public:
+    map_lua_timer(const map_def &_map)
+        : map(_map), start(chrono::steady_clock::now()), outermost(!depth++)
+    {
+    }
+
+    ~map_lua_timer()
+    {
+        --depth;
+        if (outermost && crawl_state.map_stat_gen)
+        {
+            mapstat_report_map_lua_time(map.name,
+                chrono::duration_cast<chrono::microseconds>(
+                    chrono::steady_clock::now() - start).count());
+        }
+    }
+
+private:
+    const map_def &map;
+    chrono::steady_clock::time_point start;
+    bool outermost;
+
+    static int depth;
+};
+
+int map_lua_timer::depth = 0;
+#endif
+
 string map_def::run_lua(bool run_main)
 {
+#ifdef DEBUG_STATISTICS
+    const map_lua_timer timer(*this);
+#endif
     dlua_set_map mset(this);
 
     int err = prelude.load(dlua);
@@ -2632,6 +2681,9 @@ void map_def::copy_hooks_from(const map_def &other_map, const string &hook_name)
 // no errors occurred while running hooks.
 bool map_def::run_hook(const string &hook_name, bool die_on_lua_error)
 {
+#ifdef DEBUG_STATISTICS
+    const map_lua_timer timer(*this);
+#endif
     const dlua_set_map mset(this);
     if (!dlua.callfn("dgn_map_run_hook", "s", hook_name.c_str()))
     {
@@ -2664,6 +2716,9 @@ bool map_def::run_postplace_hook(bool die_on_lua_error)
 bool map_def::test_lua_boolchunk(dlua_chunk &chunk, bool defval,
                                  bool die_on_lua_error)
 {
+#ifdef DEBUG_STATISTICS
+    const map_lua_timer timer(*this);
+#endif
     bool result = defval;
     dlua_set_map mset(this);
 
@@ -8,9 +8,13 @@
 #include "maps.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <unordered_map>
 #include <sys/param.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #if defined(UNIX) || defined(TARGET_COMPILER_MINGW)
 #include <unistd.h>
@@ -68,6 +72,41 @@ point_vector map_anchor_points;
 
 static map_vector vdefs;
 
+typedef vector<unsigned> vault_indices;
+
+enum map_index_flag
+{
+    MIF_MINIVAULT     = 1 << 0,
+    MIF_EXTRA         = 1 << 1,
+    MIF_DUMMY         = 1 << 2,
+    // Tagged so that it can't be picked at random by depth; see
+    // map_selector::depth_selectable().
+    MIF_NO_DEPTH_PICK = 1 << 3,
+};
+
+// Index over vdefs, so that selecting a vault only has to look at the maps
+// that could match rather than at all of them. Every list holds vdefs
+// indices in increasing order: filtering one with map_selector::accept()
+// gives the same maps in the same order as a full scan would, so vault
+// choice (and RNG use) is unaffected. Rebuilt lazily after any change to
+// vdefs, or to the tags, depths or place of a map in it.
+struct map_index
+{
+    bool valid = false;
+    vault_indices all_maps;
+    unordered_map<string, unsigned> tag_ids;
+    vector<vault_indices> tag_maps;
+    vector<uint8_t> flags;
+    vault_indices depth_maps[NUM_BRANCHES];
+    vault_indices place_maps[NUM_BRANCHES];
+};
+
+static map_index vindex;
+
+#ifdef DEBUG_STATISTICS
+static map_selection_stats selection_stats;
+#endif
+
 // Parameter array that vault code can use.
 string_vector map_parameters;
 
@@ -720,6 +759,109 @@ const map_def *find_map_by_name(const string &name)
     return nullptr;
 }
 
+void map_def_changed(const map_def &map)
+{
+    if (!vdefs.empty() && &map >= &vdefs.front() && &map <= &vdefs.back())
+        vindex.valid = false;
+}
+
+static uint8_t _map_index_flags(const map_def &map)
+{
+    uint8_t flags = 0;
+    if (map.is_minivault())
+        flags |= MIF_MINIVAULT;
+    if (map.is_extra_vault())
+        flags |= MIF_EXTRA;
+    if (map.has_tag("dummy"))
+        flags |= MIF_DUMMY;
+    if (map.has_tag_suffix("entry")
+        || map.has_tag("unrand")
+        || map.has_tag("place_unique")
+        || map.has_tag("tutorial")
+        || (map.has_tag_prefix("temple_")
+            && !map.has_tag_prefix("uniq_altar_")))
+    {
+        flags |= MIF_NO_DEPTH_PICK;
+    }
+    return flags;
+}
+
+static void _build_map_index()
+{
+    if (vindex.valid)
+        return;
+
+    vindex = map_index();
+    vindex.flags.reserve(vdefs.size());
+    for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+    {
+        const map_def &map = vdefs[i];
+        vindex.all_maps.push_back(i);
+        vindex.flags.push_back(_map_index_flags(map));
+
+        for (const string &tag : map.get_tags_unsorted())
+        {
+            auto id = vindex.tag_ids.emplace(tag, vindex.tag_maps.size());
+            if (id.second)
+                vindex.tag_maps.emplace_back();
+            vindex.tag_maps[id.first->second].push_back(i);
+        }
+
+        for (int br = 0; br < NUM_BRANCHES; ++br)
+        {
+            if (map.depths.might_match_branch(static_cast<branch_type>(br)))
+                vindex.depth_maps[br].push_back(i);
+            if (map.place.might_match_branch(static_cast<branch_type>(br)))
+                vindex.place_maps[br].push_back(i);
+        }
+    }
+    vindex.valid = true;
+}
+
+// The maps that have every one of the given tags, in vdefs order. The
+// result is either one of the index's own lists or is built in scratch.
+static const vault_indices &
+_maps_with_all_tags(const unordered_set<string> &tags, vault_indices &scratch)
+{
+    _build_map_index();
+
+    // map_def::has_all_tags() rejects everything for an empty tag list.
+    scratch.clear();
+    if (tags.empty())
+        return scratch;
+
+    vector<const vault_indices *> lists;
+    for (const string &tag : tags)
+    {
+        auto id = vindex.tag_ids.find(tag);
+        if (id == vindex.tag_ids.end())
+            return scratch;
+        lists.push_back(&vindex.tag_maps[id->second]);
+    }
+
+    if (lists.size() == 1)
+        return *lists[0];
+
+    // Intersect from the smallest list up, so the work stays proportional
+    // to the rarest tag.
+    sort(lists.begin(), lists.end(),
+         [](const vault_indices *a, const vault_indices *b)
+         {
+             return a->size() < b->size();
+         });
+    scratch = *lists[0];
+    vault_indices merged;
+    for (unsigned i = 1; i < lists.size() && !scratch.empty(); ++i)
+    {
+        merged.clear();
+        set_intersection(scratch.begin(), scratch.end(),
+                         lists[i]->begin(), lists[i]->end(),
+                         back_inserter(merged));
+        scratch.swap(merged);
+    }
+    return scratch;
+}
+
 // Discards Lua code loaded by all maps to reduce memory use. If any stripped
 // map is reused, its data will be reloaded from the .dsc
 void strip_all_maps()
@@ -746,8 +888,10 @@ mapref_vector find_maps_for_tag(const string &tag,
     level_id place = level_id::current();
     unordered_set<string> tag_set = parse_tags(tag);
 
-    for (const map_def &mapdef : vdefs)
+    vault_indices scratch;
+    for (unsigned i : _maps_with_all_tags(tag_set, scratch))
     {
+        const map_def &mapdef = vdefs[i];
         if (mapdef.has_all_tags(tag_set.begin(), tag_set.end())
             && !mapdef.has_tag("dummy")
             && (!check_depth || _debug_ignore_depth
@@ -775,6 +919,8 @@ private:
 public:
     bool accept(const map_def &md) const;
     void announce(const map_def *map) const;
+    const vault_indices &candidates(vault_indices &scratch) const;
+    bool flags_allow(uint8_t flags) const;
 
     bool valid() const
     {
@@ -917,6 +1063,45 @@ bool map_selector::accept(const map_def &mapdef) const
     }
 }
 
+// A superset of the maps accept() allows, taken from the index.
+const vault_indices &map_selector::candidates(vault_indices &scratch) const
+{
+    _build_map_index();
+    switch (sel)
+    {
+    case PLACE:
+        return vindex.place_maps[place.branch];
+    case DEPTH:
+    case DEPTH_AND_CHANCE:
+        return vindex.depth_maps[place.branch];
+    case TAG:
+        return _maps_with_all_tags(parse_tags(tag), scratch);
+    default:
+        return vindex.all_maps;
+    }
+}
+
+// Cheap checks against the index's flags, before the full accept().
+bool map_selector::flags_allow(uint8_t flags) const
+{
+    const bool is_extra = flags & MIF_EXTRA;
+    switch (sel)
+    {
+    case PLACE:
+        return bool(flags & MIF_MINIVAULT) == mini
+               && _is_extra_compatible(extra, is_extra);
+    case DEPTH:
+        return bool(flags & MIF_MINIVAULT) == mini
+               && _is_extra_compatible(extra, is_extra)
+               && !(flags & MIF_NO_DEPTH_PICK);
+    case DEPTH_AND_CHANCE:
+        return !(flags & (MIF_DUMMY | MIF_NO_DEPTH_PICK))
+               && _is_extra_compatible(extra, is_extra);
+    default:
+        return true;
+    }
+}
+
 void map_selector::announce(const map_def *vault) const
 {
 #ifdef DEBUG_DIAGNOSTICS
@@ -957,19 +1142,34 @@ string vault_chance_tag(const map_def &map)
     return "";
 }
 
-typedef vector<unsigned> vault_indices;
-
 static vault_indices _eligible_maps_for_selector(const map_selector &sel)
 {
+#ifdef DEBUG_STATISTICS
+    const auto start = chrono::steady_clock::now();
+    unsigned examined = 0;
+#endif
     vault_indices eligible;
 
     if (sel.valid())
     {
-        for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
-            if (sel.accept(vdefs[i]))
+        vault_indices scratch;
+        for (unsigned i : sel.candidates(scratch))
+        {
+#ifdef DEBUG_STATISTICS
+            ++examined;
+#endif
+            if (sel.flags_allow(vindex.flags[i]) && sel.accept(vdefs[i]))
                 eligible.push_back(i);
+        }
     }
 
+#ifdef DEBUG_STATISTICS
+    selection_stats.queries++;
+    selection_stats.maps_examined += examined;
+    selection_stats.maps_eligible += eligible.size();
+    selection_stats.usecs += chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - start).count();
+#endif
     return eligible;
 }
 
@@ -1243,6 +1443,405 @@ string get_descache_path(const string &file, const string &ext)
     return _des_cache_dir(basename);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// Consolidated map index.
+//
+// Opening every .idx file and decoding it through a FILE-backed reader
+// dominates startup, so once all the maps are loaded their index records
+// are also written to one file, maps.mdx, which later runs map into memory
+// (sharing the pages between processes) and decode from there while
+// read_maps() runs. Map selection looks at every map's index fields, so
+// those are all decoded then. Map bodies still come from the per-file .dsc
+// caches, read on demand by map_def::load() at the offset in each index
+// record. maps.mdx records each .dsc file's modification time and size, so
+// telling that it is still the one the records point into takes a stat()
+// rather than opening it; a file whose .dsc is missing or has changed is
+// loaded the old way instead, rebuilding its caches if need be.
+//
+// Layout: an mdx_header, an mdx_file per .des file, an mdx_map per map, a
+// table of nul-terminated strings, and a blob holding the global preludes
+// and the map_def::write_index() records. The file uses the native byte
+// order and struct layout; one written by a different build is ignored
+// and replaced.
+
+static const char MDX_MAGIC[4] = { 'C', 'M', 'D', 'X' };
+static const uint32_t MDX_FORMAT = 2;
+static const uint32_t MDX_BYTE_ORDER = 0x01020304;
+
+struct mdx_header
+{
+    char     magic[4];
+    uint32_t format;
+    uint32_t byte_order;
+    uint8_t  word_len;
+    uint8_t  tag_major;
+    uint16_t tag_minor;
+    uint32_t nfiles;
+    uint32_t nmaps;
+    uint32_t strings_size;
+    uint32_t blob_size;
+};
+
+struct mdx_file
+{
+    int64_t  mtime;         // of the .des file
+    int64_t  dsc_mtime;     // of its .dsc cache
+    int64_t  dsc_size;
+    uint32_t cache_name;    // string table offset
+    uint32_t first_map;
+    uint32_t nmaps;
+    uint32_t prelude;       // blob range of the global prelude, if any
+    uint32_t prelude_size;
+};
+
+struct mdx_map
+{
+    uint32_t description;   // string table offset
+    int32_t  order;
+    uint32_t index;         // blob range of the write_index() record
+    uint32_t index_size;
+};
+
+struct mdx_view
+{
+    const mdx_header    *head = nullptr;
+    const mdx_file      *files = nullptr;
+    const mdx_map       *maps = nullptr;
+    const char          *strings = nullptr;
+    const unsigned char *blob = nullptr;
+};
+
+// What each .des file loaded by read_maps() contributed, for writing a new
+// maps.mdx. Files that came from the current maps.mdx are copied from it.
+struct des_index_record
+{
+    string cache_name;
+    time_t mtime = 0;
+    int64_t dsc_mtime = 0;
+    int64_t dsc_size = 0;
+    size_t first_map = 0;
+    const mdx_file *cached = nullptr;
+    vector<unsigned char> prelude;
+    vector<vector<unsigned char>> index;
+};
+
+static unique_ptr<mapped_file> mdx_mapping;
+static mdx_view mdx;
+static map<string, const mdx_file *> mdx_files;
+static vector<des_index_record> des_loaded;
+static bool des_recording = false;
+static bool mdx_stale = false;
+
+static string _mdx_path()
+{
+    return _des_cache_dir("maps.mdx");
+}
+
+static bool _mdx_range_ok(uint32_t start, uint32_t size, uint32_t limit)
+{
+    return start <= limit && size <= limit - start;
+}
+
+static bool _check_mdx(const unsigned char *data, size_t size)
+{
+    if (size < sizeof(mdx_header))
+        return false;
+
+    const mdx_header &head = *reinterpret_cast<const mdx_header *>(data);
+    if (memcmp(head.magic, MDX_MAGIC, sizeof(MDX_MAGIC))
+        || head.format != MDX_FORMAT
+        || head.byte_order != MDX_BYTE_ORDER
+        || head.word_len != WORD_LEN
+        || head.tag_major != TAG_MAJOR_VERSION
+        || head.tag_minor != TAG_MINOR_VERSION)
+    {
+        return false;
+    }
+
+    const uint64_t expected = sizeof(mdx_header)
+                              + (uint64_t) head.nfiles * sizeof(mdx_file)
+                              + (uint64_t) head.nmaps * sizeof(mdx_map)
+                              + head.strings_size + head.blob_size;
+    if (expected != size)
+        return false;
+
+    mdx.head = &head;
+    mdx.files = reinterpret_cast<const mdx_file *>(data + sizeof(mdx_header));
+    mdx.maps = reinterpret_cast<const mdx_map *>(mdx.files + head.nfiles);
+    mdx.strings = reinterpret_cast<const char *>(mdx.maps + head.nmaps);
+    mdx.blob = reinterpret_cast<const unsigned char *>(mdx.strings
+                                                       + head.strings_size);
+
+    // Every string must be terminated within the table.
+    if (head.strings_size && mdx.strings[head.strings_size - 1])
+        return false;
+
+    for (uint32_t i = 0; i < head.nfiles; ++i)
+    {
+        const mdx_file &file = mdx.files[i];
+        if (file.cache_name >= head.strings_size
+            || !_mdx_range_ok(file.first_map, file.nmaps, head.nmaps)
+            || !_mdx_range_ok(file.prelude, file.prelude_size,
+                              head.blob_size))
+        {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < head.nmaps; ++i)
+    {
+        const mdx_map &map = mdx.maps[i];
+        if (map.description >= head.strings_size
+            || !_mdx_range_ok(map.index, map.index_size, head.blob_size))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _close_map_mdx()
+{
+    mdx_mapping.reset();
+    mdx = mdx_view();
+    mdx_files.clear();
+}
+
+static void _open_map_mdx()
+{
+    _close_map_mdx();
+    _check_des_index_dir();
+
+    mdx_mapping.reset(new mapped_file(_mdx_path()));
+    if (!mdx_mapping->valid()
+        || !_check_mdx(mdx_mapping->data(), mdx_mapping->size()))
+    {
+        _close_map_mdx();
+        return;
+    }
+
+    for (uint32_t i = 0; i < mdx.head->nfiles; ++i)
+        mdx_files[mdx.strings + mdx.files[i].cache_name] = &mdx.files[i];
+}
+
+// The modification time and size of a .des file's .dsc cache.
+static bool _stat_map_full(const string &cachename, int64_t &mtime,
+                           int64_t &size)
+{
+    struct stat st;
+    if (stat((get_descache_path(cachename, "") + ".dsc").c_str(), &st))
+        return false;
+
+    mtime = st.st_mtime;
+    size = st.st_size;
+    return true;
+}
+
+// Load the maps of a .des file from maps.mdx, if it has them and they are
+// up to date. The records point into the file's .dsc cache, which
+// map_def::load() reads bodies from, so that has to be the one they were
+// written with.
+static bool _load_map_mdx(const string &filename, const string &cachename)
+{
+    const auto found = mdx_files.find(cachename);
+    if (found == mdx_files.end())
+        return false;
+
+    const mdx_file &file = *found->second;
+    const time_t mtime = file_modtime(filename);
+    if (file.mtime != mtime)
+        return false;
+
+    int64_t dsc_mtime, dsc_size;
+    if (!_stat_map_full(cachename, dsc_mtime, dsc_size)
+        || dsc_mtime != file.dsc_mtime || dsc_size != file.dsc_size)
+    {
+        return false;
+    }
+
+    if (file.prelude_size)
+    {
+        reader inf(mdx.blob + file.prelude, file.prelude_size,
+                   TAG_MINOR_VERSION);
+        lc_global_prelude.read(inf);
+        global_preludes.push_back(lc_global_prelude);
+    }
+
+    const size_t nexist = vdefs.size();
+    vdefs.resize(nexist + file.nmaps, map_def());
+    vindex.valid = false;
+    for (uint32_t i = 0; i < file.nmaps; ++i)
+    {
+        const mdx_map &rec = mdx.maps[file.first_map + i];
+        map_def &vdef(vdefs[nexist + i]);
+        reader inf(mdx.blob + rec.index, rec.index_size, TAG_MINOR_VERSION);
+        vdef.read_index(inf);
+        vdef.description = mdx.strings + rec.description;
+        vdef.order = rec.order;
+
+        vdef.set_file(cachename);
+        lc_loaded_maps[vdef.name] = vdef.place_loaded_from;
+        vdef.place_loaded_from.clear();
+    }
+
+    des_index_record loaded;
+    loaded.cache_name = cachename;
+    loaded.mtime = mtime;
+    loaded.dsc_mtime = dsc_mtime;
+    loaded.dsc_size = dsc_size;
+    loaded.first_map = nexist;
+    loaded.cached = &file;
+    des_loaded.push_back(move(loaded));
+    return true;
+}
+
+// Remember the index records of a .des file that had to be loaded from its
+// own cache or parsed, so that they can go into a new maps.mdx.
+static void _note_des_loaded(const string &cachename, time_t mtime,
+                             size_t first_map, const dlua_chunk *prelude)
+{
+    if (!des_recording)
+        return;
+    mdx_stale = true;
+
+    des_index_record loaded;
+    loaded.cache_name = cachename;
+    loaded.mtime = mtime;
+    loaded.first_map = first_map;
+    if (prelude && !prelude->empty())
+    {
+        writer outf(&loaded.prelude);
+        prelude->write(outf);
+    }
+    for (size_t i = first_map; i < vdefs.size(); ++i)
+    {
+        map_def &vdef(vdefs[i]);
+        // write_index() wants the place the map was loaded from, which is
+        // only kept in lc_loaded_maps once the maps have been cached.
+        const map_file_place place = vdef.place_loaded_from;
+        vdef.place_loaded_from = lc_loaded_maps[vdef.name];
+        loaded.index.emplace_back();
+        writer outf(&loaded.index.back());
+        vdef.write_index(outf);
+        vdef.place_loaded_from = place;
+    }
+    des_loaded.push_back(move(loaded));
+}
+
+static uint32_t _mdx_add_string(vector<char> &strings, const string &s)
+{
+    const uint32_t offset = strings.size();
+    strings.insert(strings.end(), s.begin(), s.end());
+    strings.push_back(0);
+    return offset;
+}
+
+static uint32_t _mdx_add_blob(vector<unsigned char> &blob,
+                              const unsigned char *data, size_t size)
+{
+    const uint32_t offset = blob.size();
+    blob.insert(blob.end(), data, data + size);
+    return offset;
+}
+
+static void _write_map_mdx()
+{
+    vector<mdx_file> files;
+    vector<mdx_map> maps;
+    vector<char> strings;
+    vector<unsigned char> blob;
+
+    for (des_index_record &loaded : des_loaded)
+    {
+        // Files loaded from their own caches or parsed have only now had
+        // their .dsc written, if it needed to be. One without a .dsc is
+        // left out, and loaded the old way next time.
+        if (!loaded.cached
+            && !_stat_map_full(loaded.cache_name, loaded.dsc_mtime,
+                               loaded.dsc_size))
+        {
+            continue;
+        }
+
+        mdx_file file = {};
+        file.mtime = loaded.mtime;
+        file.dsc_mtime = loaded.dsc_mtime;
+        file.dsc_size = loaded.dsc_size;
+        file.cache_name = _mdx_add_string(strings, loaded.cache_name);
+        file.first_map = maps.size();
+        file.nmaps = loaded.cached ? loaded.cached->nmaps
+                                   : loaded.index.size();
+        if (loaded.cached)
+        {
+            file.prelude = _mdx_add_blob(blob,
+                                         mdx.blob + loaded.cached->prelude,
+                                         loaded.cached->prelude_size);
+            file.prelude_size = loaded.cached->prelude_size;
+        }
+        else
+        {
+            file.prelude = _mdx_add_blob(blob, loaded.prelude.data(),
+                                         loaded.prelude.size());
+            file.prelude_size = loaded.prelude.size();
+        }
+
+        for (uint32_t i = 0; i < file.nmaps; ++i)
+        {
+            const map_def &vdef(vdefs[loaded.first_map + i]);
+            mdx_map map = {};
+            map.description = _mdx_add_string(strings, vdef.description);
+            map.order = vdef.order;
+            if (loaded.cached)
+            {
+                const mdx_map &old = mdx.maps[loaded.cached->first_map + i];
+                map.index = _mdx_add_blob(blob, mdx.blob + old.index,
+                                          old.index_size);
+                map.index_size = old.index_size;
+            }
+            else
+            {
+                map.index = _mdx_add_blob(blob, loaded.index[i].data(),
+                                          loaded.index[i].size());
+                map.index_size = loaded.index[i].size();
+            }
+            maps.push_back(map);
+        }
+        files.push_back(file);
+    }
+
+    mdx_header head = {};
+    memcpy(head.magic, MDX_MAGIC, sizeof(MDX_MAGIC));
+    head.format = MDX_FORMAT;
+    head.byte_order = MDX_BYTE_ORDER;
+    head.word_len = WORD_LEN;
+    head.tag_major = TAG_MAJOR_VERSION;
+    head.tag_minor = TAG_MINOR_VERSION;
+    head.nfiles = files.size();
+    head.nmaps = maps.size();
+    head.strings_size = strings.size();
+    head.blob_size = blob.size();
+
+    // Write to a new file and rename it over the old one, so that anyone
+    // with the old index mapped keeps a consistent copy.
+    const string path = _mdx_path();
+    const string tmp = path + ".tmp";
+    file_lock mdxlock(path + ".lk", "wb", false);
+    unlink_u(tmp.c_str());
+    FILE *fp = fopen_u(tmp.c_str(), "wb");
+    if (!fp)
+        return;
+
+    const bool ok =
+        fwrite(&head, sizeof(head), 1, fp) == 1
+        && fwrite(files.data(), sizeof(mdx_file), files.size(), fp)
+           == files.size()
+        && fwrite(maps.data(), sizeof(mdx_map), maps.size(), fp)
+           == maps.size()
+        && fwrite(strings.data(), 1, strings.size(), fp) == strings.size()
+        && fwrite(blob.data(), 1, blob.size(), fp) == blob.size();
+    if (fclose(fp) || !ok || rename_u(tmp.c_str(), path.c_str()))
+        unlink_u(tmp.c_str());
+}
+
 static bool verify_file_version(const string &file, time_t mtime)
 {
     FILE *fp = fopen_u(file.c_str(), "rb");
@@ -1282,6 +1881,7 @@ static bool _load_map_index(const string& cache, const string &base,
                             time_t mtime)
 {
     // If there's a global prelude, load that first.
+    bool have_prelude = false;
     if (FILE *fp = fopen_u((base + ".lux").c_str(), "rb"))
     {
         reader inf(fp, TAG_MINOR_VERSION);
@@ -1299,6 +1899,7 @@ static bool _load_map_index(const string& cache, const string &base,
         fclose(fp);
 
         global_preludes.push_back(lc_global_prelude);
+        have_prelude = true;
     }
 
     FILE* fp = fopen_u((base + ".idx").c_str(), "rb");
@@ -1326,6 +1927,7 @@ static bool _load_map_index(const string& cache, const string &base,
     const int nmaps = unmarshallShort(inf);
     const int nexist = vdefs.size();
     vdefs.resize(nexist + nmaps, map_def());
+    vindex.valid = false;
     for (int i = 0; i < nmaps; ++i)
     {
         map_def &vdef(vdefs[nexist + i]);
@@ -1339,6 +1941,8 @@ static bool _load_map_index(const string& cache, const string &base,
     }
     fclose(fp);
 
+    _note_des_loaded(cache, mtime, nexist,
+                     have_prelude ? &lc_global_prelude : nullptr);
     return true;
 }
 
@@ -1444,7 +2048,7 @@ static void _parse_maps(const string &s)
 
     map_files_read.insert(cache_name);
 
-    if (_load_map_cache(s, cache_name))
+    if (_load_map_mdx(s, cache_name) || _load_map_cache(s, cache_name))
         return;
 
     FILE *dat = fopen_u(s.c_str(), "r");
@@ -1470,6 +2074,7 @@ static void _parse_maps(const string &s)
 
     global_preludes.push_back(lc_global_prelude);
 
+    _note_des_loaded(cache_name, mtime, file_start, &lc_global_prelude);
     _write_map_cache(cache_name, file_start, vdefs.size(), mtime);
 }
 
@@ -1483,8 +2088,20 @@ void read_map(const string &file)
 
 void read_maps()
 {
-    if (dlua.execfile("dlua/loadmaps.lua", true, true, true))
-        end(1, false, "Lua error: %s", dlua.error.c_str());
+    des_loaded.clear();
+    mdx_stale = false;
+    _open_map_mdx();
+
+    {
+        unwind_bool recording(des_recording, true);
+        if (dlua.execfile("dlua/loadmaps.lua", true, true, true))
+            end(1, false, "Lua error: %s", dlua.error.c_str());
+    }
+
+    if (mdx_stale)
+        _write_map_mdx();
+    _close_map_mdx();
+    des_loaded.clear();
 
     lc_loaded_maps.clear();
 
@@ -1509,6 +2126,7 @@ void reread_maps()
 
     // BOOM!
     vdefs.clear();
+    vindex.valid = false;
     map_files_read.clear();
     read_maps();
 }
@@ -1528,6 +2146,7 @@ void add_parsed_map(const map_def &md)
 
     map.fixup();
     vdefs.push_back(map);
+    vindex.valid = false;
 }
 
 void run_map_global_preludes()
@@ -1566,6 +2185,24 @@ const map_def *map_by_index(int index)
 // Supporting map code for mapstat
 #ifdef DEBUG_STATISTICS
 
+const map_selection_stats &mapstat_selection_stats()
+{
+    return selection_stats;
+}
+
+void mapstat_add_selection_stats(const map_selection_stats &stats)
+{
+    selection_stats.queries += stats.queries;
+    selection_stats.maps_examined += stats.maps_examined;
+    selection_stats.maps_eligible += stats.maps_eligible;
+    selection_stats.usecs += stats.usecs;
+}
+
+void mapstat_reset_selection_stats()
+{
+    selection_stats = map_selection_stats();
+}
+
 typedef pair<string, int> weighted_map_name;
 typedef vector<weighted_map_name> weighted_map_names;
 
@@ -46,6 +46,10 @@ mapref_vector random_chance_maps_in_depth(const level_id &place,
 
 void dgn_ignore_depth(bool b);
 
+// Call after changing the tags, depths or place of a map that may be one
+// of the loaded vault definitions.
+void map_def_changed(const map_def &map);
+
 void dump_map(const map_def &map);
 void add_parsed_map(const map_def &md);
 
@@ -93,5 +97,16 @@ private:
 };
 
 #ifdef DEBUG_STATISTICS
+struct map_selection_stats
+{
+    unsigned queries = 0;
+    uint64_t maps_examined = 0;
+    uint64_t maps_eligible = 0;
+    uint64_t usecs = 0;
+};
+
+const map_selection_stats &mapstat_selection_stats();
+void mapstat_add_selection_stats(const map_selection_stats &stats);
+void mapstat_reset_selection_stats();
 void mapstat_report_random_maps(FILE *outf, const level_id &place);
 #endif
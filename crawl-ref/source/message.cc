@@ -1343,15 +1343,66 @@ void dprf(diag_type param, const char *format, ...)
 
 static bool _updating_view = false;
 
+static const message_filter &_filter_of(const message_filter &mf)
+{
+    return mf;
+}
+
+static const message_filter &_filter_of(const message_colour_mapping &mcm)
+{
+    return mcm.message;
+}
+
+// The patterns of one message filter option compiled together, and
+// bucketed by the channels they apply to. Rebuilt when the options change.
+class message_filter_matcher
+{
+public:
+    message_filter_matcher() : generation(0), matcher(), by_channel() { }
+
+    // The index of the first filter in the option that catches the message,
+    // or -1 if none do.
+    template<typename T>
+    int first_match(const vector<T> &option, msg_channel_type channel,
+                    const string &line)
+    {
+        if (generation != Options.generation)
+            build(option);
+        ASSERT_RANGE(channel, 0, NUM_MESSAGE_CHANNELS);
+        return matcher.first_match(line, by_channel[channel]);
+    }
+
+private:
+    template<typename T>
+    void build(const vector<T> &option)
+    {
+        matcher.clear();
+        for (vector<int> &indices : by_channel)
+            indices.clear();
+
+        for (size_t i = 0; i < option.size(); ++i)
+        {
+            const message_filter &mf(_filter_of(option[i]));
+            matcher.add(mf.pattern, true);
+            for (int ch = 0; ch < NUM_MESSAGE_CHANNELS; ++ch)
+                if (mf.channel == -1 || mf.channel == ch)
+                    by_channel[ch].push_back(i);
+        }
+        generation = Options.generation;
+    }
+
+    unsigned int generation;
+    pattern_list_matcher matcher;
+    FixedVector<vector<int>, NUM_MESSAGE_CHANNELS> by_channel;
+};
+
 static bool _check_option(const string& line, msg_channel_type channel,
-                          const vector<message_filter>& option)
+                          const vector<message_filter>& option,
+                          message_filter_matcher &matcher)
 {
     if (crawl_state.generating_level)
         return false;
-    return any_of(begin(option),
-                  end(option),
-                  bind(mem_fn(&message_filter::is_filtered),
-                       placeholders::_1, channel, line));
+    return matcher.first_match(option, channel, line) != -1;
 }
 
 static bool _check_more(const string& line, msg_channel_type channel)
@@ -1361,7 +1412,8 @@ static bool _check_more(const string& line, msg_channel_type channel)
     // crash here in order to find the real bug?
     if (!you.on_current_level)
         return false;
-    return _check_option(line, channel, Options.force_more_message);
+    static message_filter_matcher matcher;
+    return _check_option(line, channel, Options.force_more_message, matcher);
 }
 
 static bool _check_flash_screen(const string& line, msg_channel_type channel)
@@ -1371,7 +1423,9 @@ static bool _check_flash_screen(const string& line, msg_channel_type channel)
     // crash here in order to find the real bug?
     if (!you.on_current_level)
         return false;
-    return _check_option(line, channel, Options.flash_screen_message);
+    static message_filter_matcher matcher;
+    return _check_option(line, channel, Options.flash_screen_message,
+                         matcher);
 }
 
 static bool _check_join(const string& /*line*/, msg_channel_type channel)
@@ -1726,21 +1780,23 @@ static void mpr_check_patterns(const string& message,
 {
     if (crawl_state.generating_level)
         return;
-    for (const text_pattern &pat : Options.note_messages)
-    {
-        if (channel == MSGCH_EQUIPMENT || channel == MSGCH_FLOOR_ITEMS
-            || channel == MSGCH_MULTITURN_ACTION
-            || channel == MSGCH_EXAMINE || channel == MSGCH_EXAMINE_FILTER
-            || channel == MSGCH_TUTORIAL || channel == MSGCH_DGL_MESSAGE)
+    if (channel != MSGCH_EQUIPMENT && channel != MSGCH_FLOOR_ITEMS
+        && channel != MSGCH_MULTITURN_ACTION
+        && channel != MSGCH_EXAMINE && channel != MSGCH_EXAMINE_FILTER
+        && channel != MSGCH_TUTORIAL && channel != MSGCH_DGL_MESSAGE)
+    {
+        static pattern_list_matcher note_matcher;
+        static unsigned int note_generation = 0;
+        if (note_generation != Options.generation)
         {
-            continue;
+            note_matcher.clear();
+            for (const text_pattern &pat : Options.note_messages)
+                note_matcher.add(pat);
+            note_generation = Options.generation;
         }
 
-        if (pat.matches(message))
-        {
+        if (note_matcher.first_match(message) != -1)
             take_note(Note(NOTE_MESSAGE, channel, param, message));
-            break;
-        }
     }
 
     if (channel != MSGCH_DIAGNOSTICS && channel != MSGCH_EQUIPMENT)
@@ -1786,14 +1842,12 @@ static msg_colour_type prepare_message(const string& imsg,
 
     if (!crawl_state.generating_level)
     {
-        for (const message_colour_mapping &mcm : Options.message_colour_mappings)
-        {
-            if (mcm.message.is_filtered(channel, imsg))
-            {
-                colour = mcm.colour;
-                break;
-            }
-        }
+        static message_filter_matcher colour_matcher;
+        const int mapping =
+            colour_matcher.first_match(Options.message_colour_mappings,
+                                       channel, imsg);
+        if (mapping != -1)
+            colour = Options.message_colour_mappings[mapping].colour;
     }
 
     return colour;
@@ -2294,12 +2294,24 @@ priority_queue<pair<monster *, int>,
                vector<pair<monster *, int> >,
                MonsterActionQueueCompare> monster_queue;
 
+#ifdef DEBUG
+static monster_queue_stats queue_stats;
+
+const monster_queue_stats &last_monster_queue_stats()
+{
+    return queue_stats;
+}
+#endif
+
 // Inserts a monster into the monster queue (needed to ensure that any monsters
 // given energy or an action by a effect can actually make use of that energy
 // this round)
 void queue_monster_for_action(monster* mons)
 {
     monster_queue.emplace(mons, mons->speed_increment);
+#ifdef DEBUG
+    queue_stats.pushes++;
+#endif
 }
 
 static void _clear_monster_flags()
@@ -2373,12 +2385,18 @@ static void _display_just_seen()
  */
 void handle_monsters(bool with_noise)
 {
+#ifdef DEBUG
+    queue_stats = monster_queue_stats();
+#endif
     for (monster_iterator mi; mi; ++mi)
     {
         _pre_monster_move(**mi);
         if (!invalid_monster(*mi) && mi->alive() && mi->has_action_energy())
             monster_queue.emplace(*mi, mi->speed_increment);
     }
+#ifdef DEBUG
+    queue_stats.queued = queue_stats.pushes = monster_queue.size();
+#endif
 
     int tries = 0; // infinite loop protection, shouldn't be ever needed
     while (!monster_queue.empty())
@@ -2408,10 +2426,22 @@ void handle_monsters(bool with_noise)
             handle_monster_move(mon);
             _post_monster_move(mon);
             fire_final_effects();
+#ifdef DEBUG
+            queue_stats.actions++;
+#endif
         }
+#ifdef DEBUG
+        else
+            queue_stats.stale++;
+#endif
 
         if (mon->has_action_energy())
+        {
             monster_queue.emplace(mon, mon->speed_increment);
+#ifdef DEBUG
+            queue_stats.pushes++;
+#endif
+        }
 
         // If the player got banished, discard pending monster actions.
         if (you.banished)
@@ -39,4 +39,17 @@ void handle_monster_move(monster* mon);
 
 void queue_monster_for_action(monster* mons);
 
+#ifdef DEBUG
+// What the last handle_monsters() call did.
+struct monster_queue_stats
+{
+    int queued = 0;     // monsters with energy to act at the start
+    int actions = 0;    // monster moves made
+    int stale = 0;      // entries whose monster's energy had changed
+    int pushes = 0;     // entries pushed, including the initial ones
+};
+
+const monster_queue_stats &last_monster_queue_stats();
+#endif
+
 #define ENERGY_SUBMERGE(entry) (max(entry->energy_usage.swim / 2, 1))
@@ -8,6 +8,7 @@
 #include "mon-cast.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <functional>
 #include <unordered_set>
@@ -3761,6 +3762,10 @@ bool handle_mon_spell(monster* mons)
         return false;
     }
 
+    // Choosing a spell often traces the same beam more than once; nothing
+    // else acts meanwhile, so remember the tracers until the choice is made.
+    auto tracer_memo = make_unique<monster_tracer_memo>();
+
     const monster_spells hspell_pass = _find_usable_spells(*mons);
 
     // If no useful spells... cast no spell.
@@ -3819,6 +3824,7 @@ bool handle_mon_spell(monster* mons)
 
     const mon_spell_slot spell_slot
         = _choose_spell_to_cast(*mons, beem, hspell_pass, ignore_good_idea);
+    tracer_memo.reset();
     const spell_type spell_cast = spell_slot.spell;
     const mon_spell_slot_flags flags = spell_slot.flags;
 
@@ -7774,3 +7780,87 @@ static string _god_name(god_type god)
 {
     return god_has_name(god) ? god_name(god) : "Something";
 }
+
+#if defined(DEBUG_DIAGNOSTICS) || defined(DEBUG_TESTS)
+// Trace the beam twice, as choosing a spell might, and note the results.
+static void _trace_twice(const monster &mons, const bolt &beem, bool explode,
+                         bolt (&out)[2], bool (&fire)[2])
+{
+    for (int i = 0; i < 2; i++)
+    {
+        out[i] = beem;
+        fire_tracer(&mons, out[i], explode);
+        fire[i] = mons_should_fire(out[i]);
+    }
+}
+
+/**
+ * Fire a tracer for every beam spell of every monster on the level at its
+ * target, with and without the tracer memo, under the same seeds.
+ *
+ * @param rounds    How many seeds to try for each tracer.
+ * @return          How many tracers were fired, how many gave a different
+ *                  result through the memo, and the milliseconds each way
+ *                  took.
+ */
+tracer_memo_check_result debug_tracer_memo_check(int rounds)
+{
+    tracer_memo_check_result result;
+
+    for (monster_iterator mi; mi; ++mi)
+    {
+        for (const mon_spell_slot &slot : mi->spells)
+        {
+            if (!(get_spell_flags(slot.spell) & spflag::needs_tracer))
+                continue;
+
+            bolt beem = setup_targetting_beam(**mi);
+            setup_mons_cast(*mi, beem, slot.spell);
+            if (!in_bounds(beem.target))
+                continue;
+            const bool explode = spell_is_direct_explosion(slot.spell);
+
+            for (int r = 0; r < rounds; r++)
+            {
+                const uint64_t seed = mi->mid * 1000003ULL + slot.spell * 101
+                                      + r;
+                bolt fresh[2], memo[2];
+                bool fresh_fire[2], memo_fire[2];
+
+                auto start = chrono::steady_clock::now();
+                {
+                    rng::subgenerator subgen(seed);
+                    _trace_twice(**mi, beem, explode, fresh, fresh_fire);
+                }
+                auto mid = chrono::steady_clock::now();
+                {
+                    rng::subgenerator subgen(seed);
+                    monster_tracer_memo tracer_memo;
+                    _trace_twice(**mi, beem, explode, memo, memo_fire);
+                }
+                auto end = chrono::steady_clock::now();
+
+                result.fresh_ms += chrono::duration_cast<chrono::microseconds>(
+                    mid - start).count() / 1000.0;
+                result.memo_ms += chrono::duration_cast<chrono::microseconds>(
+                    end - mid).count() / 1000.0;
+
+                for (int i = 0; i < 2; i++)
+                {
+                    result.tracers++;
+                    if (!fresh[i].same_state(memo[i])
+                        || fresh_fire[i] != memo_fire[i])
+                    {
+                        result.mismatches++;
+                        dprf("tracer memo mismatch: %s casting %s",
+                             mi->name(DESC_PLAIN, true).c_str(),
+                             spell_title(slot.spell));
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+#endif
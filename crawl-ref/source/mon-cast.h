@@ -51,3 +51,12 @@ void setup_breath_timeout(monster* mons);
 monster* cast_phantom_mirror(monster* mons, monster* targ,
                              int hp_perc = 35,
                              int summ_type = SPELL_PHANTOM_MIRROR);
+
+struct tracer_memo_check_result
+{
+    int tracers = 0;
+    int mismatches = 0;
+    double fresh_ms = 0;
+    double memo_ms = 0;
+};
+tracer_memo_check_result debug_tracer_memo_check(int rounds);
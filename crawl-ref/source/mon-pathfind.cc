@@ -2,6 +2,9 @@
 
 #include "mon-pathfind.h"
 
+#include <cstring>
+#include <memory>
+
 #include "directn.h"
 #include "env.h"
 #include "los.h"
@@ -59,16 +62,158 @@ int mons_tracking_range(const monster* mon)
     return range;
 }
 
+// The search state behind a monster_pathfind. Per-grid entries are only
+// valid if their stamp matches the current search, so starting a new search
+// doesn't need to clear anything. Grids waiting to be looked at are kept in
+// buckets indexed by their estimated total path length; each bucket is an
+// intrusive doubly linked list of grid indices, used as a stack.
+struct pathfind_state
+{
+    static const int NUM_BUCKETS = GXM * GYM;
+    static const int NONE = -1;
+
+    struct grid_entry
+    {
+        unsigned int stamp;  // The search this entry is valid for.
+        int dist;            // Distance from start.
+        int8_t dir;          // Compass direction to the previous grid.
+        bool queued;         // Waiting in a bucket?
+        int below, above;    // Neighbours within the bucket.
+    };
+
+    unsigned int search;
+    grid_entry grids[GXM * GYM];
+    unsigned int bucket_stamp[NUM_BUCKETS];
+    int bucket_top[NUM_BUCKETS];
+
+    pathfind_state() : search(0)
+    {
+        memset(grids, 0, sizeof(grids));
+        memset(bucket_stamp, 0, sizeof(bucket_stamp));
+    }
+
+    void new_search()
+    {
+        if (++search == 0)
+        {
+            // The stamps wrapped around; really clear everything.
+            memset(grids, 0, sizeof(grids));
+            memset(bucket_stamp, 0, sizeof(bucket_stamp));
+            search = 1;
+        }
+    }
+
+    static int index(const coord_def &p)
+    {
+        return p.x * GYM + p.y;
+    }
+
+    static coord_def grid(int i)
+    {
+        return coord_def(i / GYM, i % GYM);
+    }
+
+    const grid_entry *find(const coord_def &p) const
+    {
+        const grid_entry &e = grids[index(p)];
+        return e.stamp == search ? &e : nullptr;
+    }
+
+    grid_entry &at(const coord_def &p)
+    {
+        grid_entry &e = grids[index(p)];
+        if (e.stamp != search)
+        {
+            e.stamp  = search;
+            e.dist   = INFINITE_DISTANCE;
+            e.dir    = 0;
+            e.queued = false;
+        }
+        return e;
+    }
+
+    int &top(int bucket)
+    {
+        ASSERT_RANGE(bucket, 0, NUM_BUCKETS);
+        if (bucket_stamp[bucket] != search)
+        {
+            bucket_stamp[bucket] = search;
+            bucket_top[bucket] = NONE;
+        }
+        return bucket_top[bucket];
+    }
+
+    bool empty(int bucket)
+    {
+        return top(bucket) == NONE;
+    }
+
+    void push(int bucket, const coord_def &p)
+    {
+        const int i = index(p);
+        grid_entry &e = at(p);
+        int &t = top(bucket);
+        e.queued = true;
+        e.below  = t;
+        e.above  = NONE;
+        if (t != NONE)
+            grids[t].above = i;
+        t = i;
+    }
+
+    coord_def pop(int bucket)
+    {
+        int &t = top(bucket);
+        ASSERT(t != NONE);
+        grid_entry &e = grids[t];
+        const coord_def p = grid(t);
+        e.queued = false;
+        t = e.below;
+        if (t != NONE)
+            grids[t].above = NONE;
+        return p;
+    }
+
+    void remove(int bucket, const coord_def &p)
+    {
+        const int i = index(p);
+        grid_entry &e = grids[i];
+        ASSERT(e.stamp == search && e.queued);
+        e.queued = false;
+        if (e.above != NONE)
+            grids[e.above].below = e.below;
+        else
+            top(bucket) = e.below;
+        if (e.below != NONE)
+            grids[e.below].above = e.above;
+    }
+};
+
+// Search states not in use by any monster_pathfind. Pathfinders can nest,
+// so each one borrows its own.
+static vector<unique_ptr<pathfind_state>> spare_pathfind_states;
+
+static pathfind_state *_get_pathfind_state()
+{
+    if (spare_pathfind_states.empty())
+        return new pathfind_state;
+
+    pathfind_state *state = spare_pathfind_states.back().release();
+    spare_pathfind_states.pop_back();
+    return state;
+}
+
 //#define DEBUG_PATHFIND
 monster_pathfind::monster_pathfind()
     : mons(nullptr), start(), target(), pos(), allow_diagonals(true),
       traverse_unmapped(false), range(0), min_length(0), max_length(0),
-      dist(), prev(), hash()
+      state(_get_pathfind_state())
 {
 }
 
 monster_pathfind::~monster_pathfind()
 {
+    spare_pathfind_states.emplace_back(state);
 }
 
 void monster_pathfind::set_range(int r)
@@ -79,7 +224,21 @@ void monster_pathfind::set_range(int r)
 
 coord_def monster_pathfind::next_pos(const coord_def &c) const
 {
-    return c + Compass[prev[c.x][c.y]];
+    const pathfind_state::grid_entry *e = state->find(c);
+    return c + Compass[e ? e->dir : 0];
+}
+
+int monster_pathfind::get_dist(const coord_def &p) const
+{
+    const pathfind_state::grid_entry *e = state->find(p);
+    return e ? e->dist : INFINITE_DISTANCE;
+}
+
+void monster_pathfind::set_dist(const coord_def &p, int d, int dir)
+{
+    pathfind_state::grid_entry &e = state->at(p);
+    e.dist = d;
+    e.dir  = dir;
 }
 
 // The main method in the monster_pathfind class.
@@ -135,11 +294,8 @@ bool monster_pathfind::start_pathfind(bool msg)
     //       a wall.
 
     max_length = min_length = grid_distance(pos, target);
-    for (int i = 0; i < GXM; i++)
-        for (int j = 0; j < GYM; j++)
-            dist[i][j] = INFINITE_DISTANCE;
-
-    dist[pos.x][pos.y] = 0;
+    state->new_search();
+    set_dist(pos, 0, 0);
 
     bool success = false;
     do
@@ -209,8 +365,8 @@ bool monster_pathfind::calc_path_to_neighbours()
         if (range && estimated_cost(npos) > range)
             continue;
 
-        distance = dist[pos.x][pos.y] + travel_cost(npos);
-        old_dist = dist[npos.x][npos.y];
+        distance = get_dist(pos) + travel_cost(npos);
+        old_dist = get_dist(npos);
 
         // Also bail out if this would make the path longer than twice the
         // allowed distance from the target. (This factor may need tuning.)
@@ -251,16 +407,13 @@ bool monster_pathfind::calc_path_to_neighbours()
                 update_pos(npos, total);
             }
 
-            // Update distance start->pos.
-            dist[npos.x][npos.y] = distance;
-
-            // Set backtracking information.
+            // Update distance start->pos, and set backtracking information.
             // Converts the Compass direction to its counterpart.
             //      0  1  2         4  5  6
             //      7  .  3   ==>   3  .  7       e.g. (3 + 4) % 8          = 7
             //      6  5  4         2  1  0            (7 + 4) % 8 = 11 % 8 = 3
 
-            prev[npos.x][npos.y] = (dir + 4) % 8;
+            set_dist(npos, distance, (dir + 4) % 8);
 
             // Are we finished?
             if (npos == target)
@@ -276,22 +429,20 @@ bool monster_pathfind::calc_path_to_neighbours()
 }
 
 // Starting at known min_length (minimum total estimated path distance), check
-// the hash for existing vectors, then pick the last entry of the first vector
-// that matches. Update min_length, if necessary.
+// the buckets for waiting grids, then pick the last entry of the first bucket
+// that has any. Update min_length, if necessary.
 bool monster_pathfind::get_best_position()
 {
     for (int i = min_length; i <= max_length; i++)
     {
-        if (!hash[i].empty())
+        if (!state->empty(i))
         {
             if (i > min_length)
                 min_length = i;
 
-            vector<coord_def> &vec = hash[i];
-            // Pick the last position pushed into the vector as it's most
+            // Pick the last position pushed into the bucket as it's most
             // likely to be close to the target.
-            pos = vec[vec.size()-1];
-            vec.pop_back();
+            pos = state->pop(i);
 
 #ifdef DEBUG_PATHFIND
             mprf("Returning (%d, %d) as best pos with total dist %d.",
@@ -326,7 +477,7 @@ vector<coord_def> monster_pathfind::backtrack()
     int dir;
     do
     {
-        dir = prev[pos.x][pos.y];
+        dir = state->find(pos)->dir;
         pos = pos + Compass[dir];
         ASSERT_IN_BOUNDS(pos);
 #ifdef DEBUG_PATHFIND
@@ -491,24 +642,15 @@ int monster_pathfind::estimated_cost(coord_def p)
 
 void monster_pathfind::add_new_pos(coord_def npos, int total)
 {
-    hash[total].push_back(npos);
+    state->push(total, npos);
 }
 
 void monster_pathfind::update_pos(coord_def npos, int total)
 {
-    // Find hash position of old distance and delete it,
-    // then call_add_new_pos.
-    int old_total = dist[npos.x][npos.y] + estimated_cost(npos);
-
-    vector<coord_def> &vec = hash[old_total];
-    for (unsigned int i = 0; i < vec.size(); i++)
-    {
-        if (vec[i] == npos)
-        {
-            vec.erase(vec.begin() + i);
-            break;
-        }
-    }
+    // Unlink the grid from the bucket of its old distance, if it's still
+    // waiting there, then call add_new_pos.
+    if (state->find(npos)->queued)
+        state->remove(get_dist(npos) + estimated_cost(npos), npos);
 
     add_new_pos(npos, total);
 }
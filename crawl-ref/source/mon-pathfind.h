@@ -2,12 +2,12 @@
 
 #include "coord-def.h"
 #include "defines.h"
-#include "fixedvector.h"
 #include <vector>
 
 using std::vector;
 
 class monster;
+struct pathfind_state;
 
 int mons_tracking_range(const monster* mon);
 
@@ -17,6 +17,9 @@ public:
     monster_pathfind();
     virtual ~monster_pathfind();
 
+    monster_pathfind(const monster_pathfind&) = delete;
+    monster_pathfind& operator=(const monster_pathfind&) = delete;
+
     // public methods
     void set_range(int r);
     coord_def next_pos(const coord_def &p) const;
@@ -37,6 +40,8 @@ protected:
     bool mons_traversable(const coord_def& p);
     int  mons_travel_cost(coord_def npos);
     int  estimated_cost(coord_def npos);
+    int  get_dist(const coord_def& p) const;
+    void set_dist(const coord_def& p, int d, int dir);
     void add_new_pos(coord_def pos, int total);
     void update_pos(coord_def pos, int total);
     bool get_best_position();
@@ -66,10 +71,8 @@ protected:
     int min_length;
     int max_length;
 
-    // The array of distances from start to any already tried point.
-    int dist[GXM][GYM];
-    // An array to store where we came from on a given shortest path.
-    int prev[GXM][GYM];
-
-    FixedVector<vector<coord_def>, GXM * GYM> hash;
+    // Distances, backtracking information and the queue of open grids,
+    // borrowed from a pool so that searches don't allocate or clear
+    // whole-map arrays.
+    pathfind_state *state;
 };
@@ -8,6 +8,8 @@
 #include "mon-pick.h"
 #include "mon-pick-data.h"
 
+#include <chrono>
+
 #include "branch.h"
 #include "coord.h"
 #include "env.h"
@@ -107,6 +109,11 @@ bool positioned_monster_picker::veto(monster_type mon)
     return monster_picker::veto(mon);
 }
 
+bool positioned_monster_picker::can_veto()
+{
+    return in_bounds(pos) || posveto || monster_picker::can_veto();
+}
+
 monster_type pick_monster_all_branches(int absdepth0, mon_pick_vetoer veto)
 {
     monster_picker picker = monster_picker();
@@ -131,20 +138,17 @@ monster_type pick_monster_all_branches(int absdepth0, monster_picker &picker,
         if (depth < 1 || depth > branch_ood_cap(it->id))
             continue;
 
-        for (const pop_entry *pop = population[it->id].pop; pop->value; pop++)
+        const random_pick_table<monster_type> &table =
+            picker.table_at(population[it->id].pop, depth);
+        for (size_t i = 0; i < table.values.size(); i++)
         {
-            if (depth < pop->minr || depth > pop->maxr)
+            const monster_type mons = table.values[i];
+            if (veto ? (*veto)(mons) : picker.veto(mons))
                 continue;
 
-            if (veto ? (*veto)(pop->value) : picker.veto(pop->value))
-                continue;
-
-            int rar = picker.rarity_at(pop, depth);
-            ASSERT(rar > 0);
-
-            monster_type mons = pop->value;
+            const int rar = table.rarities[i];
             if (!rarities[mons])
-                valid[nvalid++] = pop->value;
+                valid[nvalid++] = mons;
             if (rarities[mons] < rar)
                 rarities[mons] = rar;
         }
@@ -236,10 +240,112 @@ static bool _not_skeletonable(monster_type mt)
     return !mons_skeleton(mt);
 }
 
+// A picker that always vetoes, to exercise the slow path of pick().
+class skeleton_picker : public monster_picker
+{
+public:
+    virtual bool veto(monster_type mon) override
+    {
+        return _not_skeletonable(mon);
+    }
+    virtual bool can_veto() override { return true; }
+};
+
+// The pick that random_picker::pick() made before it kept tables, walking
+// the weights from scratch, to check the tables against.
+static monster_type _reference_pick(monster_picker &picker,
+                                    const pop_entry *weights, int level)
+{
+    monster_type valid[NUM_MONSTERS];
+    int rarities[NUM_MONSTERS];
+    int nvalid = 0;
+    int totalrar = 0;
+
+    for (const pop_entry *pop = weights; pop->rarity; pop++)
+    {
+        if (level < pop->minr || level > pop->maxr)
+            continue;
+
+        if (picker.veto(pop->value))
+            continue;
+
+        valid[nvalid] = pop->value;
+        rarities[nvalid] = picker.rarity_at(pop, level);
+        totalrar += rarities[nvalid];
+        nvalid++;
+    }
+
+    if (!nvalid)
+        return MONS_0;
+
+    totalrar = random2(totalrar);
+
+    for (int i = 0; i < nvalid; i++)
+        if ((totalrar -= rarities[i]) < 0)
+            return valid[i];
+
+    die("mon-pick roll out of range");
+}
+
+// Every population table of a branch, with a name for reporting.
+static vector<pair<const pop_entry *, const char *> >
+_branch_populations(branch_type br)
+{
+    return { { population[br].pop, "population" },
+             { population_water[br].pop, "water" },
+             { population_lava[br].pop, "lava" },
+             { population_zombie[br].pop, "zombie" } };
+}
+
+// Pick from the table and the reference with the same seed, and check that
+// they agree on the monster and leave the RNG in the same state.
+static bool _monpick_agrees(monster_picker &picker, const pop_entry *weights,
+                            int level, uint64_t seed)
+{
+    monster_type picked, expected;
+    uint32_t after, expected_after;
+    {
+        rng::subgenerator subgen(seed);
+        picked = picker.pick(weights, level, MONS_0);
+        after = rng::get_uint32();
+    }
+    {
+        rng::subgenerator subgen(seed);
+        expected = _reference_pick(picker, weights, level);
+        expected_after = rng::get_uint32();
+    }
+    return picked == expected && after == expected_after;
+}
+
 void debug_monpick()
 {
     string fails;
 
+    for (branch_iterator it; it; ++it)
+    {
+        const branch_type br = it->id;
+        for (const auto &pop : _branch_populations(br))
+        {
+            for (int d = 1; d <= branch_ood_cap(br); d++)
+            {
+                monster_picker picker;
+                skeleton_picker vetoing;
+                for (uint64_t seed = 1; seed <= 20; seed++)
+                {
+                    if (!_monpick_agrees(picker, pop.first, d, seed)
+                        || !_monpick_agrees(vetoing, pop.first, d, seed))
+                    {
+                        fails += make_stringf(
+                            "%s: %s pick differs from reference with "
+                            "seed %d\n", level_id(br, d).describe().c_str(),
+                            pop.second, (int) seed);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
     for (branch_iterator it; it; ++it)
     {
         branch_type br = it->id;
@@ -259,4 +365,52 @@ void debug_monpick()
 
     dump_test_fails(fails, "mon-pick");
 }
+
+/**
+ * Time picking monsters from every branch's populations at every depth,
+ * with and without a veto, through the pick tables and through the
+ * reference pick they replaced, using the same seeds for both.
+ *
+ * @param rounds How many times to pick at each depth.
+ */
+monpick_bench_result debug_monpick_bench(int rounds)
+{
+    monpick_bench_result result;
+    for (int reference = 0; reference < 2; reference++)
+    {
+        const auto start = chrono::steady_clock::now();
+        int picks = 0;
+        for (branch_iterator it; it; ++it)
+        {
+            const branch_type br = it->id;
+            for (const auto &pop : _branch_populations(br))
+            {
+                for (int d = 1; d <= branch_ood_cap(br); d++)
+                {
+                    monster_picker plain;
+                    skeleton_picker vetoing;
+                    monster_picker *pickers[] = { &plain, &vetoing };
+                    rng::subgenerator subgen(d);
+                    for (int i = 0; i < rounds; i++)
+                    {
+                        for (monster_picker *p : pickers)
+                        {
+                            if (reference)
+                                _reference_pick(*p, pop.first, d);
+                            else
+                                p->pick(pop.first, d, MONS_0);
+                            picks++;
+                        }
+                    }
+                }
+            }
+        }
+
+        const double ms = chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - start).count() / 1000.0;
+        (reference ? result.reference_ms : result.table_ms) = ms;
+        result.picks = picks;
+    }
+    return result;
+}
 #endif
@@ -31,6 +31,14 @@ const pop_entry* zombie_population(branch_type br);
 
 void debug_monpick();
 
+struct monpick_bench_result
+{
+    int picks = 0;
+    double table_ms = 0;
+    double reference_ms = 0;
+};
+monpick_bench_result debug_monpick_bench(int rounds);
+
 // Subclass the random_picker template to make a monster_picker class.
 // The main reason for this is that passing delegates into template functions
 // is fraught with peril when the delegate's arguments use T, until 0x at least.
@@ -45,6 +53,7 @@ public:
                                 mon_pick_vetoer vetoer = nullptr);
 
     virtual bool veto(monster_type mon) override;
+    virtual bool can_veto() override { return _veto != nullptr; }
 
 private:
     mon_pick_vetoer _veto;
@@ -58,6 +67,7 @@ public:
         : monster_picker(), pos(_pos), posveto(_posveto) { };
 
     virtual bool veto(monster_type mon) override;
+    virtual bool can_veto() override;
 
 protected:
     const coord_def &pos;
@@ -75,6 +85,7 @@ public:
           { };
 
     virtual bool veto(monster_type mon) override;
+    virtual bool can_veto() override { return true; }
 
 private:
     monster_type zombie_kind;
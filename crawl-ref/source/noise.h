@@ -110,10 +110,15 @@ public:
     // propagate until propagate_noise() is called.
     void register_noise(const noise_t &noise);
 
+    // Move the noises registered on other onto this grid, leaving other
+    // empty. This grid must be empty.
+    void take_noises(noise_grid &other);
+
     // Propagate noise from the noise sources registered.
     void propagate_noise();
 
-    // Clear all noise from the noise grid.
+    // Clear all noise from the noise grid. Only the cells noise has
+    // reached since the last reset are cleared.
     void reset();
 
     bool dirty() const { return !noises.empty(); }
@@ -125,6 +130,7 @@ public:
 #endif
 
 private:
+    void touch_cell(const coord_def &pos);
     bool propagate_noise_to_neighbour(int base_attenuation,
                                       int travel_distance,
                                       const noise_cell &cell,
@@ -142,4 +148,12 @@ private:
     FixedArray<noise_cell, GXM, GYM> cells;
     vector<noise_t> noises;
     int affected_actor_count;
+
+    // Bounding box of the cells changed since the last reset; empty if
+    // touched_min.x > touched_max.x.
+    coord_def touched_min, touched_max;
+
+    // Current and next perimeter of the propagating noise, kept between
+    // calls so that their storage is reused.
+    vector<coord_def> noise_perimeter[2];
 };
@@ -156,6 +156,10 @@ public:
     string      basefilename; // Base (pathless) file name
     int         line_num;     // Current line number being processed.
 
+    // Changes whenever the options are reset or an option line is read, so
+    // that anything compiled from the options knows to rebuild itself.
+    unsigned int generation;
+
     // View options
     map<dungeon_feature_type, feature_def> feature_colour_overrides;
     map<dungeon_feature_type, FixedVector<char32_t, 2> > feature_symbol_overrides;
@@ -278,6 +282,9 @@ public:
                                   // creating macros
     int         autofight_warning;      // Amount of real time required between
                                         // two autofight commands
+    int         lua_gc_pause;     // Lua collector pause (0 = default)
+    int         lua_gc_stepmul;   // Lua collector step multiplier
+    int         abyss_sample_threads; // Threads to generate Abyss terrain on
     bool        cloud_status;     // Whether to show a cloud status light
     bool        always_show_zot;  // Whether to always show the Zot timer
 
@@ -332,6 +339,8 @@ public:
     bool        arena_dump_msgs;
     bool        arena_dump_msgs_all;
     bool        arena_list_eq;
+    bool        arena_dump_trials;
+    string      arena_result_file;
 
     vector<message_filter> force_more_message;
     vector<message_filter> flash_screen_message;
@@ -487,6 +496,7 @@ public:
     string      fsim_mode;
     bool        fsim_csv;
     int         fsim_rounds;
+    int         fsim_jobs;
     string      fsim_mons;
     vector<string> fsim_scale;
     vector<string> fsim_kit;
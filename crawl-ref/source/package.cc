@@ -22,6 +22,7 @@ Notes:
 
 #include "package.h"
 
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -38,6 +39,7 @@ Notes:
 #include "errors.h"
 #include "syscalls.h"
 #include "libutil.h" // map_find
+#include "threads.h"
 
 // debugging defines
 #undef  FSCK_VERBOSE
@@ -76,6 +78,95 @@ struct block_header
     plen_t next;
 };
 
+#ifdef USE_ZLIB
+#define ZB_SIZE 32768
+
+// A chunk being compressed by a background thread.
+struct background_chunk
+{
+    string name;
+    vector<Bytef> data;
+    // The compressed output, and the sizes of the pieces chunk_writer
+    // would have written it in, so the blocks come out the same.
+    vector<Bytef> out;
+    vector<plen_t> pieces;
+    string error;
+    // How long the compression itself took.
+    int ms;
+    bool threaded;
+    thread_t thread;
+};
+
+static void _deflate_background_chunk(background_chunk &bc)
+{
+    vector<Bytef> buffer(ZB_SIZE);
+
+    z_stream zs;
+    zs.data_type = Z_BINARY;
+    zs.zalloc    = 0;
+    zs.zfree     = 0;
+    zs.opaque    = Z_NULL;
+    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION))
+    {
+        bc.error = zs.msg ? zs.msg : "init";
+        return;
+    }
+    zs.next_out  = buffer.data();
+    zs.avail_out = ZB_SIZE;
+    zs.next_in   = bc.data.data();
+    zs.avail_in  = bc.data.size();
+
+    auto flush_buffer = [&]()
+    {
+        bc.out.insert(bc.out.end(), buffer.data(), zs.next_out);
+        bc.pieces.push_back(zs.next_out - buffer.data());
+        zs.next_out  = buffer.data();
+        zs.avail_out = ZB_SIZE;
+    };
+
+    // As chunk_writer::write()...
+    while (zs.avail_in)
+    {
+        if (!zs.avail_out)
+            flush_buffer();
+        if (deflate(&zs, Z_NO_FLUSH) != Z_OK)
+        {
+            bc.error = zs.msg ? zs.msg : "deflate";
+            deflateEnd(&zs);
+            return;
+        }
+    }
+
+    // ... and ~chunk_writer().
+    int res;
+    do
+    {
+        res = deflate(&zs, Z_FINISH);
+        if (res != Z_STREAM_END && res != Z_OK && res != Z_BUF_ERROR)
+        {
+            bc.error = zs.msg ? zs.msg : "deflate";
+            deflateEnd(&zs);
+            return;
+        }
+        flush_buffer();
+    } while (res != Z_STREAM_END);
+    if (deflateEnd(&zs) != Z_OK)
+        bc.error = zs.msg ? zs.msg : "clean-up";
+
+    bc.data.clear();
+}
+
+static void *_compress_background_chunk(void *arg)
+{
+    background_chunk &bc = *static_cast<background_chunk *>(arg);
+    const auto start = chrono::steady_clock::now();
+    _deflate_background_chunk(bc);
+    bc.ms = chrono::duration_cast<chrono::milliseconds>(
+                chrono::steady_clock::now() - start).count();
+    return nullptr;
+}
+#endif
+
 typedef map<string, plen_t> directory_t;
 typedef pair<plen_t, plen_t> bm_p;
 typedef map<plen_t, bm_p> bm_t;
@@ -86,6 +177,7 @@ package::package(const char* file, bool writeable, bool empty)
 #ifdef DO_FSYNC
     , tmp(false)
 #endif
+    , background(false), pending(nullptr)
 {
     dprintf("package: initializing file=\"%s\" rw=%d\n", file, writeable);
     ASSERT(writeable || !empty);
@@ -136,6 +228,7 @@ package::package()
 #ifdef DO_FSYNC
     , tmp(true)
 #endif
+    , background(false), pending(nullptr)
 {
     dprintf("package: initializing tmp file\n");
     filename = "[tmp]";
@@ -208,6 +301,7 @@ void package::load_traces()
 package::~package()
 {
     dprintf("package: finalizing\n");
+    finish_background();
     ASSERT(!n_users || CrawlIsCrashing); // not merely aborted, there are
         // live pointers to us. With normal stack unwinding, destructors
         // will make sure this never happens and this assert is good for
@@ -233,6 +327,7 @@ package::~package()
 
 void package::commit()
 {
+    finish_background();
     ASSERT(rw);
     if (!dirty)
         return;
@@ -286,6 +381,7 @@ chunk_writer* package::writer(const string &name)
 
 chunk_reader* package::reader(const string &name)
 {
+    finish_background(name);
     if (plen_t *ch = map_find(directory, name))
         return new chunk_reader(this, *ch);
     return 0;
@@ -384,6 +480,7 @@ void package::free_chunk(const string &name)
 
 void package::delete_chunk(const string &name)
 {
+    finish_background(name);
     free_chunk(name);
     directory.erase(name);
 }
@@ -564,16 +661,26 @@ void package::read_directory(plen_t start, uint8_t version)
 
 bool package::has_chunk(const string &name)
 {
-    return !name.empty() && directory.count(name);
+    if (name.empty())
+        return false;
+    // A chunk still being compressed exists already, as far as the caller
+    // is concerned; don't wait for it.
+    if (compressing(name))
+        return true;
+    return directory.count(name);
 }
 
 vector<string> package::list_chunks()
 {
     vector<string> list;
-    list.reserve(directory.size());
+    list.reserve(directory.size() + 1);
     for (const auto &entry : directory)
         if (!entry.first.empty())
             list.push_back(entry.first);
+#ifdef USE_ZLIB
+    if (pending && !directory.count(pending->name))
+        list.push_back(pending->name);
+#endif
 
     return list;
 }
@@ -620,6 +727,83 @@ void package::abort()
     // this point are ignored (assuming we already failed). All writes since
     // the last commit() are lost.
     aborted = true;
+    finish_background();
+}
+
+void package::set_background_compression(bool on)
+{
+    if (!on)
+        finish_background();
+    else if (!background)
+        bg_stats = background_stats();
+    background = on;
+}
+
+#ifdef USE_ZLIB
+void package::start_background(const string &name, vector<Bytef> &data)
+{
+    finish_background();
+
+    pending = new background_chunk;
+    pending->name = name;
+    pending->data.swap(data);
+    pending->ms = 0;
+    pending->threaded = !thread_create_joinable(&pending->thread,
+                                                _compress_background_chunk,
+                                                pending);
+    // Couldn't start a thread, so do it here.
+    if (!pending->threaded)
+    {
+        _compress_background_chunk(pending);
+        bg_stats.wait_ms += pending->ms;
+    }
+}
+#endif
+
+// Store the chunk compressed in the background, if any. Only accesses to
+// that chunk itself, new allocations (the next background chunk, commit())
+// and teardown need to wait for it; anything else can go on meanwhile.
+void package::finish_background()
+{
+#ifdef USE_ZLIB
+    if (!pending)
+        return;
+
+    unique_ptr<background_chunk> bc(pending);
+    pending = nullptr;
+    if (bc->threaded)
+    {
+        const auto start = chrono::steady_clock::now();
+        thread_join(bc->thread);
+        bg_stats.wait_ms += chrono::duration_cast<chrono::milliseconds>(
+                                chrono::steady_clock::now() - start).count();
+    }
+    bg_stats.chunks++;
+    bg_stats.compress_ms += bc->ms;
+    if (aborted)
+        return;
+    if (!bc->error.empty())
+        fail("save file compression failed: %s", bc->error.c_str());
+
+    chunk_writer cw(this, bc->name, *bc);
+#endif
+}
+
+// As above, but only if the chunk being compressed is the given one.
+void package::finish_background(const string &name)
+{
+    if (compressing(name))
+        finish_background();
+}
+
+bool package::compressing(const string &name) const
+{
+#ifdef USE_ZLIB
+    return pending && pending->name == name;
+#else
+    UNUSED(name);
+    return false;
+#endif
 }
 
 void package::unlink()
@@ -633,6 +817,7 @@ void package::unlink()
 // the amount of free space not at the end of file
 plen_t package::get_slack()
 {
+    finish_background();
     load_traces();
 
     plen_t slack = 0;
@@ -643,6 +828,7 @@ plen_t package::get_slack()
 
 plen_t package::get_chunk_fragmentation(const string &name)
 {
+    finish_background();
     load_traces();
     ASSERT(directory.count(name)); // not has_chunk(), "" is valid
     plen_t frags = 0;
@@ -659,6 +845,7 @@ plen_t package::get_chunk_fragmentation(const string &name)
 
 plen_t package::get_chunk_compressed_length(const string &name)
 {
+    finish_background();
     load_traces();
     ASSERT(directory.count(name)); // not has_chunk(), "" is valid
     plen_t len = 0;
@@ -689,49 +876,91 @@ chunk_writer::chunk_writer(package *parent, const string &_name)
     name = _name;
 
 #ifdef USE_ZLIB
+    background = pkg->background;
+    precompressed = false;
+    z_buffer = nullptr;
+    // A background writer only collects data, and its chunk is stored after
+    // any pending one. A direct one must not be overwritten by an older
+    // version of its chunk still being compressed.
+    if (background)
+        return;
+    pkg->finish_background(name);
+
     zs.data_type = Z_BINARY;
     zs.zalloc    = 0;
     zs.zfree     = 0;
     zs.opaque    = Z_NULL;
     if (deflateInit(&zs, Z_DEFAULT_COMPRESSION))
         fail("save file compression failed during init: %s", zs.msg);
-#define ZB_SIZE 32768
     zs.next_out  = z_buffer = (Bytef*)malloc(ZB_SIZE);
     zs.avail_out = ZB_SIZE;
 #endif
 }
 
+#ifdef USE_ZLIB
+// Store a chunk compressed by a background thread.
+chunk_writer::chunk_writer(package *parent, const string &_name,
+                           const background_chunk &compressed)
+    : pkg(parent), name(_name), first_block(0), cur_block(0), block_len(0),
+      z_buffer(nullptr), background(false), precompressed(true)
+{
+    dprintf("chunk_writer(%s): storing\n", _name.c_str());
+    pkg->n_users++;
+
+    const Bytef *data = compressed.out.data();
+    for (plen_t len : compressed.pieces)
+    {
+        raw_write(data, len);
+        data += len;
+    }
+}
+#endif
+
 chunk_writer::~chunk_writer()
 {
     dprintf("chunk_writer(%s): closing\n", name.c_str());
 
     ASSERT(pkg->n_users > 0);
     pkg->n_users--;
+#ifdef USE_ZLIB
+    if (background)
+    {
+        if (!pkg->aborted)
+            pkg->start_background(name, background_data);
+        return;
+    }
+#endif
     if (pkg->aborted)
     {
 #ifdef USE_ZLIB
-        // ignore errors, they're not relevant anymore
-        deflateEnd(&zs);
-        free(z_buffer);
+        if (!precompressed)
+        {
+            // ignore errors, they're not relevant anymore
+            deflateEnd(&zs);
+            free(z_buffer);
+        }
 #endif
         return;
     }
 
 #ifdef USE_ZLIB
-    zs.avail_in = 0;
-    int res;
-    do
+    if (!precompressed)
     {
-        res = deflate(&zs, Z_FINISH);
-        if (res != Z_STREAM_END && res != Z_OK && res != Z_BUF_ERROR)
-            fail("save file compression failed: %s", zs.msg);
-        raw_write(z_buffer, zs.next_out - z_buffer);
-        zs.next_out = z_buffer;
-        zs.avail_out = ZB_SIZE;
-    } while (res != Z_STREAM_END);
-    if (deflateEnd(&zs) != Z_OK)
-        fail("save file compression failed during clean-up: %s", zs.msg);
-    free(z_buffer);
+        zs.avail_in = 0;
+        int res;
+        do
+        {
+            res = deflate(&zs, Z_FINISH);
+            if (res != Z_STREAM_END && res != Z_OK && res != Z_BUF_ERROR)
+                fail("save file compression failed: %s", zs.msg);
+            raw_write(z_buffer, zs.next_out - z_buffer);
+            zs.next_out = z_buffer;
+            zs.avail_out = ZB_SIZE;
+        } while (res != Z_STREAM_END);
+        if (deflateEnd(&zs) != Z_OK)
+            fail("save file compression failed during clean-up: %s", zs.msg);
+        free(z_buffer);
+    }
 #endif
     if (cur_block)
         finish_block(0);
@@ -783,6 +1012,13 @@ void chunk_writer::write(const void *data, plen_t len)
     ASSERT(!pkg->aborted);
 
 #ifdef USE_ZLIB
+    if (background)
+    {
+        const Bytef *bytes = static_cast<const Bytef *>(data);
+        background_data.insert(background_data.end(), bytes, bytes + len);
+        return;
+    }
+
     zs.next_in  = (Bytef*)data;
     zs.avail_in = len;
     while (zs.avail_in)
@@ -840,6 +1076,7 @@ chunk_reader::chunk_reader(package *parent, const string &_name)
         corrupted("save file corrupted -- chunk \"%s\" missing", _name.c_str());
     dprintf("chunk_reader(%s): starting\n", _name.c_str());
     pkg = parent;
+    pkg->finish_background(_name);
     init(parent->directory[_name]);
 }
 
@@ -25,6 +25,16 @@ using std::vector;
 typedef uint32_t plen_t;
 
 class package;
+struct background_chunk;
+
+// Time spent compressing chunks in the background, and how much of it the
+// main thread spent waiting for the result rather than doing other work.
+struct background_stats
+{
+    int chunks = 0;
+    int compress_ms = 0;
+    int wait_ms = 0;
+};
 
 class chunk_writer
 {
@@ -37,6 +47,13 @@ private:
 #ifdef USE_ZLIB
     z_stream zs;
     Bytef *z_buffer;
+    // Set if the data is to be compressed on a background thread (and is
+    // collected in background_data meanwhile), or is already compressed.
+    bool background;
+    bool precompressed;
+    vector<Bytef> background_data;
+    chunk_writer(package *parent, const string &_name,
+                 const background_chunk &compressed);
 #endif
     void raw_write(const void *data, plen_t len);
     void finish_block(plen_t next);
@@ -84,6 +101,12 @@ public:
     void abort();
     void unlink();
 
+    // While set, chunks are compressed on a background thread once their
+    // writer is closed, and stored in order before the next access.
+    void set_background_compression(bool on);
+    // Since background compression was last turned on.
+    const background_stats &get_background_stats() const { return bg_stats; }
+
     // statistics
     plen_t get_slack();
     plen_t get_size() const { return file_len; };
@@ -100,6 +123,9 @@ private:
 #ifdef DO_FSYNC
     bool tmp;
 #endif
+    bool background;
+    background_chunk *pending;
+    background_stats bg_stats;
     map<string, plen_t> directory;
     map<plen_t, plen_t> free_blocks;
     vector<plen_t> unlinked_blocks;
@@ -120,6 +146,12 @@ private:
     void trace_chunk(plen_t start);
     void load();
     void load_traces();
+#ifdef USE_ZLIB
+    void start_background(const string &name, vector<Bytef> &data);
+#endif
+    void finish_background();
+    void finish_background(const string &name);
+    bool compressing(const string &name) const;
     friend class chunk_writer;
     friend class chunk_reader;
 };
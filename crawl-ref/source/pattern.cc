@@ -229,3 +229,285 @@ pattern_match plaintext_pattern::match_location(const string &s) const
     else
         return pattern_match::failed(s);
 }
+
+////////////////////////////////////////////////////////////////////
+// pattern_list_matcher
+
+// Characters with a special meaning somewhere in a regex.
+static const char *_regex_metachars = "\\^$.|?*+()[]{}";
+
+// Escapes that match without consuming text, or a single character from a
+// class, and take no arguments.
+static const char *_simple_escapes = "dDwWsSbBAzZG";
+
+// The longest run of plain text that every string matching the given
+// regex must contain, or "" if we can't be sure of any. Sets whole if the
+// regex is nothing but plain text.
+static string _required_literal(const string &pattern, bool &whole)
+{
+    whole = pattern.find_first_of(_regex_metachars) == string::npos;
+    if (whole)
+        return pattern;
+
+    // Alternation or a group can make any part of the pattern optional.
+    if (pattern.find_first_of("|(") != string::npos)
+        return "";
+
+    string best, run;
+    // Whether the last atom was a literal character at the end of run.
+    bool last_literal = false;
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        const char c = pattern[i];
+        if (c == '?' || c == '*' || c == '{')
+        {
+            // The previous atom may be absent.
+            if (last_literal)
+                run.pop_back();
+            if (c == '{')
+            {
+                i = pattern.find('}', i);
+                if (i == string::npos)
+                    return "";
+            }
+        }
+        else if (c == '+')
+        {
+            // The previous atom is present, but may repeat; unless another
+            // quantifier follows, which might make it optional after all.
+            if (last_literal && i + 1 < pattern.size()
+                && strchr("?*{", pattern[i + 1]))
+            {
+                run.pop_back();
+            }
+        }
+        else if (c == '\\')
+        {
+#ifndef REGEX_PCRE
+            // POSIX escapes (\<, \` and so on) vary between libraries.
+            return "";
+#else
+            if (i + 1 == pattern.size())
+                return "";
+            const char e = pattern[++i];
+            if (!isaalnum(e))
+            {
+                run += e;
+                last_literal = true;
+                continue;
+            }
+            if (!strchr(_simple_escapes, e))
+                return "";
+#endif
+        }
+        else if (c == '[')
+        {
+            size_t j = i + 1;
+            if (j < pattern.size() && pattern[j] == '^')
+                ++j;
+            if (j < pattern.size() && pattern[j] == ']')
+                ++j;
+            for (; j < pattern.size() && pattern[j] != ']'; ++j)
+            {
+                // Escapes and named classes inside brackets differ between
+                // regex flavours; don't try to parse them.
+                if (pattern[j] == '\\' || pattern[j] == '[')
+                    return "";
+            }
+            if (j == pattern.size())
+                return "";
+            i = j;
+        }
+        else if (c != '^' && c != '$' && c != '.')
+        {
+            run += c;
+            last_literal = true;
+            continue;
+        }
+
+        // Anything but a literal character ends the run.
+        if (run.size() > best.size())
+            best = run;
+        run.clear();
+        last_literal = false;
+    }
+    if (run.size() > best.size())
+        best = run;
+    return best;
+}
+
+static string _ascii_lowercase(const string &s)
+{
+    string res(s);
+    for (char &c : res)
+        c = toalower(c);
+    return res;
+}
+
+void pattern_list_matcher::literal_automaton::clear()
+{
+    literals.clear();
+    nodes.clear();
+    built = false;
+}
+
+void pattern_list_matcher::literal_automaton::add(const string &literal,
+                                                  int id)
+{
+    literals.emplace_back(literal, id);
+    built = false;
+}
+
+int pattern_list_matcher::literal_automaton::child(int n,
+                                                   unsigned char c) const
+{
+    for (const auto &edge : nodes[n].edges)
+        if (edge.first == c)
+            return edge.second;
+    return -1;
+}
+
+void pattern_list_matcher::literal_automaton::build()
+{
+    nodes.assign(1, node());
+    nodes[0].fail = 0;
+
+    for (const auto &lit : literals)
+    {
+        int n = 0;
+        for (const char ch : lit.first)
+        {
+            const unsigned char c = ch;
+            int next = child(n, c);
+            if (next < 0)
+            {
+                next = nodes.size();
+                nodes.emplace_back();
+                nodes.back().fail = 0;
+                nodes[n].edges.emplace_back(c, next);
+            }
+            n = next;
+        }
+        nodes[n].ids.push_back(lit.second);
+    }
+
+    // Breadth first, so that each node's failure link is complete before
+    // its children need it.
+    vector<int> queue(1, 0);
+    for (size_t qi = 0; qi < queue.size(); ++qi)
+    {
+        const int n = queue[qi];
+        for (const auto &edge : nodes[n].edges)
+        {
+            const int next = edge.second;
+            int fail = 0;
+            if (n)
+            {
+                int f = nodes[n].fail;
+                while (f && child(f, edge.first) < 0)
+                    f = nodes[f].fail;
+                fail = max(child(f, edge.first), 0);
+            }
+            nodes[next].fail = fail;
+            const vector<int> &inherited = nodes[fail].ids;
+            nodes[next].ids.insert(nodes[next].ids.end(),
+                                   inherited.begin(), inherited.end());
+            queue.push_back(next);
+        }
+    }
+    built = true;
+}
+
+void pattern_list_matcher::literal_automaton::find_all(const string &s,
+                                                       bool icase,
+                                                       vector<bool> &found)
+{
+    if (literals.empty())
+        return;
+    if (!built)
+        build();
+
+    int n = 0;
+    for (const char ch : s)
+    {
+        const unsigned char c = icase ? toalower(ch) : ch;
+        int next;
+        while ((next = child(n, c)) < 0 && n)
+            n = nodes[n].fail;
+        n = max(next, 0);
+        for (const int id : nodes[n].ids)
+            found[id] = true;
+    }
+}
+
+void pattern_list_matcher::clear()
+{
+    for (literal_automaton &automaton : automata)
+        automaton.clear();
+    entries.clear();
+    num_literals = 0;
+}
+
+void pattern_list_matcher::add(const text_pattern &pattern, bool match_empty)
+{
+    entry e = { pattern, -1, false, match_empty && pattern.empty() };
+    if (!pattern.empty())
+    {
+        bool whole = false;
+        string literal = _required_literal(pattern.tostring(), whole);
+#ifndef REGEX_PCRE
+        // Case-insensitive POSIX matching folds case by locale, which
+        // plain ASCII lowercasing can't reproduce.
+        if (pattern.icase())
+            literal.clear();
+#endif
+        if (!literal.empty())
+        {
+            e.literal = num_literals++;
+            e.literal_only = whole;
+            if (pattern.icase())
+                automata[UNCASED].add(_ascii_lowercase(literal), e.literal);
+            else
+                automata[CASED].add(literal, e.literal);
+        }
+    }
+    entries.push_back(e);
+}
+
+bool pattern_list_matcher::entry_matches(const entry &e, const string &s,
+                                         const vector<bool> &found) const
+{
+    if (e.always)
+        return true;
+    if (e.literal >= 0 && !found[e.literal])
+        return false;
+    return e.literal_only || e.pattern.matches(s);
+}
+
+int pattern_list_matcher::first_match(const string &s) const
+{
+    vector<bool> found(num_literals, false);
+    automata[CASED].find_all(s, false, found);
+    automata[UNCASED].find_all(s, true, found);
+
+    for (size_t i = 0; i < entries.size(); ++i)
+        if (entry_matches(entries[i], s, found))
+            return i;
+    return -1;
+}
+
+int pattern_list_matcher::first_match(const string &s,
+                                      const vector<int> &candidates) const
+{
+    if (candidates.empty())
+        return -1;
+
+    vector<bool> found(num_literals, false);
+    automata[CASED].find_all(s, false, found);
+    automata[UNCASED].find_all(s, true, found);
+
+    for (const int i : candidates)
+        if (entry_matches(entries[i], s, found))
+            return i;
+    return -1;
+}
@@ -116,6 +116,8 @@ public:
         return pattern;
     }
 
+    bool icase() const { return ignore_case; }
+
 private:
     string pattern;
     mutable void *compiled_pattern;
@@ -154,3 +156,74 @@ private:
     string pattern;
     bool ignore_case;
 };
+
+// A list of text_patterns compiled for finding the first one that matches a
+// string. Patterns that are plain text, and the plain text that each of the
+// other patterns requires, are all searched for in a single pass over the
+// string; a regex is only run if its required text is present.
+class pattern_list_matcher
+{
+public:
+    pattern_list_matcher() : automata(), entries(), num_literals(0) { }
+
+    void clear();
+
+    // Add a pattern with the next index. If match_empty is set, an empty
+    // pattern matches every string, as in message_filter; otherwise it
+    // matches nothing, as in text_pattern.
+    void add(const text_pattern &pattern, bool match_empty = false);
+
+    size_t size() const { return entries.size(); }
+
+    // The index of the first pattern that matches s, or -1 if none do.
+    int first_match(const string &s) const;
+
+    // The first of the given pattern indices (in ascending order) whose
+    // pattern matches s, or -1 if none do.
+    int first_match(const string &s, const vector<int> &candidates) const;
+
+private:
+    // Aho-Corasick automaton over the literals of one case sensitivity,
+    // built on first use after literals are added.
+    class literal_automaton
+    {
+    public:
+        literal_automaton() : literals(), nodes(), built(false) { }
+
+        bool empty() const { return literals.empty(); }
+        void clear();
+        void add(const string &literal, int id);
+        void find_all(const string &s, bool icase, vector<bool> &found);
+
+    private:
+        struct node
+        {
+            vector<pair<unsigned char, int>> edges;
+            int fail;
+            vector<int> ids;
+        };
+
+        void build();
+        int child(int n, unsigned char c) const;
+
+        vector<pair<string, int>> literals;
+        vector<node> nodes;
+        bool built;
+    };
+
+    struct entry
+    {
+        text_pattern pattern;
+        int literal;       // Index of the literal it requires, or -1.
+        bool literal_only; // The pattern is nothing but that literal.
+        bool always;       // An empty pattern that matches everything.
+    };
+
+    bool entry_matches(const entry &e, const string &s,
+                       const vector<bool> &found) const;
+
+    enum { CASED, UNCASED, NUM_AUTOMATA };
+    mutable literal_automaton automata[NUM_AUTOMATA];
+    vector<entry> entries;
+    int num_literals;
+};
@@ -447,4 +447,50 @@ namespace perlin
         }
         return value / norm;
     }
+
+    // Every octave after the first rotates the point so that it depends only
+    // on the original y, so points sharing a y (a row of cells) share all
+    // but the first octave. This keeps fBM()'s order of operations, so the
+    // results are identical.
+    void fBM_many(const double *x, const double *y, double z,
+                  uint32_t octaves, size_t count, double *out)
+    {
+        if (octaves <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = fBM(x[i], y[i], z, octaves);
+            return;
+        }
+
+        vector<double> tail(octaves);
+        double norm = 0.0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i == 0 || y[i] != y[i - 1])
+            {
+                uint32_t divisor = 2;
+                norm = 1;
+                double xi = y[i] * sin(1.41421356) + cos(1.41421356);
+                double yi = y[i] * cos(1.41421356) + sin(1.41421356);
+                double zi = z + 1.7;
+                for (uint32_t octave = 1; octave < octaves; ++octave)
+                {
+                    tail[octave] = noise(xi / divisor, yi / divisor,
+                                         zi / divisor) / divisor;
+                    norm += 1 / divisor;
+                    divisor *= 2;
+                    double xt = yi * sin(1.41421356) + cos(1.41421356);
+                    yi = yi * cos(1.41421356) + sin(1.41421356);
+                    xi = xt;
+                    zi += 1.7;
+                }
+            }
+
+            double value = 0;
+            value += noise(x[i], y[i], z);
+            for (uint32_t octave = 1; octave < octaves; ++octave)
+                value += tail[octave];
+            out[i] = value / norm;
+        }
+    }
 }
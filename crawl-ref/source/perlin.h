@@ -6,4 +6,7 @@ namespace perlin
     double noise(double xin, double yin, double zin) IMMUTABLE; // Praise Zin!
     double noise(double xin, double yin, double zin, double win) IMMUTABLE;
     double fBM(double xin, double yin, double zin, uint32_t octaves) IMMUTABLE;
+    // fBM() at count points with the same z, in out.
+    void fBM_many(const double *xin, const double *yin, double zin,
+                  uint32_t octaves, size_t count, double *out);
 }
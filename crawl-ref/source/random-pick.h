@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "bitary.h"
 #include "random.h"
 
 enum distrib_type
@@ -27,6 +28,18 @@ struct random_pick_entry
     T value;
 };
 
+// The entries of a weights table that can occur at one level, in table
+// order, with their rarities there and the running total of those.
+template <typename T>
+struct random_pick_table
+{
+    vector<T> values;
+    vector<int> rarities;
+    vector<int> cumulative;
+
+    int total() const { return cumulative.empty() ? 0 : cumulative.back(); }
+};
+
 template <typename T, int max>
 class random_picker
 {
@@ -36,7 +49,13 @@ public:
     int probability_at(T entry, const random_pick_entry<T> *weights, int level);
     int rarity_at(const random_pick_entry<T> *pop,
                   int depth);
+    const random_pick_table<T> &table_at(const random_pick_entry<T> *weights,
+                                         int level);
     virtual bool veto(T) { return false; }
+    // Whether veto() might refuse anything; if not, pick() can go straight
+    // to the running totals. Subclasses overriding veto() must override
+    // this as well.
+    virtual bool can_veto() { return false; }
 };
 
 template <typename T, int max>
@@ -44,39 +63,80 @@ random_picker<T, max>::~random_picker()
 {
 }
 
+/**
+ * The entries of a weights table for a level, built on first use.
+ *
+ * Tables are cached by their address and the level, so the weights must be
+ * static data that doesn't change.
+ */
 template <typename T, int max>
-T random_picker<T, max>::pick(const random_pick_entry<T> *weights, int level,
-                              T none)
+const random_pick_table<T> &random_picker<T, max>::table_at(
+    const random_pick_entry<T> *weights, int level)
 {
-    struct { T value; int rarity; } valid[max];
-    int nvalid = 0;
-    int totalrar = 0;
+    static map<pair<const random_pick_entry<T> *, int>,
+               random_pick_table<T> > tables;
 
+    const auto key = make_pair(weights, level);
+    auto it = tables.find(key);
+    if (it != tables.end())
+        return it->second;
+
+    random_pick_table<T> &table = tables[key];
+    int totalrar = 0;
     for (const random_pick_entry<T> *pop = weights; pop->rarity; pop++)
     {
         if (level < pop->minr || level > pop->maxr)
             continue;
 
-        if (veto(pop->value))
-            continue;
-
         int rar = rarity_at(pop, level);
         ASSERTM(rar > 0, "Rarity %d: %d at level %d", rar, pop->value, level);
 
-        valid[nvalid].value = pop->value;
-        valid[nvalid].rarity = rar;
         totalrar += rar;
-        nvalid++;
+        table.values.push_back(pop->value);
+        table.rarities.push_back(rar);
+        table.cumulative.push_back(totalrar);
+    }
+    ASSERT(table.values.size() <= (size_t) max);
+    return table;
+}
+
+// Both paths make the same single roll over the same total, and walk the
+// entries in the same order, so a given seed picks the same thing either way.
+template <typename T, int max>
+T random_picker<T, max>::pick(const random_pick_entry<T> *weights, int level,
+                              T none)
+{
+    const random_pick_table<T> &table = table_at(weights, level);
+
+    if (!can_veto())
+    {
+        if (table.values.empty())
+            return none;
+
+        const int roll = random2(table.total()); // the roll!
+        const auto it = upper_bound(table.cumulative.begin(),
+                                    table.cumulative.end(), roll);
+        return table.values[it - table.cumulative.begin()];
+    }
+
+    FixedBitVector<max> vetoed;
+    int totalrar = 0;
+    for (size_t i = 0; i < table.values.size(); i++)
+    {
+        if (veto(table.values[i]))
+            vetoed.set(i);
+        else
+            totalrar += table.rarities[i];
     }
 
-    if (!nvalid)
+    if (!totalrar)
         return none;
 
     totalrar = random2(totalrar); // the roll!
 
-    for (int i = 0; i < nvalid; i++)
-        if ((totalrar -= valid[i].rarity) < 0)
-            return valid[i].value;
+    for (size_t i = 0; i < table.values.size(); i++)
+        if (!vetoed[i] && (totalrar -= table.rarities[i]) < 0)
+            return table.values[i];
 
     die("random_pick roll out of range");
 }
@@ -85,23 +145,18 @@ template <typename T, int max>
 int random_picker<T, max>::probability_at(T entry,
                     const random_pick_entry<T> *weights, int level)
 {
+    const random_pick_table<T> &table = table_at(weights, level);
     int totalrar = 0;
     int entry_rarity = 0;
 
-    for (const random_pick_entry<T> *pop = weights; pop->rarity; pop++)
+    for (size_t i = 0; i < table.values.size(); i++)
     {
-        if (level < pop->minr || level > pop->maxr)
-            continue;
-
-        if (veto(pop->value))
+        if (veto(table.values[i]))
             continue;
 
-        int rar = rarity_at(pop, level);
-        ASSERTM(rar > 0, "Rarity %d: %d at level %d", rar, pop->value, level);
-
-        if (entry == pop->value)
-            entry_rarity = rar;
-        totalrar += rar;
+        if (entry == table.values[i])
+            entry_rarity = table.rarities[i];
+        totalrar += table.rarities[i];
     }
 
     if (totalrar == 0)
@@ -0,0 +1,149 @@
+-- Run the fight simulator over every combination of a grid of characters,
+-- weapons, experience levels and monsters, and print one result per line as
+-- TSV (the default) or JSON lines. Needs a wizard build.
+--
+-- For example, to compare two weapons for a Minotaur Fighter against two
+-- monsters at XL 10 and 20, using 4 processes per simulation:
+--   util/fake_pty ./crawl -script fsim_grid -combos MiFi \
+--       -weapons morningstar "war axe" -xl 10 20 \
+--       -monsters "stone giant" "orc warrior" -jobs 4 > results.tsv 2>&1
+
+local usage = [[
+Usage: fsim_grid -monsters <monster> [<monster> ...] [-combos <combo> ...]
+                 [-weapons <weapon> ...] [-xl <n> ...] [-rounds <n>]
+                 [-jobs <n>] [-defend] [-json]
+    -combos:   species and background abbreviations, e.g. MiFi (default MiFi).
+    -weapons:  starting weapons as accepted by you.init (default morningstar).
+    -xl:       experience levels to simulate at (default 20).
+    -rounds:   rounds per simulation (default 4000).
+    -jobs:     processes to split each simulation over (default 1).
+    -defend:   also simulate the monster attacking the player.
+    -json:     print JSON objects rather than TSV.]]
+
+local STATS = { "hits", "av_hit_dam", "max_dam", "accuracy", "av_dam",
+                "av_time", "av_speed", "av_eff_dam" }
+
+local function parse_args(args)
+  local params = { monsters = { }, combos = { }, weapons = { }, xl = { } }
+  local flags = { defend = true, json = true }
+  local cur
+  for _, arg in ipairs(args) do
+    local flag = string.match(arg, "^%-(.+)$")
+    if flag and tonumber(arg) == nil then
+      if flags[flag] then
+        params[flag] = true
+        cur = nil
+      else
+        cur = flag
+        if not params[cur] then
+          params[cur] = { }
+        end
+      end
+    elseif cur then
+      table.insert(params[cur], arg)
+    else
+      script.usage(usage)
+    end
+  end
+  return params
+end
+
+local function first_number(list, default)
+  return list and list[1] and tonumber(list[1]) or default
+end
+
+local function json_string(s)
+  return '"' .. string.gsub(s, '[\\"]', '\\%0') .. '"'
+end
+
+local function report(params, row, stats)
+  if params.json then
+    local fields = { }
+    for _, key in ipairs({ "combo", "weapon", "monster", "mode" }) do
+      table.insert(fields, json_string(key) .. ": " .. json_string(row[key]))
+    end
+    table.insert(fields, '"xl": ' .. row.xl)
+    for _, who in ipairs({ "player", "monster" }) do
+      for _, stat in ipairs(STATS) do
+        table.insert(fields, json_string(who .. "_" .. stat) .. ": "
+                             .. stats[who][stat])
+      end
+    end
+    crawl.stderr("{" .. table.concat(fields, ", ") .. "}")
+  else
+    local line = { row.combo, row.weapon, row.xl, row.monster, row.mode }
+    for _, who in ipairs({ "player", "monster" }) do
+      for _, stat in ipairs(STATS) do
+        table.insert(line, stats[who][stat])
+      end
+    end
+    crawl.stderr(table.concat(line, "\t"))
+  end
+end
+
+local function tsv_header()
+  local line = { "combo", "weapon", "xl", "monster", "mode" }
+  for _, who in ipairs({ "player", "monster" }) do
+    for _, stat in ipairs(STATS) do
+      table.insert(line, who .. "_" .. stat)
+    end
+  end
+  crawl.stderr(table.concat(line, "\t"))
+end
+
+local function setup(combo, weapon, xl)
+  you.init(combo, weapon)
+  you.set_xl(xl)
+  debug.flush_map_memory()
+  debug.goto_place("D:1")
+  debug.generate_level()
+  dgn.grid(2, 2, "floor")
+  dgn.grid(2, 3, "floor")
+  you.moveto(2, 2)
+end
+
+if not wiz then
+  script.usage("fsim_grid needs a wizard build.")
+end
+
+local params = parse_args(crawl.script_args())
+if #params.monsters == 0 then
+  script.usage(usage)
+end
+if #params.combos == 0 then
+  params.combos = { "MiFi" }
+end
+if #params.weapons == 0 then
+  params.weapons = { "morningstar" }
+end
+if #params.xl == 0 then
+  params.xl = { "20" }
+end
+local rounds = first_number(params.rounds, 4000)
+crawl.setopt("fsim_jobs = " .. first_number(params.jobs, 1))
+
+local modes = { "attack" }
+if params.defend then
+  table.insert(modes, "defend")
+end
+
+if not params.json then
+  tsv_header()
+end
+
+for _, combo in ipairs(params.combos) do
+  for _, weapon in ipairs(params.weapons) do
+    for _, xl in ipairs(params.xl) do
+      setup(combo, weapon, tonumber(xl))
+      for _, monster in ipairs(params.monsters) do
+        for _, mode in ipairs(modes) do
+          local stats = wiz.fsim(monster, rounds, mode == "defend")
+          report(params,
+                 { combo = combo, weapon = weapon, xl = tonumber(xl),
+                   monster = monster, mode = mode },
+                 stats)
+        end
+      end
+    end
+  end
+end
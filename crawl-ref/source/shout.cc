@@ -33,10 +33,12 @@
 #include "state.h"
 #include "stringutil.h"
 #include "terrain.h"
+#include "unwind.h"
 #include "view.h"
 #include "viewchar.h"
 
 static noise_grid _noise_grid;
+static noise_grid _propagating_noise_grid;
 static void _actor_apply_noise(actor *act,
                                const coord_def &apparent_source,
                                int noise_intensity_millis);
@@ -762,16 +764,24 @@ void yell(const actor* mon)
 
 void apply_noises()
 {
-    // [ds] This copying isn't awesome, but we cannot otherwise handle
-    // the case where one set of noises wakes up monsters who then let
-    // out yips of their own, modifying _noise_grid while it is in the
-    // middle of propagate_noise().
+    // [ds] We cannot propagate on _noise_grid itself, since one set of
+    // noises may wake up monsters who then let out yips of their own,
+    // modifying _noise_grid while it is in the middle of propagate_noise().
+    // Move the registered noises onto a second grid and propagate there.
     if (_noise_grid.dirty())
     {
-        noise_grid copy = _noise_grid;
-        // Reset the main grid.
-        _noise_grid.reset();
-        copy.propagate_noise();
+        // Should a woken monster somehow trigger another round of noise
+        // while we are still propagating, give that round its own grid.
+        static bool propagating = false;
+        unique_ptr<noise_grid> nested;
+        if (propagating)
+            nested = make_unique<noise_grid>();
+        noise_grid &grid(nested ? *nested : _propagating_noise_grid);
+        unwind_bool in_propagation(propagating, true);
+
+        grid.take_noises(_noise_grid);
+        grid.propagate_noise();
+        grid.reset();
     }
 }
 
@@ -910,17 +920,43 @@ int noise_cell::turn_angle(const coord_def &next_delta) const
 }
 
 noise_grid::noise_grid()
-    : cells(), noises(), affected_actor_count(0)
+    : cells(), noises(), affected_actor_count(0),
+      touched_min(GXM, GYM), touched_max(-1, -1)
 {
 }
 
 void noise_grid::reset()
 {
-    cells.init(noise_cell());
+    for (int x = touched_min.x; x <= touched_max.x; ++x)
+        for (int y = touched_min.y; y <= touched_max.y; ++y)
+            cells[x][y] = noise_cell();
+    touched_min = coord_def(GXM, GYM);
+    touched_max = coord_def(-1, -1);
     noises.clear();
     affected_actor_count = 0;
 }
 
+void noise_grid::touch_cell(const coord_def &pos)
+{
+    touched_min.x = min(touched_min.x, pos.x);
+    touched_min.y = min(touched_min.y, pos.y);
+    touched_max.x = max(touched_max.x, pos.x);
+    touched_max.y = max(touched_max.y, pos.y);
+}
+
+void noise_grid::take_noises(noise_grid &other)
+{
+    ASSERT(noises.empty());
+    noises.swap(other.noises);
+    // Registering noise only changes the cells at the noise sources.
+    for (const noise_t &noise : noises)
+    {
+        cells(noise.noise_source) = other.cells(noise.noise_source);
+        touch_cell(noise.noise_source);
+    }
+    other.reset();
+}
+
 void noise_grid::register_noise(const noise_t &noise)
 {
     noise_cell &target_cell(cells(noise.noise_source));
@@ -933,6 +969,7 @@ void noise_grid::register_noise(const noise_t &noise)
                                               noise_index,
                                               0,
                                               coord_def(0, 0));
+        touch_cell(noise.noise_source);
     }
 }
 
@@ -945,8 +982,9 @@ void noise_grid::propagate_noise()
     dprf(DIAG_NOISE, "noise_grid: %u noises to apply",
          (unsigned int)noises.size());
 #endif
-    vector<coord_def> noise_perimeter[2];
     int circ_index = 0;
+    noise_perimeter[0].clear();
+    noise_perimeter[1].clear();
 
     for (const noise_t &noise : noises)
         noise_perimeter[circ_index].push_back(noise.noise_source);
@@ -1041,9 +1079,12 @@ bool noise_grid::propagate_noise_to_neighbour(int base_attenuation,
                                   cell.noise_id,
                                   travel_distance,
                                   next_pos - current_pos))
+        {
+            touch_cell(next_pos);
             // Return true only if we hadn't already registered this
             // cell as a neighbour (presumably with a lower volume).
             return neighbour_old_distance != travel_distance;
+        }
     }
     return false;
 }
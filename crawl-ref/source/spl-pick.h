@@ -22,6 +22,7 @@ public:
                               spell_pick_vetoer veto_func = nullptr);
 
     virtual bool veto(spell_type spell) override;
+    virtual bool can_veto() override { return veto_func != nullptr; }
 
 protected:
     spell_pick_vetoer veto_func;
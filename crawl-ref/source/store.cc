@@ -9,6 +9,7 @@
 #include "store.h"
 
 #include <algorithm>
+#include <chrono>
 
 #include "dlua.h"
 #include "monster.h"
@@ -1252,6 +1253,152 @@ void CrawlHashTable::read(reader &th)
     ASSERT_VALIDITY();
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// Interned keys
+//
+// Property keys are nearly always string literals or _KEY constants, so the
+// same few hundred pointers are looked up over and over. Keep a copy of the
+// string for each in a direct-mapped cache indexed by the pointer. The copy
+// is compared with the key before it is used, so a pointer into a buffer
+// whose contents change still finds the right entry.
+
+static const int STORE_KEY_CACHE_SIZE = 1024;
+
+struct store_key_cache_entry
+{
+    const char *ptr = nullptr;
+    string key;
+};
+
+static store_key_stats key_stats;
+
+static const string &_intern_store_key(const char *key)
+{
+    static store_key_cache_entry cache[STORE_KEY_CACHE_SIZE];
+    static const size_t small_string = string().capacity();
+
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(key);
+    store_key_cache_entry &entry =
+        cache[(addr ^ (addr >> 10)) % STORE_KEY_CACHE_SIZE];
+
+    key_stats.lookups++;
+    if (entry.ptr != key || entry.key.compare(key))
+    {
+        entry.ptr = key;
+        entry.key = key;
+        key_stats.misses++;
+    }
+    else if (entry.key.size() > small_string)
+        key_stats.allocs_saved++;
+    return entry.key;
+}
+
+// The cached string can be replaced by the next lookup, so it is only used
+// for the single call it is made for, within which no other key may be
+// interned; debug builds check that.
+class interned_key
+{
+public:
+    explicit interned_key(const char *key)
+    {
+#ifdef ASSERTS
+        ASSERT(!live);
+        live = true;
+#endif
+        str = &_intern_store_key(key);
+    }
+#ifdef ASSERTS
+    ~interned_key() { live = false; }
+#endif
+    interned_key(const interned_key &) = delete;
+    interned_key &operator=(const interned_key &) = delete;
+    operator const string &() const { return *str; }
+
+private:
+    const string *str;
+#ifdef ASSERTS
+    static bool live;
+#endif
+};
+
+#ifdef ASSERTS
+bool interned_key::live = false;
+#endif
+
+bool CrawlHashTable::exists(const char *key) const
+{
+    const interned_key interned(key);
+    return exists(interned);
+}
+
+const CrawlStoreValue& CrawlHashTable::get_value(const char *key) const
+{
+    const interned_key interned(key);
+    return get_value(interned);
+}
+
+CrawlStoreValue& CrawlHashTable::get_value(const char *key)
+{
+    const interned_key interned(key);
+    return get_value(interned);
+}
+
+CrawlHashTable::iterator CrawlHashTable::find(const char *key)
+{
+    const interned_key interned(key);
+    return map::find(interned);
+}
+
+CrawlHashTable::const_iterator CrawlHashTable::find(const char *key) const
+{
+    const interned_key interned(key);
+    return map::find(interned);
+}
+
+CrawlHashTable::size_type CrawlHashTable::erase(const char *key)
+{
+    const interned_key interned(key);
+    return map::erase(interned);
+}
+
+const store_key_stats &get_store_key_stats()
+{
+    return key_stats;
+}
+
+#if defined(DEBUG_DIAGNOSTICS) || defined(DEBUG_TESTS)
+// Look up each of the table's keys rounds times by const char*, first by
+// way of a temporary string and then through the interned key cache.
+store_key_bench_result store_key_bench(const CrawlHashTable &table,
+                                       int rounds)
+{
+    vector<const char *> keys;
+    for (const auto &entry : table)
+        keys.push_back(entry.first.c_str());
+
+    store_key_bench_result result;
+    result.lookups = rounds * keys.size();
+
+    int found = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i)
+        for (const char *key : keys)
+            found += table.exists(string(key));
+    auto mid = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i)
+        for (const char *key : keys)
+            found += table.exists(key);
+    auto end = chrono::steady_clock::now();
+    ASSERT(found == 2 * result.lookups);
+
+    result.string_ms = chrono::duration_cast<chrono::milliseconds>(
+                           mid - start).count();
+    result.interned_ms = chrono::duration_cast<chrono::milliseconds>(
+                             end - mid).count();
+    return result;
+}
+#endif
+
 #ifdef DEBUG_PROPS
 static map<string, int> accesses;
 # define ACCESS(x) ++accesses[x]
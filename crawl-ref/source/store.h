@@ -241,6 +241,22 @@ protected:
     friend class CrawlVector;
 };
 
+struct store_key_stats
+{
+    uint64_t lookups = 0;       // keys looked up through the cache
+    uint64_t misses = 0;        // ... that had to be copied into it
+    uint64_t allocs_saved = 0;  // hits too long for the small string buffer
+};
+
+const store_key_stats &get_store_key_stats();
+
+struct store_key_bench_result
+{
+    int lookups;
+    int string_ms;      // building a temporary string per lookup, as before
+    int interned_ms;    // through the interned key cache
+};
+
 class CrawlHashTable : public map<string, CrawlStoreValue>
 {
 public:
@@ -249,19 +265,22 @@ public:
     void write(writer &) const;
     void read(reader &);
 
+    // The const char* overloads look keys up through a cache of strings
+    // kept per key pointer (see store.cc), so that repeated lookups with
+    // the same literal or _KEY constant don't each build a string.
     bool exists(const string &key) const;
+    bool exists(const char *key) const;
 
     void assert_validity() const;
 
     // NOTE: If the const versions of get_value() or [] are given a
     // key which doesn't exist, they will assert.
     const CrawlStoreValue& get_value(const string &key) const;
-    const CrawlStoreValue& get_value(const char *key) const
-    { return get_value(string(key)); }
+    const CrawlStoreValue& get_value(const char *key) const;
     const CrawlStoreValue& operator[] (const string &key) const
     { return get_value(key); }
     const CrawlStoreValue& operator[] (const char *key) const
-    { return get_value(string(key)); }
+    { return get_value(key); }
 
     // NOTE: If get_value() or [] is given a key which doesn't exist
     // in the table, an unset/empty CrawlStoreValue will be created
@@ -271,13 +290,24 @@ public:
     // then trying to assign a different type to the CrawlStoreValue
     // will assert.
     CrawlStoreValue& get_value(const string &key);
-    CrawlStoreValue& get_value(const char *key)
-    { return get_value(string(key)); }
+    CrawlStoreValue& get_value(const char *key);
     using map::operator[];
     CrawlStoreValue& operator[] (const char *key)
-    { return get_value(string(key)); }
+    { return get_value(key); }
+
+    using map::find;
+    iterator find(const char *key);
+    const_iterator find(const char *key) const;
+
+    using map::erase;
+    size_type erase(const char *key);
 };
 
+#if defined(DEBUG_DIAGNOSTICS) || defined(DEBUG_TESTS)
+store_key_bench_result store_key_bench(const CrawlHashTable &table,
+                                       int rounds);
+#endif
+
 // A CrawlVector is the vector version of CrawlHashTable, except that
 // a non-empty CrawlVector has one more byte of savefile overhead that
 // a hash table, and that can specify a maximum size to make it act
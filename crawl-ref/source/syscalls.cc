@@ -21,6 +21,7 @@
 # include <fcntl.h>
 # include <sys/types.h>
 # include <sys/stat.h>
+# include <sys/mman.h>
 #endif
 
 #include "files.h"
@@ -445,6 +446,45 @@ int rename_u(const char *oldpath, const char *newpath)
 #endif
 }
 
+mapped_file::mapped_file(const string &path)
+    : _data(nullptr), _size(0)
+{
+#ifdef TARGET_OS_WINDOWS
+    FILE *fp = fopen_u(path.c_str(), "rb");
+    if (!fp)
+        return;
+    unsigned char buf[4096];
+    while (size_t got = fread(buf, 1, sizeof(buf), fp))
+        _copy.insert(_copy.end(), buf, buf + got);
+    fclose(fp);
+    _data = _copy.data();
+    _size = _copy.size();
+#else
+    const int fd = open_u(path.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+        return;
+    struct stat st;
+    if (!fstat(fd, &st) && st.st_size > 0)
+    {
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            _data = static_cast<const unsigned char *>(map);
+            _size = st.st_size;
+        }
+    }
+    close(fd);
+#endif
+}
+
+mapped_file::~mapped_file()
+{
+#ifndef TARGET_OS_WINDOWS
+    if (_data)
+        munmap(const_cast<unsigned char *>(_data), _size);
+#endif
+}
+
 int unlink_u(const char *pathname)
 {
 #ifdef TARGET_OS_WINDOWS
@@ -36,3 +36,24 @@ int unlink_u(const char *pathname);
 FILE *fopen_u(const char *path, const char *mode);
 int mkdir_u(const char *pathname, mode_t mode);
 int open_u(const char *pathname, int flags, mode_t mode);
+
+// A read-only view of a whole file. Where possible the file is mapped, so
+// that processes reading the same file share its pages; otherwise it is
+// read into memory.
+class mapped_file
+{
+public:
+    mapped_file(const string &path);
+    ~mapped_file();
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    bool valid() const { return _data; }
+    const unsigned char *data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    const unsigned char *_data;
+    size_t _size;
+    vector<unsigned char> _copy;
+};
@@ -109,7 +109,7 @@ extern set<pair<string, level_id> > auto_unique_annotations;
 extern abyss_state abyssal_state;
 
 reader::reader(const string &_read_filename, int minorVersion)
-    : _filename(_read_filename), _chunk(0), _pbuf(nullptr), _read_offset(0),
+    : _filename(_read_filename), _chunk(0), _cur(nullptr), _end(nullptr),
       _minorVersion(minorVersion), _safe_read(false)
 {
     _file       = fopen_u(_filename.c_str(), "rb");
@@ -117,8 +117,8 @@ reader::reader(const string &_read_filename, int minorVersion)
 }
 
 reader::reader(package *save, const string &chunkname, int minorVersion)
-    : _file(0), _chunk(0), opened_file(false), _pbuf(0), _read_offset(0),
-     _minorVersion(minorVersion), _safe_read(false)
+    : _file(0), _chunk(0), opened_file(false), _cur(_buf), _end(_buf),
+      _minorVersion(minorVersion), _safe_read(false)
 {
     ASSERT(save);
     _chunk = new chunk_reader(save, chunkname);
@@ -140,6 +140,13 @@ void reader::close()
 
 void reader::advance(size_t offset)
 {
+    // Files and memory buffers can skip ahead directly.
+    if (!_chunk)
+    {
+        read(nullptr, offset);
+        return;
+    }
+
     char junk[128];
 
     while (offset)
@@ -153,7 +160,7 @@ void reader::advance(size_t offset)
 bool reader::valid() const
 {
     return (_file && !feof(_file)) ||
-           (_pbuf && _read_offset < _pbuf->size());
+           (!_chunk && _cur < _end);
 }
 
 static NORETURN void _short_read(bool safe_read)
@@ -165,8 +172,18 @@ static NORETURN void _short_read(bool safe_read)
     die_noline("short read while reading save");
 }
 
-// Reads input in network byte order, from a file or buffer.
-unsigned char reader::readByte()
+// Refill the staging buffer from the chunk; false at the end of the chunk.
+bool reader::_fill_chunk_buffer()
+{
+    ASSERT(_chunk);
+    const plen_t got = _chunk->read(_buf, sizeof(_buf));
+    _cur = _buf;
+    _end = _buf + got;
+    return got;
+}
+
+// Called by readByte() once the buffered bytes are used up.
+unsigned char reader::_read_byte_slow()
 {
     if (_file)
     {
@@ -175,23 +192,30 @@ unsigned char reader::readByte()
             _short_read(_safe_read);
         return b;
     }
-    else if (_chunk)
-    {
-        unsigned char buf;
-        if (_chunk->read(&buf, 1) != 1)
-            _short_read(_safe_read);
-        return buf;
-    }
-    else
-    {
-        if (_read_offset >= _pbuf->size())
-            _short_read(_safe_read);
-        return (*_pbuf)[_read_offset++];
-    }
+    else if (_chunk && _fill_chunk_buffer())
+        return *_cur++;
+
+    _short_read(_safe_read);
 }
 
 void reader::read(void *data, size_t size)
 {
+    // Take what we can from the buffer first.
+    const size_t buffered = min(size, (size_t)(_end - _cur));
+    if (buffered)
+    {
+        if (data)
+        {
+            memcpy(data, _cur, buffered);
+            data = static_cast<unsigned char*>(data) + buffered;
+        }
+        _cur += buffered;
+        size -= buffered;
+    }
+
+    if (!size)
+        return;
+
     if (_file)
     {
         if (data)
@@ -204,18 +228,23 @@ void reader::read(void *data, size_t size)
     }
     else if (_chunk)
     {
-        if (_chunk->read(data, size) != size)
-            _short_read(_safe_read);
+        // Large reads go straight to the chunk, small ones via the buffer.
+        if (size >= sizeof(_buf))
+        {
+            if (_chunk->read(data, size) != size)
+                _short_read(_safe_read);
+        }
+        else
+        {
+            if (!_fill_chunk_buffer() || (size_t)(_end - _cur) < size)
+                _short_read(_safe_read);
+            if (data)
+                memcpy(data, _cur, size);
+            _cur += size;
+        }
     }
     else
-    {
-        if (_read_offset+size > _pbuf->size())
-            _short_read(_safe_read);
-        if (data && size)
-            memcpy(data, &(*_pbuf)[_read_offset], size);
-
-        _read_offset += size;
-    }
+        _short_read(_safe_read);
 }
 
 int reader::getMinorVersion() const
@@ -232,14 +261,23 @@ void reader::setMinorVersion(int minorVersion)
 void reader::fail_if_not_eof(const string &name)
 {
     char dummy;
-    if (_chunk ? _chunk->read(&dummy, 1) :
-        _file ? (fgetc(_file) != EOF) :
-        _read_offset >= _pbuf->size())
+    if (_cur < _end
+        || (_chunk ? _chunk->read(&dummy, 1) :
+            _file && fgetc(_file) != EOF))
     {
         fail("Incomplete read of \"%s\" - aborting.", name.c_str());
     }
 }
 
+writer::~writer()
+{
+    if (_chunk)
+    {
+        _flush_chunk();
+        delete _chunk;
+    }
+}
+
 void writer::check_ok(bool ok)
 {
     if (!ok && !failed)
@@ -250,17 +288,26 @@ void writer::check_ok(bool ok)
     }
 }
 
-void writer::writeByte(unsigned char ch)
+void writer::_flush_chunk()
+{
+    if (_buf_len)
+        _chunk->write(_buf, _buf_len);
+    _buf_len = 0;
+}
+
+// Called by writeByte() for files, or when the chunk buffer is full.
+void writer::_write_byte_slow(unsigned char ch)
 {
     if (failed)
         return;
 
     if (_chunk)
-        _chunk->write(&ch, 1);
-    else if (_file)
-        check_ok(fputc(ch, _file) != EOF);
+    {
+        _flush_chunk();
+        _buf[_buf_len++] = ch;
+    }
     else
-        _pbuf->push_back(ch);
+        check_ok(fputc(ch, _file) != EOF);
 }
 
 void writer::write(const void *data, size_t size)
@@ -269,7 +316,24 @@ void writer::write(const void *data, size_t size)
         return;
 
     if (_chunk)
-        _chunk->write(data, size);
+    {
+        if (_buf_len + size <= sizeof(_buf))
+        {
+            memcpy(_buf + _buf_len, data, size);
+            _buf_len += size;
+        }
+        else
+        {
+            _flush_chunk();
+            if (size < sizeof(_buf))
+            {
+                memcpy(_buf, data, size);
+                _buf_len = size;
+            }
+            else
+                _chunk->write(data, size);
+        }
+    }
     else if (_file)
         check_ok(fwrite(data, 1, size, _file) == size);
     else
@@ -53,24 +53,34 @@ class writer
 public:
     writer(const string &filename, FILE* output, bool ignore_errors = false)
         : _filename(filename), _file(output), _chunk(0),
-          _ignore_errors(ignore_errors), _pbuf(0), failed(false)
+          _ignore_errors(ignore_errors), _pbuf(0), failed(false),
+          _buf_len(0)
     {
         ASSERT(output);
     }
     writer(vector<unsigned char>* poutput)
         : _filename(), _file(0), _chunk(0), _ignore_errors(false),
-          _pbuf(poutput), failed(false) { ASSERT(poutput); }
+          _pbuf(poutput), failed(false), _buf_len(0) { ASSERT(poutput); }
     writer(package *save, const string &chunkname)
         : _filename(), _file(0), _chunk(0), _ignore_errors(false),
-          failed(false)
+          _pbuf(0), failed(false), _buf_len(0)
     {
         ASSERT(save);
         _chunk = save->writer(chunkname);
     }
 
-    ~writer() { if (_chunk) delete _chunk; }
+    ~writer();
 
-    void writeByte(unsigned char byte);
+    // Writes output in network byte order, to a file or buffer.
+    void writeByte(unsigned char byte)
+    {
+        if (_pbuf)
+            _pbuf->push_back(byte);
+        else if (_chunk && _buf_len < sizeof(_buf))
+            _buf[_buf_len++] = byte;
+        else
+            _write_byte_slow(byte);
+    }
     void write(const void *data, size_t size);
     long tell();
 
@@ -78,6 +88,8 @@ public:
 
 private:
     void check_ok(bool ok);
+    void _write_byte_slow(unsigned char byte);
+    void _flush_chunk();
 
 private:
     string _filename;
@@ -88,6 +100,11 @@ private:
     vector<unsigned char>* _pbuf;
 
     bool failed;
+
+    // Chunk output is staged here so that each marshalled byte doesn't
+    // go through the compressor separately.
+    size_t _buf_len;
+    unsigned char _buf[4096];
 };
 
 void marshallByte    (writer &, int8_t);
@@ -114,17 +131,29 @@ class reader
 public:
     reader(const string &filename, int minorVersion = TAG_MINOR_INVALID);
     reader(FILE* input, int minorVersion = TAG_MINOR_INVALID)
-        : _file(input), _chunk(0), opened_file(false), _pbuf(0),
-          _read_offset(0), _minorVersion(minorVersion), _safe_read(false) {}
+        : _file(input), _chunk(0), opened_file(false),
+          _cur(nullptr), _end(nullptr), _minorVersion(minorVersion),
+          _safe_read(false) {}
     reader(const vector<unsigned char>& input,
            int minorVersion = TAG_MINOR_INVALID)
-        : _file(0), _chunk(0), opened_file(false), _pbuf(&input),
-          _read_offset(0), _minorVersion(minorVersion), _safe_read(false) {}
+        : reader(input.data(), input.size(), minorVersion) {}
+    // Reads from memory the caller keeps alive, such as a mapped file.
+    reader(const unsigned char *input, size_t size,
+           int minorVersion = TAG_MINOR_INVALID)
+        : _file(0), _chunk(0), opened_file(false),
+          _cur(input), _end(input + size),
+          _minorVersion(minorVersion), _safe_read(false) {}
     reader(package *save, const string &chunkname,
            int minorVersion = TAG_MINOR_INVALID);
     ~reader();
 
-    unsigned char readByte();
+    // Reads input in network byte order, from a file or buffer.
+    unsigned char readByte()
+    {
+        if (_cur < _end)
+            return *_cur++;
+        return _read_byte_slow();
+    }
     void read(void *data, size_t size);
     void advance(size_t size);
     int getMinorVersion() const;
@@ -137,16 +166,23 @@ public:
 
     void set_safe_read(bool setting) { _safe_read = setting; }
 
+private:
+    unsigned char _read_byte_slow();
+    bool _fill_chunk_buffer();
+
 private:
     string _filename;
     FILE* _file;
     chunk_reader *_chunk;
     bool  opened_file;
-    const vector<unsigned char>* _pbuf;
-    unsigned int _read_offset;
+    // Unread bytes: either the rest of the input buffer, or what is staged
+    // in _buf from a chunk.
+    const unsigned char *_cur;
+    const unsigned char *_end;
     int _minorVersion;
     // always throw an exception rather than dying when reading past EOF
     bool _safe_read;
+    unsigned char _buf[4096];
 };
 
 class short_read_exception : exception {};
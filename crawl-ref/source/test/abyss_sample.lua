@@ -0,0 +1,6 @@
+-- Check that sampling the Abyss layouts in batches gives the same terrain
+-- as sampling them one cell at a time.
+
+local cells, mismatches = debug.abyss_sample_bench(2)
+assert(mismatches == 0,
+       mismatches .. " of " .. cells .. " batched Abyss samples differ")
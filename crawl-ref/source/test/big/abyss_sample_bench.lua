@@ -0,0 +1,15 @@
+-- Time sampling the Abyss layouts over map-sized areas cell by cell and in
+-- batches, optionally on several threads.
+-- Run with: ./crawl -test big/abyss_sample_bench
+-- or, to try threads: ./crawl -test big/abyss_sample_bench \
+--     -extra-opt-last abyss_sample_threads=4
+
+local ROUNDS = 20
+
+local cells, mismatches, cell_ms, batch_ms = debug.abyss_sample_bench(ROUNDS)
+crawl.stderr(string.format(
+  "%d cells: %.1f ms one at a time (%.2f us/cell), %.1f ms batched "
+  .. "(%.2f us/cell), %d mismatches\n",
+  cells, cell_ms, cell_ms * 1000 / cells, batch_ms, batch_ms * 1000 / cells,
+  mismatches))
+assert(mismatches == 0)
@@ -0,0 +1,31 @@
+-- Autoexplore seeded levels D:1-D:15 and time it. The turn counts depend
+-- only on the seed and the explore targets chosen, so they can be compared
+-- between builds to check that explore still goes the same way.
+-- Run with: ./crawl -test big/explore_bench
+
+local SEED = 1
+
+local function bench_level(place)
+  debug.reset_rng(SEED)
+  debug.goto_place(place)
+  debug.flush_map_memory()
+  debug.generate_level()
+
+  local start = crawl.millis()
+  local turns = debug.test_explore()
+  local elapsed = crawl.millis() - start
+  crawl.stderr(string.format("%-8s %6d turns %6d ms\n",
+                             place, turns, elapsed))
+  return turns, elapsed
+end
+
+debug.disable("death")
+
+local total_turns, total_ms = 0, 0
+for depth = 1, 15 do
+  local turns, elapsed = bench_level("D:" .. depth)
+  total_turns = total_turns + turns
+  total_ms = total_ms + elapsed
+end
+crawl.stderr(string.format("explore total: %d turns, %d ms\n",
+                           total_turns, total_ms))
@@ -0,0 +1,63 @@
+-- Time losight() on the layouts used by los_maps.lua, against the ray set
+-- code it replaced (los.losight's reference mode, debug builds only).
+-- Run with: ./crawl -test big/los_bench
+
+local ITERATIONS = 20000
+
+local function time_losight(reference)
+  local visible = 0
+  local start = crawl.millis()
+  for i = 1, ITERATIONS do
+    visible = visible + los.losight(30 + i % 10, 30 + i % 7, reference)
+  end
+  return crawl.millis() - start, visible
+end
+
+-- Check every cell each centre sees, in all four quadrants, against the
+-- reference before timing anything.
+local function check_los_map(name)
+  for x = 30, 39 do
+    for y = 30, 36 do
+      local diff, visible = los.losight_diff(x, y)
+      assert(diff == 0,
+             name .. ": losight and the reference disagree on " .. diff
+             .. " of " .. visible .. " cells seen from (" .. x .. ", "
+             .. y .. ")")
+    end
+  end
+end
+
+local function bench_los_map(map)
+  dgn.reset_level()
+  dgn.tags(map, "no_rotate no_vmirror no_hmirror no_pool_fixup")
+  local function place_map()
+    return dgn.place_map(map, true, true)
+  end
+  dgn.with_map_anchors(30, 30, place_map)
+
+  check_los_map(dgn.name(map))
+
+  local old_ms, old_visible = time_losight(true)
+  local new_ms, new_visible = time_losight(false)
+  assert(old_visible == new_visible,
+         dgn.name(map) .. ": reference saw " .. old_visible
+         .. " cells, losight saw " .. new_visible)
+  crawl.stderr(string.format("%-24s old %6d ms, new %6d ms (%.2f us/call, "
+                             .. "%d visible)\n",
+                             dgn.name(map), old_ms, new_ms,
+                             1000 * new_ms / ITERATIONS, new_visible))
+  return old_ms, new_ms
+end
+
+local old_total, new_total = 0, 0
+local map = dgn.map_by_tag("debug_los")
+assert(map, "Could not find debug-los maps (tag 'debug_los')")
+while map do
+  local old_ms, new_ms = bench_los_map(map)
+  old_total = old_total + old_ms
+  new_total = new_total + new_ms
+  map = dgn.map_by_tag("debug_los")
+end
+crawl.stderr(string.format("losight total: old %d ms, new %d ms (%.2fx)\n",
+                           old_total, new_total,
+                           old_total / math.max(new_total, 1)))
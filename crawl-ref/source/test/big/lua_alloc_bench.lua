@@ -0,0 +1,31 @@
+-- Generate levels and report the dungeon Lua interpreter's allocation and
+-- garbage collection counts, so that lua_gc_pause and lua_gc_stepmul can be
+-- compared. Run with: ./crawl -test big/lua_alloc_bench
+-- When run as a script, arguments set the collector's pause and step
+-- multiplier, e.g. ./crawl -script lua_alloc_bench 400 200
+
+local LEVELS = 10
+
+local args = crawl.script_args()
+if args[1] then
+  debug.lua_gc_params(tonumber(args[1]), tonumber(args[2] or 0), "dlua")
+end
+
+local before = debug.lua_stats("dlua")
+local start = crawl.millis()
+for depth = 1, LEVELS do
+  debug.goto_place("D:" .. depth)
+  debug.flush_map_memory()
+  debug.generate_level()
+end
+local elapsed = crawl.millis() - start
+local after = debug.lua_stats("dlua")
+
+crawl.stderr(string.format(
+  "%d levels in %d ms: %d allocs (%d pooled), %d reallocs, %d frees, "
+  .. "%.1f MB allocated, %d gc cycles, peak %.1f MB\n",
+  LEVELS, elapsed, after.allocs - before.allocs,
+  after.pooled - before.pooled, after.reallocs - before.reallocs,
+  after.frees - before.frees,
+  (after.bytes_allocated - before.bytes_allocated) / 1048576,
+  after.gc_cycles - before.gc_cycles, after.peak_memory / 1048576))
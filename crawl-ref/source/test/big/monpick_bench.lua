@@ -0,0 +1,16 @@
+-- Time picking monsters at every depth of every branch's populations, with
+-- and without a veto, through the cached pick tables and through the walk
+-- over the population data they replaced.
+-- Run with: ./crawl -test big/monpick_bench
+
+local ROUNDS = 200
+
+-- Warm the tables up, so the timing below doesn't include building them.
+debug.monpick_bench(1)
+
+local picks, table_ms, reference_ms = debug.monpick_bench(ROUNDS)
+crawl.stderr(string.format(
+  "%d picks: %.1f ms with tables (%.2f us/pick), %.1f ms without "
+  .. "(%.2f us/pick)\n",
+  picks, table_ms, table_ms * 1000 / picks, reference_ms,
+  reference_ms * 1000 / picks))
@@ -0,0 +1,42 @@
+-- Make many simultaneous noises on a crowded open level each turn and time
+-- how long the monster turns (including noise propagation) take.
+-- Run with: ./crawl -test big/noise_bench
+-- For the full game loop, see the fireworks scenario: test/stress/run 3
+
+local TURNS = 200
+local NOISES = 40
+local RADIUS = 15
+
+debug.disable("death")
+debug.goto_place("D:8")
+debug.flush_map_memory()
+debug.generate_level()
+dgn.dismiss_monsters()
+
+crawl_require('dlua/stress.lua')
+stress.fill_level('floor')
+
+local px, py = you.pos()
+for x = px - RADIUS, px + RADIUS do
+  for y = py - RADIUS, py + RADIUS do
+    if dgn.in_bounds(x, y) and (x ~= px or y ~= py)
+       and crawl.one_chance_in(4) then
+      dgn.create_monster(x, y, "statue hp:10000")
+    end
+  end
+end
+
+local elapsed = 0
+for turn = 1, TURNS do
+  for i = 1, NOISES do
+    local x = crawl.random_range(1, dgn.GXM - 2)
+    local y = crawl.random_range(1, dgn.GYM - 2)
+    dgn.noisy(crawl.random_range(5, 30), x, y)
+  end
+  local start = crawl.millis()
+  debug.handle_monsters(1)
+  elapsed = elapsed + crawl.millis() - start
+end
+
+crawl.stderr(string.format("%d noises/turn, %d turns in %d ms\n",
+                           NOISES, TURNS, elapsed))
@@ -0,0 +1,38 @@
+-- Time monster_pathfind on generated levels: every monster on the level
+-- finds a path to the player, many times over.
+-- Run with: ./crawl -test big/pathfind_bench
+
+local ROUNDS = 20
+
+local function bench_level(place)
+  debug.goto_place(place)
+  test.regenerate_level()
+  local you_x, you_y = you.pos()
+
+  local paths, steps = 0, 0
+  local start = crawl.millis()
+  for round = 1, ROUNDS do
+    for x = 1, dgn.GXM - 2 do
+      for y = 1, dgn.GYM - 2 do
+        local len = debug.monster_path(x, y, you_x, you_y)
+        if len then
+          paths = paths + 1
+          steps = steps + len
+        end
+      end
+    end
+  end
+  local elapsed = crawl.millis() - start
+  crawl.stderr(string.format("%-8s %5d paths %7d steps %6d ms\n",
+                             place, paths, steps, elapsed))
+  return elapsed
+end
+
+local total = 0
+for depth = 1, 15 do
+  total = total + bench_level("D:" .. depth)
+end
+for _, place in ipairs({ "Lair:1", "Swamp:1", "Elf:1", "Zot:1" }) do
+  total = total + bench_level(place)
+end
+crawl.stderr("pathfind total: " .. total .. " ms\n")
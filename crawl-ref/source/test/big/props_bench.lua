@@ -0,0 +1,55 @@
+-- Run monster turns on a crowded level, and report how many property key
+-- lookups went through the interned key cache and how many string
+-- allocations that saved, per turn, then time lookups with and without
+-- the cache.
+-- Run with: ./crawl -test big/props_bench
+
+local TURNS = 200
+local RADIUS = 12
+local MONSTERS = { "orc warrior", "orc wizard", "orc priest", "ogre",
+                   "hobgoblin", "gnoll", "kobold", "jackal", "centaur",
+                   "deep elf mage", "wolf", "ice beast" }
+
+debug.disable("death")
+debug.goto_place("D:8")
+debug.flush_map_memory()
+debug.generate_level()
+dgn.dismiss_monsters()
+
+local px, py = you.pos()
+local placed = 0
+for x = px - RADIUS, px + RADIUS do
+  for y = py - RADIUS, py + RADIUS do
+    if dgn.in_bounds(x, y) and dgn.is_passable(x, y)
+       and (x ~= px or y ~= py) and crawl.one_chance_in(3) then
+      local name = MONSTERS[crawl.random2(#MONSTERS) + 1]
+      local spec = "generate_awake " .. name
+      if crawl.coinflip() then
+        spec = spec .. " att:friendly"
+      end
+      if dgn.create_monster(x, y, spec) then
+        placed = placed + 1
+      end
+    end
+  end
+end
+
+local lookups0, misses0, saved0 = debug.store_key_stats()
+local start = crawl.millis()
+debug.handle_monsters(TURNS)
+local elapsed = crawl.millis() - start
+local lookups, misses, saved = debug.store_key_stats()
+
+crawl.stderr(string.format(
+  "%d monsters, %d turns in %d ms: %.0f key lookups/turn, "
+  .. "%.1f cache misses/turn, %.0f allocations saved/turn\n",
+  placed, TURNS, elapsed, (lookups - lookups0) / TURNS,
+  (misses - misses0) / TURNS, (saved - saved0) / TURNS))
+
+-- The same lookups with and without the cache, on the player's keys.
+local ROUNDS = 200000
+local n, string_ms, interned_ms = debug.store_key_bench(ROUNDS)
+crawl.stderr(string.format(
+  "%d lookups: %d ms with a temporary string, %d ms interned (%.1f vs "
+  .. "%.1f ns each)\n", n, string_ms, interned_ms,
+  1e6 * string_ms / math.max(n, 1), 1e6 * interned_ms / math.max(n, 1)))
@@ -0,0 +1,25 @@
+-- Time saving and reloading generated levels, as level excursions do.
+-- Run with: ./crawl -test big/save_bench
+
+local ROUNDS = 50
+
+local function bench_level(place)
+  debug.goto_place(place)
+  test.regenerate_level()
+
+  local start = crawl.millis()
+  debug.reload_level(ROUNDS)
+  local elapsed = crawl.millis() - start
+  crawl.stderr(string.format("%-8s %6d ms (%.2f ms/reload)\n",
+                             place, elapsed, elapsed / ROUNDS))
+  return elapsed
+end
+
+local total = 0
+for depth = 1, 15 do
+  total = total + bench_level("D:" .. depth)
+end
+for _, place in ipairs({ "Lair:1", "Swamp:1", "Elf:1", "Zot:1" }) do
+  total = total + bench_level(place)
+end
+crawl.stderr("save/reload total: " .. total .. " ms\n")
@@ -0,0 +1,55 @@
+-- Run monster turns on a level crowded with spellcasters, and report how
+-- many of their tracers the tracer memo answered, then time firing every
+-- beam spell tracer with and without the memo.
+-- Run with: ./crawl -test big/tracer_bench
+
+local TURNS = 200
+local RADIUS = 10
+local ROUNDS = 20
+local CASTERS = { "orc wizard", "orc sorcerer", "deep elf mage",
+                  "deep elf annihilator", "ogre mage", "centaur",
+                  "fire giant", "frost giant", "lich", "draconian stormcaller",
+                  "naga mage", "tengu conjurer" }
+
+debug.disable("death")
+debug.goto_place("D:14")
+debug.flush_map_memory()
+debug.generate_level()
+dgn.dismiss_monsters()
+
+local px, py = you.pos()
+local placed = 0
+for x = px - RADIUS, px + RADIUS do
+  for y = py - RADIUS, py + RADIUS do
+    if dgn.in_bounds(x, y) and dgn.is_passable(x, y)
+       and (x ~= px or y ~= py) and crawl.one_chance_in(3) then
+      local spec = "generate_awake " .. CASTERS[crawl.random2(#CASTERS) + 1]
+      if crawl.coinflip() then
+        spec = spec .. " att:friendly"
+      end
+      if dgn.create_monster(x, y, spec) then
+        placed = placed + 1
+      end
+    end
+  end
+end
+
+local hits0, misses0, uncacheable0 = debug.tracer_memo_stats()
+local start = crawl.millis()
+debug.handle_monsters(TURNS)
+local elapsed = crawl.millis() - start
+local hits, misses, uncacheable = debug.tracer_memo_stats()
+hits, misses, uncacheable = hits - hits0, misses - misses0,
+                            uncacheable - uncacheable0
+
+crawl.stderr(string.format(
+  "%d monsters, %d turns in %d ms: %d tracers, %.1f%% from the memo, "
+  .. "%d not memoisable\n",
+  placed, TURNS, elapsed, hits + misses + uncacheable,
+  100 * hits / math.max(1, hits + misses + uncacheable), uncacheable))
+
+local tracers, mismatches, fresh_ms, memo_ms = debug.tracer_memo_check(ROUNDS)
+crawl.stderr(string.format(
+  "%d tracers fired in pairs: %.1f ms afresh, %.1f ms through the memo, "
+  .. "%d mismatches\n", tracers, fresh_ms, memo_ms, mismatches))
+assert(mismatches == 0)
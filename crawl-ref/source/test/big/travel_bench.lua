@@ -0,0 +1,81 @@
+-- Record a game's worth of mapped levels in the travel cache, then time
+-- interlevel travel route queries across them, and refreshing the stair
+-- distances of a level that hasn't changed.
+-- Run with: ./crawl -test big/travel_bench
+
+local ROUNDS = 20
+local REFRESHES = 200
+
+local PLACES = { }
+for depth = 1, 15 do
+  table.insert(PLACES, "D:" .. depth)
+end
+for _, branch in ipairs({ { "Lair", 5 }, { "Orc", 2 }, { "Elf", 3 },
+                          { "Swamp", 4 }, { "Shoals", 4 }, { "Vaults", 4 },
+                          { "Depths", 4 } }) do
+  for depth = 1, branch[2] do
+    table.insert(PLACES, branch[1] .. ":" .. depth)
+  end
+end
+
+-- Branch entrances and exits seen so far, by the branch's name in the
+-- feature name: entries[name] = { place, x, y }.
+local entries, exits = { }, { }
+
+local function record_level(place)
+  debug.goto_place(place)
+  debug.flush_map_memory()
+  debug.generate_level()
+  debug.map_level()
+  debug.update_travel_cache()
+
+  for x = 1, dgn.GXM - 2 do
+    for y = 1, dgn.GYM - 2 do
+      local feat = dgn.feature_name(dgn.grid(x, y))
+      local dir, name = string.match(feat, "^(%a+)_(.+)$")
+      if dir == "enter" and not entries[name] then
+        entries[name] = { place, x, y }
+      elseif dir == "exit" and not exits[name] then
+        exits[name] = { place, x, y }
+      end
+    end
+  end
+end
+
+local start = crawl.millis()
+for _, place in ipairs(PLACES) do
+  record_level(place)
+end
+for name, entry in pairs(entries) do
+  local exit = exits[name]
+  if exit then
+    debug.link_stairs(entry[1], entry[2], entry[3], exit[1], exit[2], exit[3])
+  end
+end
+crawl.stderr(string.format("recorded %d levels in %d ms\n", #PLACES,
+                           crawl.millis() - start))
+
+local routes, unreachable = 0, 0
+start = crawl.millis()
+for round = 1, ROUNDS do
+  for _, place in ipairs(PLACES) do
+    if debug.travel_distance(place) then
+      routes = routes + 1
+    else
+      unreachable = unreachable + 1
+    end
+  end
+end
+local elapsed = crawl.millis() - start
+crawl.stderr(string.format(
+  "%d route queries in %d ms (%.2f ms/query, %d unreachable)\n",
+  routes + unreachable, elapsed, elapsed / (routes + unreachable),
+  unreachable / ROUNDS))
+
+start = crawl.millis()
+for i = 1, REFRESHES do
+  debug.update_travel_cache()
+end
+elapsed = crawl.millis() - start
+crawl.stderr(string.format("%d unchanged level refreshes in %d ms\n",
+                           REFRESHES, elapsed))
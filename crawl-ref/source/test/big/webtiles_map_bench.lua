@@ -0,0 +1,68 @@
+-- Compare the size and cost of sending the whole game state to webtiles
+-- clients with plain JSON and with packed map cells, then time the map
+-- messages of ordinary redraws, which only send the cells that changed.
+-- Run with: ./crawl -test big/webtiles_map_bench (webtiles builds only)
+
+if not debug.webtiles_send_everything then
+  crawl.stderr("Not a webtiles build, skipping.\n")
+  return
+end
+
+local ROUNDS = 20
+
+local function bench(packed)
+  local bytes = 0
+  local start = crawl.millis()
+  for i = 1, ROUNDS do
+    bytes = debug.webtiles_send_everything(packed)
+  end
+  return bytes, (crawl.millis() - start) / ROUNDS
+end
+
+local function bench_level(place)
+  debug.goto_place(place)
+  test.regenerate_level()
+  wiz.map_level()
+
+  local json_bytes, json_ms = bench(false)
+  local packed_bytes, packed_ms = bench(true)
+  crawl.stderr(string.format(
+    "%-8s json %7d bytes %6.2f ms  packed %7d bytes %6.2f ms (%d%%)\n",
+    place, json_bytes, json_ms, packed_bytes, packed_ms,
+    100 * packed_bytes / json_bytes))
+  return json_bytes, packed_bytes
+end
+
+local json_total, packed_total = 0, 0
+for _, place in ipairs({ "D:1", "D:5", "D:10", "Lair:1", "Swamp:1",
+                         "Elf:1", "Zot:1" }) do
+  local j, p = bench_level(place)
+  json_total = json_total + j
+  packed_total = packed_total + p
+end
+crawl.stderr(string.format("total: json %d bytes, packed %d bytes\n",
+                           json_total, packed_total))
+
+local FRAMES = 200
+
+local function frame_cost(place)
+  debug.goto_place(place)
+  test.regenerate_level()
+  wiz.map_level()
+  debug.webtiles_send_map(true)
+
+  local sends0, _, cells0, copied0, ms0 = debug.webtiles_map_stats()
+  for i = 1, FRAMES do
+    debug.viewwindow()
+    debug.webtiles_send_map(false)
+  end
+  local sends, _, cells, copied, ms = debug.webtiles_map_stats()
+  sends = sends - sends0
+  crawl.stderr(string.format(
+    "%-8s %5.0f cells sent, %5.0f copied, %6.3f ms per redraw\n", place,
+    (cells - cells0) / sends, (copied - copied0) / sends, (ms - ms0) / sends))
+end
+
+for _, place in ipairs({ "D:1", "Lair:1", "Zot:1" }) do
+  frame_cost(place)
+end
@@ -0,0 +1,76 @@
+-- Check that the cell_see_cell cache stays correct when single cells
+-- change opacity, by comparing against a freshly flushed cache.
+
+local floor = dgn.find_feature_number("floor")
+local rock_wall = dgn.find_feature_number("rock_wall")
+
+local RANGE = 8
+
+local function cells_near(x, y, f)
+  for dy = -RANGE, RANGE do
+    for dx = -RANGE, RANGE do
+      if dgn.in_bounds(x + dx, y + dy) then
+        f(x + dx, y + dy)
+      end
+    end
+  end
+end
+
+local function snapshot(x, y)
+  local seen = { }
+  cells_near(x, y,
+    function (px, py)
+      seen[px .. "," .. py] = los.cell_see_cell(x, y, px, py)
+    end)
+  return seen
+end
+
+local function toggle_cell(x, y)
+  local feat = dgn.grid(x, y)
+  if feat == floor then
+    dgn.terrain_changed(x, y, "rock_wall", false, false)
+  elseif feat == rock_wall then
+    dgn.terrain_changed(x, y, "floor", false, false)
+  end
+end
+
+local function test_invalidation(iter)
+  you.random_teleport()
+  local cx, cy = you.pos()
+  -- Warm the cache around a few viewers near the changed cell.
+  local viewers = { }
+  for i = 1, 4 do
+    local vx = cx + crawl.random_range(-4, 4)
+    local vy = cy + crawl.random_range(-4, 4)
+    if dgn.in_bounds(vx, vy) then
+      table.insert(viewers, { vx, vy })
+      snapshot(vx, vy)
+    end
+  end
+
+  local px = cx + crawl.random_range(-3, 3)
+  local py = cy + crawl.random_range(-3, 3)
+  if not dgn.in_bounds(px, py) then
+    return
+  end
+  toggle_cell(px, py)
+
+  for _, v in ipairs(viewers) do
+    local cached = snapshot(v[1], v[2])
+    debug.los_changed()
+    local fresh = snapshot(v[1], v[2])
+    for k, s in pairs(fresh) do
+      assert(cached[k] == s,
+             "stale LOS cache entry (iter #" .. iter .. ") from "
+             .. v[1] .. "," .. v[2] .. " to " .. k .. " after changing "
+             .. px .. "," .. py)
+    end
+  end
+end
+
+debug.goto_place("D:3")
+debug.flush_map_memory()
+debug.generate_level()
+for i = 1, 50 do
+  test_invalidation(i)
+end
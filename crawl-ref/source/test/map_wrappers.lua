@@ -0,0 +1,34 @@
+-- Check that placing a map builds its Lua wrappers once, rather than once for
+-- every chunk and hook run on it.
+
+local iters = 5
+
+local function place_bounce_test(map)
+  dgn.reset_level()
+  local function place_map()
+    return dgn.place_map(map, true, true, 30, 30)
+  end
+  dgn.with_map_anchors(30, 30, place_map)
+  assert(dgn.grid(31, 31) == dgn.find_feature_number("floor"),
+         "Map not placed properly")
+end
+
+local function test_map_wrappers()
+  debug.flush_map_memory()
+  local map = dgn.map_by_tag("bounce_test")
+  assert(map, "Could not find bounce_test map (tag 'bounce_test')")
+
+  -- Every call pushes a different userdata for the same map.
+  assert(dgn.map_id(map) == dgn.map_id(dgn.map_by_tag("bounce_test")),
+         "dgn.map_id differs for the same map")
+
+  for i = 1, iters do
+    local before = dgn._map_wrapper_builds or 0
+    place_bounce_test(map)
+    local builds = (dgn._map_wrapper_builds or 0) - before
+    assert(builds == 1,
+           "Placing bounce_test built its wrappers " .. builds .. " times")
+  end
+end
+
+test_map_wrappers()
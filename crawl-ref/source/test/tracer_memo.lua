@@ -0,0 +1,32 @@
+-- Check that monster tracers answered from the tracer memo agree with
+-- tracers fired afresh.
+
+local CASTERS = { "orc wizard", "deep elf mage", "ogre mage", "centaur",
+                  "deep elf annihilator", "fire giant", "lich" }
+
+debug.disable("death")
+debug.goto_place("D:12")
+debug.flush_map_memory()
+debug.generate_level()
+dgn.dismiss_monsters()
+
+local px, py = you.pos()
+for x = px - 6, px + 6 do
+  for y = py - 6, py + 6 do
+    if dgn.in_bounds(x, y) and dgn.is_passable(x, y)
+       and (x ~= px or y ~= py) and crawl.one_chance_in(4) then
+      local spec = "generate_awake " .. CASTERS[crawl.random2(#CASTERS) + 1]
+      if crawl.coinflip() then
+        spec = spec .. " att:friendly"
+      end
+      dgn.create_monster(x, y, spec)
+    end
+  end
+end
+
+-- Give the monsters a turn to pick their targets.
+debug.handle_monsters(1)
+
+local tracers, mismatches = debug.tracer_memo_check(3)
+assert(mismatches == 0,
+       mismatches .. " of " .. tracers .. " memoised tracers differ")
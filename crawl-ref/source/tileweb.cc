@@ -5,6 +5,7 @@
 #include "tileweb.h"
 
 #include <cerrno>
+#include <chrono>
 #include <cstdarg>
 
 #include <sys/socket.h>
@@ -65,6 +66,9 @@
 
 //#define DEBUG_WEBSOCKETS
 
+// How much a client may fall behind before it starts missing messages.
+#define MAX_QUEUED_BYTES (4 * 1024 * 1024)
+
 static unsigned int get_milliseconds()
 {
     // This is Unix-only, but so is Webtiles at the moment.
@@ -77,6 +81,7 @@ static unsigned int get_milliseconds()
 TilesFramework tiles;
 
 TilesFramework::TilesFramework() :
+      m_need_resync(false),
       m_controlled_from_web(false),
       _send_lock(false),
       m_last_ui_state(UI_INIT),
@@ -88,6 +93,10 @@ TilesFramework::TilesFramework() :
       m_current_flash_colour(BLACK),
       m_next_flash_colour(BLACK),
       m_need_full_map(true),
+      m_cell_mask(0),
+      m_last_packed_mask(0),
+      m_packed_run(0),
+      m_bytes_sent(0),
       m_text_menu("menu_txt"),
       m_print_fg(15)
 {
@@ -106,6 +115,14 @@ void TilesFramework::shutdown()
     if (m_sock_name.empty())
         return;
 
+    // Give slow clients a few seconds to get the last messages (e.g. the
+    // exit reason).
+    for (int tries = 0; tries < 500 && _have_queued(); ++tries)
+    {
+        usleep(10 * 1000);
+        _send_queued();
+    }
+
     close(m_sock);
     remove(m_sock_name.c_str());
 }
@@ -180,10 +197,146 @@ void TilesFramework::write_message(const char *format, ...)
     m_msg_buf.append(buf);
 }
 
+// Send as much of msg, starting at offset, as the client at addr will
+// take without blocking. Returns false if the client has gone away.
+bool TilesFramework::_send_fragments(const sockaddr_un &addr,
+                                     const string &msg, size_t &offset)
+{
+    while (offset < msg.size())
+    {
+        const size_t fragment_size = min(msg.size() - offset,
+                                         (size_t) m_max_msg_size);
+        ssize_t retval = sendto(m_sock, msg.data() + offset, fragment_size,
+                                MSG_DONTWAIT, (sockaddr*) &addr,
+                                sizeof(sockaddr_un));
+        if (retval > 0)
+        {
+#ifdef DEBUG_WEBSOCKETS
+            fprintf(stderr, "websocket: fragment size %d sent.\n",
+                            (int) retval);
+#endif
+            offset += retval;
+            continue;
+        }
+
+        const char *errmsg = retval == 0 ? "No bytes sent" : strerror(errno);
+        if (retval == 0 || errno == ENOBUFS || errno == EWOULDBLOCK
+            || errno == EINTR || errno == EAGAIN)
+        {
+            // Try again later.
+#ifdef DEBUG_WEBSOCKETS
+            fprintf(stderr, "websocket: send failed (%s), queueing.\n",
+                            errmsg);
+#endif
+            return true;
+        }
+        else if (errno == ECONNREFUSED || errno == ENOENT)
+        {
+            // the other side is dead
+#ifdef DEBUG_WEBSOCKETS
+            fprintf(stderr, "websocket: send failed (%s), dropping client.\n",
+                            errmsg);
+#endif
+            return false;
+        }
+        else
+            die("Socket write error: %s", errmsg);
+    }
+    return true;
+}
+
+// Queue the rest of the current message for a client that couldn't take
+// all of it.
+void TilesFramework::_queue_message(WebtilesDest &dest, size_t offset)
+{
+    if (dest.queue.empty())
+        dest.queue_offset = offset;
+    dest.queue.push_back(m_msg_buf);
+    dest.queued_bytes += m_msg_buf.size();
+
+    if (dest.queued_bytes <= MAX_QUEUED_BYTES)
+        return;
+
+    // Too far behind: keep only a partly sent message, so the client can
+    // finish reassembling it, and resend everything once it has caught up.
+    const size_t keep = dest.queue_offset ? 1 : 0;
+    dest.dropped += dest.queue.size() - keep;
+    dest.queue.resize(keep);
+    dest.queued_bytes = keep ? dest.queue.front().size() : 0;
+    dest.lagging = true;
+    dprf("webtiles: client %s fell behind, dropped %d messages so far.",
+         dest.addr.sun_path, dest.dropped);
+}
+
+// Try to send the queued messages of every client.
+void TilesFramework::_send_queued()
+{
+    for (unsigned int i = 0; i < m_dests.size(); ++i)
+    {
+        WebtilesDest &dest = m_dests[i];
+        bool alive = true;
+        while (!dest.queue.empty())
+        {
+            const string &msg = dest.queue.front();
+            alive = _send_fragments(dest.addr, msg, dest.queue_offset);
+            if (!alive || dest.queue_offset < msg.size())
+                break;
+            dest.queued_bytes -= msg.size();
+            dest.queue_offset = 0;
+            dest.queue.pop_front();
+        }
+
+        if (!alive)
+        {
+            m_dests.erase(m_dests.begin() + i);
+            i--;
+            continue;
+        }
+
+        if (dest.lagging && dest.queue.empty())
+            m_need_resync = true;
+    }
+}
+
+bool TilesFramework::_have_queued() const
+{
+    for (const WebtilesDest &dest : m_dests)
+        if (!dest.queue.empty())
+            return true;
+    return false;
+}
+
+// Once lagging clients have caught up, send everything again, as for a
+// new spectator.
+void TilesFramework::_resync_lagging()
+{
+    if (!m_need_resync)
+        return;
+    m_need_resync = false;
+
+    bool resync = false;
+    for (WebtilesDest &dest : m_dests)
+    {
+        if (dest.lagging && dest.queue.empty())
+        {
+            dest.lagging = false;
+            resync = true;
+        }
+    }
+
+    if (resync)
+    {
+        flush_messages();
+        _send_everything();
+        flush_messages();
+    }
+}
+
 void TilesFramework::finish_message()
 {
     if (m_msg_buf.size() == 0)
         return;
+    m_bytes_sent += m_msg_buf.size();
 #ifdef DEBUG_WEBSOCKETS
     const int initial_buf_size = m_msg_buf.size();
     fprintf(stderr, "websocket: About to send %d bytes.\n", initial_buf_size);
@@ -196,81 +349,36 @@ void TilesFramework::finish_message()
     }
 
     m_msg_buf.append("\n");
-    const char* fragment_start = m_msg_buf.data();
-    const char* data_end = m_msg_buf.data() + m_msg_buf.size();
-    int fragments = 0;
-    while (fragment_start < data_end)
-    {
-        int fragment_size = data_end - fragment_start;
-        if (fragment_size > m_max_msg_size)
-            fragment_size = m_max_msg_size;
-        fragments++;
 
-        for (unsigned int i = 0; i < m_dest_addrs.size(); ++i)
+    // Clients that are behind get this after what they already have
+    // queued; nobody waits for a slow client.
+    _send_queued();
+    for (unsigned int i = 0; i < m_dests.size(); ++i)
+    {
+        WebtilesDest &dest = m_dests[i];
+        if (dest.lagging)
         {
-            int retries = 30;
-            ssize_t sent = 0;
-            while (sent < fragment_size)
-            {
-                ssize_t retval = sendto(m_sock, fragment_start + sent,
-                    fragment_size - sent, 0, (sockaddr*) &m_dest_addrs[i],
-                    sizeof(sockaddr_un));
-#ifdef DEBUG_WEBSOCKETS
-                fprintf(stderr,
-                            "    trying to send fragment to client %d...", i);
-#endif
-                if (retval <= 0)
-                {
-                    const char *errmsg = retval == 0 ? "No bytes sent"
-                                                     : strerror(errno);
-                    if (--retries <= 0)
-                        die("Socket write error: %s", errmsg);
+            dest.dropped++;
+            continue;
+        }
 
-                    if (retval == 0 || errno == ENOBUFS || errno == EWOULDBLOCK
-                        || errno == EINTR || errno == EAGAIN)
-                    {
-                        // Wait for half a second at first (up to five), then
-                        // try again.
-                        const int sleep_time = retries > 25 ? 2 * 1000
-                                             : retries > 10 ? 500 * 1000
-                                             : 5000 * 1000;
-#ifdef DEBUG_WEBSOCKETS
-                        fprintf(stderr, "failed (%s), sleeping for %dms.\n",
-                                                    errmsg, sleep_time / 1000);
-#endif
-                        usleep(sleep_time);
-                    }
-                    else if (errno == ECONNREFUSED || errno == ENOENT)
-                    {
-                        // the other side is dead
-#ifdef DEBUG_WEBSOCKETS
-                        fprintf(stderr,
-                            "failed (%s), breaking.\n", errmsg);
-#endif
-                        m_dest_addrs.erase(m_dest_addrs.begin() + i);
-                        i--;
-                        break;
-                    }
-                    else
-                        die("Socket write error: %s", errmsg);
-                }
-                else
-                {
-#ifdef DEBUG_WEBSOCKETS
-                    fprintf(stderr, "fragment size %d sent.\n", fragment_size);
-#endif
-                    sent += retval;
-                }
-            }
+        size_t sent = 0;
+        if (dest.queue.empty()
+            && !_send_fragments(dest.addr, m_msg_buf, sent))
+        {
+            m_dests.erase(m_dests.begin() + i);
+            i--;
+            continue;
         }
 
-        fragment_start += fragment_size;
+        if (sent < m_msg_buf.size())
+            _queue_message(dest, sent);
     }
+
     m_msg_buf.clear();
     m_need_flush = true;
 #ifdef DEBUG_WEBSOCKETS
-    fprintf(stderr, "websocket: Sent %d bytes in %d fragments.\n",
-                                                initial_buf_size, fragments);
+    fprintf(stderr, "websocket: Sent %d bytes.\n", initial_buf_size);
 #endif
 }
 
@@ -314,7 +422,7 @@ void TilesFramework::_await_connection()
     if (m_sock_name.empty())
         return;
 
-    while (m_dest_addrs.size() == 0)
+    while (m_dests.size() == 0)
         _receive_control_message();
 }
 
@@ -367,7 +475,7 @@ wint_t TilesFramework::_handle_control_message(sockaddr_un addr, string data)
         JsonWrapper primary = json_find_member(obj.node, "primary");
         primary.check(JSON_BOOL);
 
-        m_dest_addrs.push_back(addr);
+        m_dests.emplace_back(addr);
         m_controlled_from_web = primary->bool_;
     }
     else if (msgtype == "key")
@@ -474,6 +582,12 @@ bool TilesFramework::await_input(wint_t& c, bool block)
     {
         do
         {
+            if (!m_sock_name.empty())
+            {
+                _send_queued();
+                _resync_lagging();
+            }
+
             FD_ZERO(&fds);
             FD_SET(STDIN_FILENO, &fds);
             if (!m_sock_name.empty())
@@ -482,7 +596,12 @@ bool TilesFramework::await_input(wint_t& c, bool block)
             if (block)
             {
                 tiles.flush_messages();
-                result = select(maxfd + 1, &fds, nullptr, nullptr, nullptr);
+                // Wake up now and then to feed clients that are behind.
+                timeval timeout;
+                timeout.tv_sec = 0;
+                timeout.tv_usec = 50 * 1000;
+                result = select(maxfd + 1, &fds, nullptr, nullptr,
+                                _have_queued() ? &timeout : nullptr);
             }
             else
             {
@@ -493,7 +612,7 @@ bool TilesFramework::await_input(wint_t& c, bool block)
                 result = select(maxfd + 1, &fds, nullptr, nullptr, &timeout);
             }
         }
-        while (result == -1 && errno == EINTR);
+        while (result == -1 && errno == EINTR || block && result == 0);
 
         if (result == 0)
             return false;
@@ -528,6 +647,14 @@ bool TilesFramework::await_input(wint_t& c, bool block)
 void TilesFramework::dump()
 {
     fprintf(stderr, "Webtiles message buffer: %s\n", m_msg_buf.c_str());
+    fprintf(stderr, "Webtiles clients:\n");
+    for (const WebtilesDest &dest : m_dests)
+    {
+        fprintf(stderr, "%s: %u queued (%u bytes) dropped: %d%s\n",
+                dest.addr.sun_path, (unsigned int) dest.queue.size(),
+                (unsigned int) dest.queued_bytes, dest.dropped,
+                dest.lagging ? " lagging" : "");
+    }
     fprintf(stderr, "Webtiles JSON stack:\n");
     for (const JsonFrame &frame : m_json_stack)
     {
@@ -1316,7 +1443,7 @@ void TilesFramework::_send_cell(const coord_def &gc,
                                 bool force_full)
 {
     if (current_mc.feat() != next_mc.feat())
-        json_write_int("f", next_mc.feat());
+        _cell_field_int(CF_FEAT, "f", next_mc.feat());
 
     if (next_mc.monsterinfo())
         _send_monster(gc, next_mc.monsterinfo(), new_monster_locs, force_full);
@@ -1325,7 +1452,7 @@ void TilesFramework::_send_cell(const coord_def &gc,
 
     map_feature mf = get_cell_map_feature(gc);
     if (get_cell_map_feature(current_mc) != mf)
-        json_write_int("mf", mf);
+        _cell_field_int(CF_MAP_FEATURE, "mf", mf);
 
     // Glyph and colour
     char32_t glyph = next_sc.glyph;
@@ -1333,14 +1460,14 @@ void TilesFramework::_send_cell(const coord_def &gc,
     {
         char buf[5];
         buf[wctoutf8(buf, glyph)] = 0;
-        json_write_string("g", buf);
+        _cell_field_string(CF_GLYPH, "g", buf);
     }
     if ((current_sc.colour != next_sc.colour
          || current_sc.glyph == ' ') && glyph != ' ')
     {
         int col = next_sc.colour;
         col = (_get_brand(col) << 4) | macro_colour(col & 0xF);
-        json_write_int("col", col);
+        _cell_field_int(CF_COLOUR, "col", col);
     }
 
     json_open_object("t");
@@ -1358,17 +1485,16 @@ void TilesFramework::_send_cell(const coord_def &gc,
         {
             fg_changed = true;
 
-            json_write_name("fg");
-            write_tileidx(next_pc.fg);
+            _cell_field_tileidx(CF_FG, "fg", next_pc.fg);
             if (get_tile_texture(fg_idx) == TEX_DEFAULT)
-                json_write_int("base", (int) tileidx_known_base_item(fg_idx));
+            {
+                _cell_field_int(CF_BASE, "base",
+                                (int) tileidx_known_base_item(fg_idx));
+            }
         }
 
         if (next_pc.bg != current_pc.bg)
-        {
-            json_write_name("bg");
-            write_tileidx(next_pc.bg);
-        }
+            _cell_field_tileidx(CF_BG, "bg", next_pc.bg);
 
         if (next_pc.cloud != current_pc.cloud)
         {
@@ -1428,11 +1554,20 @@ void TilesFramework::_send_cell(const coord_def &gc,
              || !_needs_flavour(current_pc)
              || force_full))
         {
-            json_open_object("flv");
-            json_write_int("f", next_pc.flv.floor);
-            if (next_pc.flv.special)
-                json_write_int("s", next_pc.flv.special);
-            json_close_object();
+            if (m_packed_map)
+            {
+                _cell_field_int(CF_FLV_FLOOR, "f", next_pc.flv.floor);
+                if (next_pc.flv.special)
+                    _cell_field_int(CF_FLV_SPECIAL, "s", next_pc.flv.special);
+            }
+            else
+            {
+                json_open_object("flv");
+                json_write_int("f", next_pc.flv.floor);
+                if (next_pc.flv.special)
+                    json_write_int("s", next_pc.flv.special);
+                json_close_object();
+            }
         }
 
         if (fg_idx >= TILEP_MCACHE_START)
@@ -1554,22 +1689,135 @@ void TilesFramework::_mcache_ref(bool inc)
 {
     for (int y = 0; y < GYM; y++)
         for (int x = 0; x < GXM; x++)
-        {
-            coord_def gc(x, y);
+            _mcache_ref_cell(coord_def(x, y), inc);
+}
 
-            int fg_idx = m_current_view(gc).tile.fg & TILE_FLAG_MASK;
-            if (fg_idx >= TILEP_MCACHE_START)
-            {
-                mcache_entry *entry = mcache.get(fg_idx);
-                if (entry)
-                {
-                    if (inc)
-                        entry->inc_ref();
-                    else
-                        entry->dec_ref();
-                }
-            }
+void TilesFramework::_mcache_ref_cell(const coord_def &gc, bool inc)
+{
+    int fg_idx = m_current_view(gc).tile.fg & TILE_FLAG_MASK;
+    if (fg_idx >= TILEP_MCACHE_START)
+    {
+        mcache_entry *entry = mcache.get(fg_idx);
+        if (entry)
+        {
+            if (inc)
+                entry->inc_ref();
+            else
+                entry->dec_ref();
         }
+    }
+}
+
+// Start the next packed field of the current cell, returning the buffer
+// to write it to. Fields must come in cell_field order.
+string &TilesFramework::_cell_field(cell_field field)
+{
+    ASSERT(!(m_cell_mask >> field));
+    m_cell_mask |= 1 << field;
+    string &buf = field <= CF_Y ? m_cell_pos : m_cell_fields;
+    buf += ',';
+    return buf;
+}
+
+void TilesFramework::_cell_field_int(cell_field field, const string &name,
+                                     int value)
+{
+    if (!m_packed_map)
+    {
+        json_write_int(name, value);
+        return;
+    }
+
+    char buf[16];
+    _cell_field(field).append(buf, snprintf(buf, sizeof(buf), "%d", value));
+}
+
+void TilesFramework::_cell_field_string(cell_field field, const string &name,
+                                        const string &value)
+{
+    if (!m_packed_map)
+    {
+        json_write_string(name, value);
+        return;
+    }
+
+    const size_t start = m_msg_buf.size();
+    write_message("\"");
+    write_message_escaped(value);
+    write_message("\"");
+    _cell_field(field).append(m_msg_buf, start, string::npos);
+    m_msg_buf.resize(start);
+}
+
+void TilesFramework::_cell_field_tileidx(cell_field field, const string &name,
+                                         tileidx_t value)
+{
+    if (!m_packed_map)
+    {
+        json_write_name(name);
+        write_tileidx(value);
+        return;
+    }
+
+    const size_t start = m_msg_buf.size();
+    write_tileidx(value);
+    _cell_field(field).append(m_msg_buf, start, string::npos);
+    m_msg_buf.resize(start);
+}
+
+// Replace the cell object _send_map() has just written with its packed
+// form, or count it as a repeat of the previous cell. Returns whether
+// there was anything to send. The buffers are reused from cell to cell,
+// so this doesn't allocate once they have grown.
+bool TilesFramework::_close_packed_cell()
+{
+    const int start = m_json_stack.back().start;
+    const bool has_rest = !json_is_empty();
+    json_close_object(true);
+
+    if (has_rest)
+    {
+        // Move the unpacked fields out of the message.
+        m_cell_fields += ',';
+        m_cell_fields.append(m_msg_buf,
+                             m_msg_buf[start] == ',' ? start + 1 : start,
+                             string::npos);
+        m_msg_buf.resize(start);
+    }
+
+    const unsigned int pos_mask = 1 << CF_X | 1 << CF_Y;
+    const unsigned int mask = m_cell_mask & ~pos_mask;
+    const bool positioned = m_cell_mask & pos_mask;
+    const bool sent = mask || has_rest;
+
+    if (sent && !positioned && mask == m_last_packed_mask
+        && m_cell_fields == m_last_packed_cell)
+    {
+        m_packed_run++;
+    }
+    else if (sent)
+    {
+        _end_packed_run();
+        json_write_comma();
+        write_message("[%u", m_cell_mask);
+        m_msg_buf += m_cell_pos;
+        m_msg_buf += m_cell_fields;
+        m_msg_buf += ']';
+        m_last_packed_mask = mask;
+        m_last_packed_cell.swap(m_cell_fields);
+    }
+
+    m_cell_mask = 0;
+    m_cell_pos.clear();
+    m_cell_fields.clear();
+    return sent;
+}
+
+void TilesFramework::_end_packed_run()
+{
+    if (m_packed_run)
+        json_write_int(m_packed_run);
+    m_packed_run = 0;
 }
 
 void TilesFramework::_send_map(bool force_full)
@@ -1580,6 +1828,7 @@ void TilesFramework::_send_map(bool force_full)
 
     unwind_bool no_rentry(_send_lock, true);
 
+    const auto start = chrono::steady_clock::now();
     map<uint32_t, coord_def> new_monster_locs;
 
     force_full = force_full || m_need_full_map;
@@ -1618,55 +1867,75 @@ void TilesFramework::_send_map(bool force_full)
     coord_def last_gc(0, 0);
     bool send_gc = true;
 
-    json_open_array("cells");
-    for (int y = 0; y < GYM; y++)
-        for (int x = 0; x < GXM; x++)
-        {
-            coord_def gc(x, y);
-
-            if (!is_dirty(gc) && !force_full)
-                continue;
+    m_sent_cells.clear();
+    auto send_cell = [&](int x, int y)
+    {
+        coord_def gc(x, y);
 
-            if (cell_needs_redraw(gc))
-            {
-                screen_cell_t *cell = &m_next_view(gc);
+        if (cell_needs_redraw(gc))
+        {
+            screen_cell_t *cell = &m_next_view(gc);
 
-                draw_cell(cell, gc, false, m_current_flash_colour);
-                pack_cell_overlays(gc, m_next_view);
-            }
+            draw_cell(cell, gc, false, m_current_flash_colour);
+            pack_cell_overlays(gc, m_next_view);
+        }
 
-            mark_clean(gc);
+        mark_clean(gc);
+        m_sent_cells.push_back(gc);
 
-            if (m_origin.equals(-1, -1))
-                m_origin = gc;
+        if (m_origin.equals(-1, -1))
+            m_origin = gc;
 
-            json_open_object();
-            if (send_gc
-                || last_gc.x + 1 != gc.x
-                || last_gc.y != gc.y)
-            {
-                json_write_int("x", x - m_origin.x);
-                json_write_int("y", y - m_origin.y);
-                json_treat_as_empty();
-            }
+        json_open_object();
+        if (send_gc
+            || last_gc.x + 1 != gc.x
+            || last_gc.y != gc.y)
+        {
+            _cell_field_int(CF_X, "x", x - m_origin.x);
+            _cell_field_int(CF_Y, "y", y - m_origin.y);
+            json_treat_as_empty();
+        }
 
-            const screen_cell_t& sc = force_full ? default_cell
-                : m_current_view(gc);
-            const map_cell& mc = force_full ? default_map_cell
-                : m_current_map_knowledge(gc);
-            _send_cell(gc,
-                       sc,
-                       m_next_view(gc),
-                       mc, env.map_knowledge(gc),
-                       new_monster_locs, force_full);
-
-            if (!json_is_empty())
-            {
-                send_gc = false;
-                last_gc = gc;
-            }
+        const screen_cell_t& sc = force_full ? default_cell
+            : m_current_view(gc);
+        const map_cell& mc = force_full ? default_map_cell
+            : m_current_map_knowledge(gc);
+        _send_cell(gc,
+                   sc,
+                   m_next_view(gc),
+                   mc, env.map_knowledge(gc),
+                   new_monster_locs, force_full);
+
+        bool sent;
+        if (m_packed_map)
+            sent = _close_packed_cell();
+        else
+        {
+            sent = !json_is_empty();
             json_close_object(true);
         }
+
+        if (sent)
+        {
+            send_gc = false;
+            last_gc = gc;
+        }
+    };
+
+    json_open_array("cells");
+    m_last_packed_cell.clear();
+    m_last_packed_mask = 0;
+    m_packed_run = 0;
+    if (force_full)
+    {
+        for (int y = 0; y < GYM; y++)
+            for (int x = 0; x < GXM; x++)
+                send_cell(x, y);
+    }
+    else
+        m_dirty_cells.for_each_set(send_cell);
+    if (m_packed_map)
+        _end_packed_run();
     json_close_array(true);
 
     json_close_object(true);
@@ -1676,14 +1945,38 @@ void TilesFramework::_send_map(bool force_full)
     if (force_full)
         _send_cursor(CURSOR_MAP);
 
-    if (m_mcache_ref_done)
-        _mcache_ref(false);
+    // Only the cells just sent can have changed for the client, unless the
+    // mcache references for the whole view need taking afresh.
+    if (force_full || !m_mcache_ref_done)
+    {
+        if (m_mcache_ref_done)
+            _mcache_ref(false);
+
+        m_current_map_knowledge = env.map_knowledge;
+        m_current_view = m_next_view;
 
-    m_current_map_knowledge = env.map_knowledge;
-    m_current_view = m_next_view;
+        _mcache_ref(true);
+        m_mcache_ref_done = true;
+        m_map_stats.copied += GXM * GYM;
+    }
+    else
+    {
+        for (const coord_def &gc : m_sent_cells)
+        {
+            _mcache_ref_cell(gc, false);
+            m_current_map_knowledge(gc) = env.map_knowledge(gc);
+            m_current_view(gc) = m_next_view(gc);
+            _mcache_ref_cell(gc, true);
+        }
+        m_map_stats.copied += m_sent_cells.size();
+    }
 
-    _mcache_ref(true);
-    m_mcache_ref_done = true;
+    m_map_stats.sends++;
+    if (force_full)
+        m_map_stats.full_sends++;
+    m_map_stats.cells += m_sent_cells.size();
+    m_map_stats.ms += chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - start).count() / 1000.0;
 
     m_monster_locs = new_monster_locs;
 }
@@ -1847,6 +2140,25 @@ void TilesFramework::_send_messages()
 /*
   Send everything a newly joined spectator needs
  */
+// Send everything in the given map format, as for a new spectator, and
+// return how many bytes that took. For benchmarks.
+size_t TilesFramework::measure_send_everything(bool packed_map)
+{
+    unwind_bool packed(m_packed_map, packed_map);
+    const size_t before = m_bytes_sent;
+    _send_everything();
+    return m_bytes_sent - before;
+}
+
+// Send the map as the next redraw would, and return how many bytes that
+// took. For benchmarks.
+size_t TilesFramework::measure_send_map(bool force_full)
+{
+    const size_t before = m_bytes_sent;
+    _send_map(force_full);
+    return m_bytes_sent - before;
+}
+
 void TilesFramework::_send_everything()
 {
     _send_version();
@@ -2150,18 +2462,18 @@ void TilesFramework::mark_for_redraw(const coord_def& gc)
 
 void TilesFramework::mark_dirty(const coord_def& gc)
 {
-    m_dirty_cells[gc.y * GXM + gc.x] = true;
+    m_dirty_cells.set(gc);
 }
 
 void TilesFramework::mark_clean(const coord_def& gc)
 {
     m_cells_needing_redraw[gc.y * GXM + gc.x] = false;
-    m_dirty_cells[gc.y * GXM + gc.x] = false;
+    m_dirty_cells.set(gc, false);
 }
 
 bool TilesFramework::is_dirty(const coord_def& gc)
 {
-    return m_dirty_cells[gc.y * GXM + gc.x];
+    return m_dirty_cells.get(gc);
 }
 
 bool TilesFramework::cell_needs_redraw(const coord_def& gc)
@@ -8,11 +8,13 @@
 #ifdef USE_TILE_WEB
 
 #include <bitset>
+#include <deque>
 #include <map>
 #include <vector>
 
 #include <sys/un.h>
 
+#include "bitary.h"
 #include "cursor-type.h"
 #include "equipment-type.h"
 #include "map-cell.h"
@@ -36,6 +38,16 @@ enum WebtilesUIState
     UI_VIEW_MAP,
 };
 
+// Running totals of what building map messages has cost, for benchmarks.
+struct map_send_stats
+{
+    unsigned int sends = 0;      // map messages built
+    unsigned int full_sends = 0; // ... of which sent every cell
+    unsigned int cells = 0;      // cells compared and sent
+    unsigned int copied = 0;     // cells copied to what the client has
+    double ms = 0;               // time spent building them
+};
+
 struct player_info
 {
     player_info();
@@ -151,7 +163,7 @@ public:
     void send_message(PRINTF(1, ));
     void flush_messages();
 
-    bool has_receivers() { return !m_dest_addrs.empty(); }
+    bool has_receivers() { return !m_dests.empty(); }
     bool is_controlled_from_web() { return m_controlled_from_web; }
 
     /* Webtiles can receive input both via stdin, and on the
@@ -198,6 +210,10 @@ public:
 
     string m_sock_name;
     bool m_await_connection;
+    // Send map cells in the packed format below. Every client has to be
+    // able to decode it, since all of them get the same messages, so this
+    // is for the server to turn on (-webtiles-packed-map).
+    bool m_packed_map;
 
     void set_text_cursor(bool enabled);
     void set_ui_state(WebtilesUIState state);
@@ -214,11 +230,35 @@ public:
 
     void send_doll(const dolls_data &doll, bool submerged, bool ghost);
 
+    size_t measure_send_everything(bool packed_map);
+    size_t measure_send_map(bool force_full);
+    const map_send_stats &get_map_send_stats() const { return m_map_stats; }
+
 protected:
     int m_sock;
     int m_max_msg_size;
     string m_msg_buf;
-    vector<sockaddr_un> m_dest_addrs;
+
+    // A connected client. Messages it can't take right away are queued,
+    // up to a limit; past that it misses messages until it has caught up,
+    // and is then sent everything again.
+    struct WebtilesDest
+    {
+        sockaddr_un addr;
+        deque<string> queue;    // whole messages, each ending in '\n'
+        size_t queue_offset;    // bytes of queue.front() already sent
+        size_t queued_bytes;
+        int dropped;            // messages it has missed
+        bool lagging;
+
+        WebtilesDest(const sockaddr_un &a)
+            : addr(a), queue_offset(0), queued_bytes(0), dropped(0),
+              lagging(false)
+        {
+        }
+    };
+    vector<WebtilesDest> m_dests;
+    bool m_need_resync;
 
     bool m_controlled_from_web;
     bool m_need_flush;
@@ -226,6 +266,12 @@ protected:
     bool _send_lock; // not thread safe
 
     void _await_connection();
+    bool _send_fragments(const sockaddr_un &addr, const string &msg,
+                         size_t &offset);
+    void _queue_message(WebtilesDest &dest, size_t offset);
+    void _send_queued();
+    bool _have_queued() const;
+    void _resync_lagging();
     wint_t _handle_control_message(sockaddr_un addr, string data);
     wint_t _receive_control_message();
 
@@ -271,7 +317,7 @@ protected:
     coord_def m_next_view_tl;
     coord_def m_next_view_br;
 
-    bitset<GXM * GYM> m_dirty_cells;
+    BlockBitArray<GXM, GYM> m_dirty_cells;
     bitset<GXM * GYM> m_cells_needing_redraw;
     void mark_dirty(const coord_def& gc);
     void mark_clean(const coord_def& gc);
@@ -285,6 +331,45 @@ protected:
     map<uint32_t, coord_def> m_monster_locs;
     bool m_need_full_map;
 
+    // Packed map cells, if m_packed_map is set: common fields are sent by
+    // position as [mask, fields..., rest], where bit n of mask
+    // says whether cell_field n is present and rest is an object with
+    // anything else. A number n instead repeats the previous cell's
+    // fields for the next n cells. See map_knowledge.js.
+    enum cell_field
+    {
+        CF_X,
+        CF_Y,
+        CF_FEAT,
+        CF_MAP_FEATURE,
+        CF_GLYPH,
+        CF_COLOUR,
+        CF_FG,
+        CF_BASE,
+        CF_BG,
+        CF_FLV_FLOOR,
+        CF_FLV_SPECIAL,
+        NUM_CELL_FIELDS
+    };
+    // The fields of the cell being written, as ",value" for each field in
+    // m_cell_mask: its position, and everything else.
+    unsigned int m_cell_mask;
+    string m_cell_pos;
+    string m_cell_fields;
+    unsigned int m_last_packed_mask;
+    string m_last_packed_cell;
+    int m_packed_run;
+    string &_cell_field(cell_field field);
+    void _cell_field_int(cell_field field, const string &name, int value);
+    void _cell_field_string(cell_field field, const string &name,
+                            const string &value);
+    void _cell_field_tileidx(cell_field field, const string &name,
+                             tileidx_t value);
+    bool _close_packed_cell();
+    void _end_packed_run();
+
+    size_t m_bytes_sent;
+
     coord_def m_cursor[CURSOR_MAX];
     coord_def m_last_clicked_grid;
     bool m_text_cursor;
@@ -312,6 +397,12 @@ protected:
 
     bool m_mcache_ref_done;
     void _mcache_ref(bool inc);
+    void _mcache_ref_cell(const coord_def &gc, bool inc);
+
+    // Cells sent in the map message being built, to be copied to
+    // m_current_view and m_current_map_knowledge once it's done.
+    vector<coord_def> m_sent_cells;
+    map_send_stats m_map_stats;
 
     void _send_cursor(cursor_type type);
     void _send_map(bool force_full = false);
@@ -14,7 +14,9 @@
 #include <cctype>
 #include <cstdarg>
 #include <cstdio>
+#include <functional>
 #include <memory>
+#include <queue>
 #include <set>
 #include <sstream>
 
@@ -34,6 +36,7 @@
 #include "format.h"
 #include "god-abil.h"
 #include "god-passive.h"
+#include "hash.h"
 #include "hints.h"
 #include "item-name.h"
 #include "item-prop.h"
@@ -1069,6 +1072,15 @@ static void _fill_exclude_radius(const travel_exclude &exc)
 // travel_pathfind
 
 FixedVector<coord_def, GXM * GYM> travel_pathfind::circumference[2];
+FixedArray<uint8_t, GXM, GYM> travel_pathfind::travelsafe_memo;
+
+enum travelsafe_memo_flag
+{
+    TSM_KNOWN         = 1 << 0,
+    TSM_SAFE          = 1 << 1,
+    TSM_KNOWN_HOSTILE = 1 << 2,
+    TSM_SAFE_HOSTILE  = 1 << 3,
+};
 
 // already defined in header
 // const int travel_pathfind::UNFOUND_DIST;
@@ -1230,6 +1242,7 @@ coord_def travel_pathfind::pathfind(run_mode_type rmode, bool fallback_explore)
     // point_distance will hold the distance of all points from the starting
     // point, i.e. the distance travelled to get there.
     memset(point_distance, 0, sizeof(travel_distance_grid_t));
+    travelsafe_memo.init(0);
 
     if (!in_bounds(start))
         return coord_def();
@@ -1571,7 +1584,7 @@ bool travel_pathfind::path_flood(const coord_def &c, const coord_def &dc)
 
         return true;
     }
-    else if (!_is_travelsafe_square(dc, ignore_hostile, ignore_danger, try_fallback))
+    else if (!is_travelsafe(dc))
     {
         // This point is not okay to travel on, but if this is a
         // trap, we'll want to put it on the feature vector anyway.
@@ -1646,6 +1659,30 @@ bool travel_pathfind::path_flood(const coord_def &c, const coord_def &dc)
     return false;
 }
 
+// Every square is flooded into from up to eight neighbours, and nothing
+// _is_travelsafe_square() looks at changes during a single pathfind() call,
+// so only work it out once per square.
+bool travel_pathfind::is_travelsafe(const coord_def &c)
+{
+    if (!in_bounds(c))
+        return false;
+
+    const uint8_t known = ignore_hostile ? TSM_KNOWN_HOSTILE : TSM_KNOWN;
+    const uint8_t safe  = ignore_hostile ? TSM_SAFE_HOSTILE : TSM_SAFE;
+
+    uint8_t &memo = travelsafe_memo(c);
+    if (!(memo & known))
+    {
+        memo |= known;
+        if (_is_travelsafe_square(c, ignore_hostile, ignore_danger,
+                                  try_fallback))
+        {
+            memo |= safe;
+        }
+    }
+    return memo & safe;
+}
+
 void travel_pathfind::good_square(const coord_def &c)
 {
     if (!point_distance[c.x][c.y])
@@ -2771,11 +2808,34 @@ static int _target_distance_from(const coord_def &pos)
     return -1;
 }
 
+// A point on some level that interlevel travel can reach, queued by the
+// distance travelled to get there.
+struct transtravel_node
+{
+    int distance;
+    unsigned int order;     // Breaks ties in favour of the earliest queued.
+    level_id level;
+    coord_def pos;          // Usually a stair; the player's position at first.
+    coord_def first_stair;  // The stair on the player's level that the route
+                            // starts with, or (-1,-1) for the start itself.
+
+    bool operator > (const transtravel_node &other) const
+    {
+        return distance != other.distance ? distance > other.distance
+                                          : order > other.order;
+    }
+};
+
 /*
  * Sets best_stair to the coordinates of the best stair on the player's current
- * level to take to get to the 'target' level. Should be called with 'distance'
- * set to 0, 'stair' set to (you.x_pos, you.y_pos) and 'best_distance' set to
- * -1. 'cur' should be the player's current level.
+ * level to take to get to the 'target' level, and returns the length of that
+ * route, or -1 if there is none. best_level_distance should be -1 on entry.
+ *
+ * This is a shortest-path search over the stair graph of the travel cache:
+ * walking between two stairs on a level costs the cached stair distance, and
+ * taking a stair costs a flat 500. Levels are expanded in order of distance
+ * from the player, so the search stops as soon as nothing left on the agenda
+ * can beat the best route found.
  *
  * If best_stair remains unchanged when this function returns, there is no
  * travel-safe path between the player's current level and the target level OR
@@ -2788,127 +2848,160 @@ static int _target_distance_from(const coord_def &pos)
  * This function has undefined behaviour when the target position is not
  * traversable.
  */
-static int _find_transtravel_stair(const level_id &cur,
-                                    const level_pos &target,
-                                    int distance,
-                                    // This is actually the current position
-                                    // on cur, not necessarily a stair.
-                                    const coord_def &stair,
-                                    level_id &closest_level,
-                                    int &best_level_distance,
-                                    coord_def &best_stair,
-                                    int search_depth = 0)
-{
-    int local_distance = -1;
-    level_id player_level = level_id::current();
-
-    LevelInfo &li = travel_cache.get_level_info(cur);
-
-    // Have we reached the target level?
-    if (cur == target.id)
-    {
-        // Are we in an exclude? If so, bail out. Unless it is just a stair exclusion.
-        if (is_excluded(stair, li.get_excludes()) && !is_stair_exclusion(stair))
-            return -1;
-
-        // If there's no target position on the target level, or we're on the
-        // target, we're home.
-        if (target.pos.x == -1 || target.pos == stair)
-            return distance;
-
-        // If there *is* a target position, we need to work out our distance
-        // from it.
-        int deltadist = _target_distance_from(stair);
-
-        if (deltadist == -1 && cur == player_level)
-        {
-            // Okay, we don't seem to have a distance available to us, which
-            // means we're either (a) not standing on stairs or (b) whoever
-            // initiated interlevel travel didn't call
-            // _populate_stair_distances. Assuming we're not on stairs, that
-            // situation can arise only if interlevel travel has been triggered
-            // for a location on the same level. If that's the case, we can get
-            // the distance off the travel_point_distance matrix.
-            deltadist = travel_point_distance[target.pos.x][target.pos.y];
-            if (!deltadist && stair != target.pos)
-                deltadist = -1;
-        }
+static int _find_transtravel_stair(const level_pos &target,
+                                   level_id &closest_level,
+                                   int &best_level_distance,
+                                   coord_def &best_stair)
+{
+    const level_id player_level = level_id::current();
+    int best_distance = -1;
 
-        if (deltadist != -1)
+    auto found_route = [&](int distance, const coord_def &first_stair)
+    {
+        if (best_distance == -1 || distance < best_distance)
         {
-            local_distance = distance + deltadist;
-
-            // See if this is a degenerate case of interlevel travel:
-            // A degenerate case of interlevel travel decays to normal travel;
-            // we identify this by checking if:
-            // a. The current level is the target level.
-            // b. The target square is reachable from the 'current' square.
-            // c. The current square is where the player is.
-            //
-            // Note that even if this *is* degenerate, interlevel travel may
-            // still be able to find a shorter route, since it can consider
-            // routes that leave and reenter the current level.
-            if (player_level == target.id && stair == you.pos())
-                best_stair = target.pos;
-
-            // The local_distance is already set, but there may actually be
-            // stairs we can take that'll get us to the target faster than the
-            // direct route, so we also try the stairs.
+            best_distance = distance;
+            if (first_stair.x != -1)
+                best_stair = first_stair;
         }
-    }
+    };
 
-    vector<stair_info> &stairs = li.get_stairs();
+    // level_distance() walks the branch tree each time; many stairs lead to
+    // the same few levels.
+    map<level_id, int> target_level_distance;
 
-    // this_stair being nullptr is perfectly acceptable, since we start with
-    // coords as the player coords, and the player need not be standing on
-    // stairs.
-    stair_info *this_stair = li.get_stair(stair);
+    priority_queue<transtravel_node, vector<transtravel_node>,
+                   greater<transtravel_node>> agenda;
+    unsigned int order = 0;
+    agenda.push({0, order++, player_level, you.pos(), coord_def(-1, -1)});
 
-    if (!this_stair && cur != player_level)
+    while (!agenda.empty())
     {
-        // Whoops, there's no stair in the travel cache for the current
-        // position, and we're not on the player's current level (i.e., there
-        // certainly *should* be a stair here). Since we can't proceed in any
-        // reasonable way, bail out.
-        return local_distance;
-    }
+        const transtravel_node node = agenda.top();
+        agenda.pop();
 
-    for (stair_info &si : stairs)
-    {
-        if (stairs_destination_is_excluded(si))
-            continue;
+        // Nothing left can be reached more cheaply than what we have.
+        if (best_distance != -1 && node.distance >= best_distance)
+            break;
 
-        // Skip placeholders and excluded stairs.
-        if (!si.can_travel() || is_excluded(si.position, li.get_excludes()))
-            continue;
+        const level_id &cur = node.level;
+        // This is actually the current position on cur, not necessarily a
+        // stair.
+        const coord_def &stair = node.pos;
+        const int distance = node.distance;
+        const bool at_start = node.first_stair.x == -1;
 
-        int deltadist = li.distance_between(this_stair, &si);
+        LevelInfo &li = travel_cache.get_level_info(cur);
 
-        if (!this_stair)
+        // this_stair being nullptr is perfectly acceptable, since we start
+        // with coords as the player coords, and the player need not be
+        // standing on stairs.
+        stair_info *this_stair = li.get_stair(stair);
+
+        // Already reached more cheaply since this was queued?
+        if (this_stair && this_stair->distance != -1
+            && this_stair->distance < distance)
+        {
+            continue;
+        }
+
+        // Have we reached the target level?
+        if (cur == target.id)
         {
-            deltadist = travel_point_distance[si.position.x][si.position.y];
-            if (!deltadist && you.pos() != si.position)
-                deltadist = -1;
+            // Are we in an exclude? If so, bail out. Unless it is just a
+            // stair exclusion.
+            if (is_excluded(stair, li.get_excludes())
+                && !is_stair_exclusion(stair))
+            {
+                continue;
+            }
+
+            // If there's no target position on the target level, or we're on
+            // the target, we're home.
+            if (target.pos.x == -1 || target.pos == stair)
+            {
+                found_route(distance, node.first_stair);
+                continue;
+            }
+
+            // If there *is* a target position, we need to work out our
+            // distance from it.
+            int deltadist = _target_distance_from(stair);
+
+            if (deltadist == -1 && cur == player_level)
+            {
+                // Okay, we don't seem to have a distance available to us,
+                // which means we're either (a) not standing on stairs or (b)
+                // whoever initiated interlevel travel didn't call
+                // _populate_stair_distances. Assuming we're not on stairs,
+                // that situation can arise only if interlevel travel has been
+                // triggered for a location on the same level. If that's the
+                // case, we can get the distance off the travel_point_distance
+                // matrix.
+                deltadist = travel_point_distance[target.pos.x][target.pos.y];
+                if (!deltadist && stair != target.pos)
+                    deltadist = -1;
+            }
+
+            // A degenerate case of interlevel travel decays to normal travel:
+            // the target is on the player's level and reachable directly.
+            // Even then, interlevel travel may still be able to find a
+            // shorter route, since it can consider routes that leave and
+            // reenter the current level, so we also try the stairs.
+            if (deltadist != -1)
+            {
+                found_route(distance + deltadist,
+                            at_start ? target.pos : node.first_stair);
+            }
         }
-        // deltadist == 0 is legal (if this_stair is nullptr), since the player
-        // may be standing on the stairs. If two stairs are disconnected,
-        // deltadist has to be negative.
-        if (deltadist < 0)
+
+        if (!this_stair && cur != player_level)
+        {
+            // Whoops, there's no stair in the travel cache for the current
+            // position, and we're not on the player's current level (i.e.,
+            // there certainly *should* be a stair here). Since we can't
+            // proceed in any reasonable way, bail out.
             continue;
+        }
 
-        int dist2stair = distance + deltadist;
-        if (si.distance == -1 || si.distance > dist2stair)
+        for (stair_info &si : li.get_stairs())
         {
+            if (stairs_destination_is_excluded(si))
+                continue;
+
+            // Skip placeholders and excluded stairs.
+            if (!si.can_travel() || is_excluded(si.position, li.get_excludes()))
+                continue;
+
+            int deltadist = li.distance_between(this_stair, &si);
+
+            if (!this_stair)
+            {
+                deltadist = travel_point_distance[si.position.x][si.position.y];
+                if (!deltadist && you.pos() != si.position)
+                    deltadist = -1;
+            }
+            // deltadist == 0 is legal (if this_stair is nullptr), since the
+            // player may be standing on the stairs. If two stairs are
+            // disconnected, deltadist has to be negative.
+            if (deltadist < 0)
+                continue;
+
+            int dist2stair = distance + deltadist;
+            if (si.distance != -1 && si.distance <= dist2stair)
+                continue;
             si.distance = dist2stair;
 
             // Account for the cost of taking the stairs
             dist2stair += 500; // XXX: this seems large?
 
             // Already too expensive? Short-circuit.
-            if (local_distance != -1 && dist2stair >= local_distance)
+            if (best_distance != -1 && dist2stair >= best_distance)
                 continue;
 
             const level_pos &dest = si.destination;
+            const coord_def first_stair = at_start ? si.position
+                                                   : node.first_stair;
 
             // Never use escape hatches as the last leg of the trip, since
             // that will leave the player unable to retrace their path.
@@ -2928,18 +3021,19 @@ static int _find_transtravel_stair(const level_id &cur,
             if (target.pos.x == -1
                 && dest.id == target.id)
             {
-                if (local_distance == -1 || local_distance > dist2stair)
-                {
-                    local_distance = dist2stair;
-                    if (cur == player_level && you.pos() == stair)
-                        best_stair = si.position;
-                }
+                found_route(dist2stair, first_stair);
                 continue;
             }
 
             if (dest.id.depth > -1) // We have a valid level descriptor.
             {
-                int dist = level_distance(dest.id, target.id);
+                auto cached = target_level_distance.find(dest.id);
+                if (cached == target_level_distance.end())
+                {
+                    cached = target_level_distance.emplace(dest.id,
+                                 level_distance(dest.id, target.id)).first;
+                }
+                const int dist = cached->second;
                 if (dist != -1 && (dist < best_level_distance
                                    || best_level_distance == -1))
                 {
@@ -2978,28 +3072,16 @@ static int _find_transtravel_stair(const level_id &cur,
                     continue;   // We've already been here.
             }
 #ifdef DEBUG_TRAVEL
-            string indent(search_depth, '.');
-            dprf("%strying stairs at %d,%d, dest is %d depth %d, pos %d,%d",
-                indent.c_str(), si.position.x, si.position.y, dest.id.branch,
-                dest.id.depth, dest.pos.x, dest.pos.y);
+            dprf("queueing stairs at %d,%d, dest is %d depth %d, pos %d,%d",
+                 si.position.x, si.position.y, dest.id.branch,
+                 dest.id.depth, dest.pos.x, dest.pos.y);
 #endif
 
             // Okay, take these stairs and keep going.
-            const int newdist =
-                _find_transtravel_stair(dest.id, target,
-                                        dist2stair, dest.pos, closest_level,
-                                        best_level_distance, best_stair,
-                                        search_depth + 1);
-            if (newdist != -1
-                && (local_distance == -1 || local_distance > newdist))
-            {
-                local_distance = newdist;
-                if (cur == player_level && you.pos() == stair)
-                    best_stair = si.position;
-            }
+            agenda.push({dist2stair, order++, dest.id, dest.pos, first_stair});
         }
     }
-    return local_distance;
+    return best_distance;
 }
 
 static bool _loadlev_populate_stair_distances(const level_pos &target)
@@ -3034,7 +3116,6 @@ static bool _find_transtravel_square(const level_pos &target, bool verbose)
     level_id current = level_id::current();
 
     coord_def best_stair(-1, -1);
-    coord_def cur_stair(you.pos());
 
     level_id closest_level;
     int best_level_distance = -1;
@@ -3051,9 +3132,8 @@ static bool _find_transtravel_square(const level_pos &target, bool verbose)
 
     if (maybe_traversable)
     {
-        _find_transtravel_stair(current, target,
-                                0, cur_stair, closest_level,
-                                best_level_distance, best_stair);
+        _find_transtravel_stair(target, closest_level, best_level_distance,
+                                best_stair);
         dprf("found stair at %d,%d", best_stair.x, best_stair.y);
     }
     // even without _find_transtravel_stair called, the values are initialized
@@ -3120,6 +3200,19 @@ static bool _find_transtravel_square(const level_pos &target, bool verbose)
     return false;
 }
 
+int interlevel_travel_distance(const level_id &target)
+{
+    coord_def best_stair(-1, -1);
+    level_id closest_level;
+    int best_level_distance = -1;
+    travel_cache.clear_distances();
+
+    find_travel_pos(you.pos(), nullptr, nullptr, nullptr);
+
+    return _find_transtravel_stair(level_pos(target), closest_level,
+                                   best_level_distance, best_stair);
+}
+
 void start_travel(const coord_def& p)
 {
     // Redundant target?
@@ -3383,6 +3476,38 @@ void LevelInfo::update_excludes()
     excludes = curr_excludes;
 }
 
+// Summarises everything the stair distance floods depend on: the stairs
+// themselves, the travel safety of every cell, the known terrain (for
+// transporters and doors), exclusions and known transporter destinations.
+// Must be called with the travel safety grid precomputed.
+static uint64_t _stair_distance_key(const vector<stair_info> &stairs,
+                                    const vector<transporter_info> &trans,
+                                    const exclude_set &excludes)
+{
+    uint64_t key = hash3(stairs.size(), trans.size(), 0);
+    for (const stair_info &si : stairs)
+        key = hash3(key, si.position.x, si.position.y);
+    for (const transporter_info &ti : trans)
+    {
+        key = hash3(key, ti.position.x, ti.position.y);
+        key = hash3(key, ti.destination.x, ti.destination.y);
+    }
+    for (const auto &entry : excludes)
+    {
+        const travel_exclude &ex = entry.second;
+        key = hash3(key, ex.pos.x, ex.pos.y);
+        key = hash3(key, ex.radius, 0);
+    }
+    for (rectangle_iterator ri(1); ri; ++ri)
+    {
+        const coord_def p(*ri);
+        const int safety = _is_travelsafe_square(p, false)
+                           | _is_travelsafe_square(p, true) << 1;
+        key = hash3(key, env.map_knowledge(p).feat(), safety);
+    }
+    return key;
+}
+
 void LevelInfo::update()
 {
     // First, set excludes, so that stair distances will be correctly populated.
@@ -3392,7 +3517,11 @@ void LevelInfo::update()
     vector<coord_def> stair_positions;
     get_stairs(stair_positions);
 
-    // Make sure our stair list is correct.
+    // Make sure our stair list is correct. This throws away the stair
+    // distances, so hang on to them in case nothing has changed.
+    vector<short> old_stair_distances;
+    old_stair_distances.swap(stair_distances);
+    const uint64_t old_key = stair_distance_key;
     correct_stair_list(stair_positions);
 
     sync_all_branch_stairs();
@@ -3402,7 +3531,20 @@ void LevelInfo::update()
     unwind_slime_wall_precomputer slime_wall_neighbours(
         !actor_slime_wall_immune(&you));
     precompute_travel_safety_grid travel_safety_calc;
-    update_stair_distances();
+
+    // Flooding from every stair is the expensive part of an update; only
+    // redo it when the level has changed in a way that could affect the
+    // distances.
+    const uint64_t key = _stair_distance_key(stairs, transporters,
+                                             excludes);
+    if (old_key && key == old_key
+        && old_stair_distances.size() == stair_distances.size())
+    {
+        stair_distances.swap(old_stair_distances);
+    }
+    else
+        update_stair_distances();
+    stair_distance_key = key;
 
     vector<coord_def> transporter_positions;
     get_transporters(transporter_positions);
@@ -3723,6 +3865,9 @@ void LevelInfo::correct_transporter_list(const vector<coord_def> &t)
 void LevelInfo::resize_stair_distances()
 {
     const int nstairs = stairs.size();
+    // Changing the number of stairs scrambles the existing distances.
+    if (stair_distances.size() != (size_t) (nstairs * nstairs))
+        stair_distance_key = 0;
     stair_distances.reserve(nstairs * nstairs);
     stair_distances.resize(nstairs * nstairs, 0);
 }
@@ -3841,6 +3986,7 @@ void LevelInfo::load(reader& inf, int minorVersion)
     }
 
     stair_distances.clear();
+    stair_distance_key = 0;
     if (stair_count)
     {
         stair_distances.reserve(stair_count * stair_count);
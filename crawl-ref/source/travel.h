@@ -100,6 +100,9 @@ void prevent_travel_to(const string &dungeon_feature_name);
 
 // Sort dungeon features as appropriate.
 int level_distance(level_id first, level_id second);
+// The length of the shortest known interlevel travel route from the player to
+// the given level, or -1 if there is none.
+int interlevel_travel_distance(const level_id &target);
 level_id find_deepest_explored(level_id curr);
 bool branch_entered(branch_type branch);
 
@@ -319,7 +322,8 @@ public:
 // Information on a level that interlevel travel needs.
 struct LevelInfo
 {
-    LevelInfo() : stairs(), excludes(), stair_distances(), id()
+    LevelInfo() : stairs(), excludes(), stair_distances(),
+                  stair_distance_key(0), id()
     {
         daction_counters.init(0);
     }
@@ -397,6 +401,9 @@ private:
     exclude_set excludes;
 
     vector<short> stair_distances;  // Dist between stairs
+    // What the level looked like when stair_distances was last computed;
+    // not saved, so the first update after loading always recomputes.
+    uint64_t stair_distance_key;
     level_id id;
 
     friend class TravelCache;
@@ -544,6 +551,7 @@ protected:
     virtual bool point_traverse_delay(const coord_def &c);
     virtual bool path_flood(const coord_def &c, const coord_def &dc);
     bool square_slows_movement(const coord_def &c);
+    bool is_travelsafe(const coord_def &c);
     void check_square_greed(const coord_def &c);
     void good_square(const coord_def &c);
 
@@ -625,6 +633,11 @@ protected:
     // re-entrant or thread-safe.
     static FixedVector<coord_def, GXM * GYM> circumference[2];
 
+    // Memoised results of _is_travelsafe_square() for the current pathfind()
+    // call, one bit pair for each setting of ignore_hostile. Cleared at the
+    // start of each pathfind() call.
+    static FixedArray<uint8_t, GXM, GYM> travelsafe_memo;
+
     // Attempt to path through temporary obstructions (like sealed doors)
     // due to the possibility they are no longer obstructing us
     bool try_fallback;
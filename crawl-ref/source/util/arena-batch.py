@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+
+"""
+Run a batch of arena matchups in parallel and collect the results.
+
+The matchups file has one arena specification per line, as given to
+"crawl -arena"; blank lines and lines starting with # are ignored. Each
+matchup runs in its own crawl process, with a seed derived from the base seed
+and the specification, so rerunning a batch reproduces the same fights.
+
+The report is written after every finished matchup, as CSV or JSON depending
+on its extension. With --resume, matchups that already have a successful
+result in the report are not run again.
+
+Run from the source directory, e.g.:
+
+    util/arena-batch.py -j 8 -t 20 matchups.txt -o results.csv
+"""
+
+import argparse
+import csv
+import fcntl
+import json
+import os
+import pty
+import re
+import select
+import struct
+import subprocess
+import sys
+import tempfile
+import termios
+import time
+import zlib
+from concurrent.futures import ThreadPoolExecutor, as_completed
+
+FIELDS = ['spec', 'seed', 'status', 'trials', 'a_wins', 'b_wins', 'ties',
+          'a_win_rate', 'mean_turns', 'fight_ms', 'wall_ms', 'error']
+
+TRIAL_RE = re.compile(r'^trial (\d+): (a|b|tie) (\d+) turns (\d+) ms$')
+SCORE_RE = re.compile(r'^(\d+)-(\d+)(?:-(\d+))?$')
+
+
+def read_matchups(path):
+    matchups = []
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line and not line.startswith('#'):
+                matchups.append(line)
+    return matchups
+
+
+def matchup_seed(base_seed, spec):
+    return (base_seed + zlib.crc32(spec.encode('utf-8'))) % (1 << 63)
+
+
+def run_crawl(args, timeout):
+    """Run crawl on a pseudo-terminal of its own, discarding the screen.
+
+    Returns the exit status, or None if it had to be killed.
+    """
+    master, slave = pty.openpty()
+    fcntl.ioctl(slave, termios.TIOCSWINSZ, struct.pack('HHHH', 24, 80, 0, 0))
+    env = dict(os.environ, TERM=os.environ.get('TERM', 'xterm'))
+    proc = subprocess.Popen(args, stdin=slave, stdout=slave,
+                            stderr=subprocess.DEVNULL, env=env,
+                            start_new_session=True)
+    os.close(slave)
+
+    deadline = time.time() + timeout if timeout else None
+    try:
+        while proc.poll() is None:
+            if deadline and time.time() > deadline:
+                proc.kill()
+                proc.wait()
+                return None
+            ready, _, _ = select.select([master], [], [], 1.0)
+            if ready:
+                try:
+                    os.read(master, 65536)
+                except OSError:
+                    # The other end has gone away.
+                    proc.wait()
+        return proc.returncode
+    finally:
+        os.close(master)
+
+
+def parse_result(path, row):
+    trials = []
+    try:
+        with open(path) as f:
+            lines = [l.strip() for l in f]
+    except IOError:
+        lines = []
+
+    for line in lines:
+        m = TRIAL_RE.match(line)
+        if m:
+            trials.append((m.group(2), int(m.group(3)), int(m.group(4))))
+        elif line.startswith('err: '):
+            row['status'] = 'error'
+            row['error'] = line[len('err: '):]
+        else:
+            m = SCORE_RE.match(line)
+            if m:
+                row['a_wins'] = int(m.group(1))
+                row['b_wins'] = int(m.group(2))
+                row['ties'] = int(m.group(3) or 0)
+
+    if trials:
+        row['trials'] = len(trials)
+        row['mean_turns'] = round(sum(t[1] for t in trials)
+                                  / float(len(trials)), 1)
+        row['fight_ms'] = sum(t[2] for t in trials)
+        if 'a_wins' not in row:
+            row['a_wins'] = sum(1 for t in trials if t[0] == 'a')
+            row['b_wins'] = sum(1 for t in trials if t[0] == 'b')
+            row['ties'] = sum(1 for t in trials if t[0] == 'tie')
+        row['a_win_rate'] = round(row['a_wins'] / float(len(trials)), 4)
+    elif row['status'] == 'ok':
+        row['status'] = 'error'
+        row['error'] = 'no results'
+
+
+def run_matchup(opts, spec):
+    seed = matchup_seed(opts.seed, spec)
+    arena_spec = spec
+    if opts.trials and not re.search(r'(^|\s)t:\d+', spec):
+        arena_spec = 't:%d %s' % (opts.trials, arena_spec)
+    if 'delay:' not in spec:
+        arena_spec = 'delay:0 ' + arena_spec
+
+    row = {'spec': spec, 'seed': seed, 'status': 'ok', 'error': ''}
+    with tempfile.TemporaryDirectory(prefix='arena-batch-') as tmp:
+        result = os.path.join(tmp, 'arena.result')
+        args = [opts.crawl, '-arena', arena_spec, '-seed', str(seed),
+                '-no-save',
+                '-extra-opt-last', 'arena_result_file=' + result,
+                '-extra-opt-last', 'arena_dump_trials=true'] + opts.crawl_args
+
+        start = time.time()
+        status = run_crawl(args, opts.timeout)
+        row['wall_ms'] = int((time.time() - start) * 1000)
+
+        parse_result(result, row)
+        if status is None:
+            row['status'] = 'timeout'
+            row['error'] = 'killed after %d s' % opts.timeout
+        elif status < 0:
+            row['status'] = 'crash'
+            row['error'] = 'killed by signal %d' % -status
+    return row
+
+
+def load_report(path):
+    if not os.path.exists(path):
+        return []
+    with open(path) as f:
+        if path.endswith('.json'):
+            return json.load(f)
+        return list(csv.DictReader(f))
+
+
+def write_report(path, rows):
+    tmp = path + '.tmp'
+    with open(tmp, 'w') as f:
+        if path.endswith('.json'):
+            json.dump(rows, f, indent=2)
+            f.write('\n')
+        else:
+            writer = csv.DictWriter(f, FIELDS, restval='')
+            writer.writeheader()
+            writer.writerows(rows)
+    os.replace(tmp, path)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run a batch of arena matchups in parallel.')
+    parser.add_argument('matchups', help='file with one arena spec per line')
+    parser.add_argument('-o', '--report', default='arena-batch.csv',
+                        help='report file, .csv or .json '
+                             '(default: %(default)s)')
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(),
+                        help='number of crawl processes to run at once')
+    parser.add_argument('-t', '--trials', type=int, default=0,
+                        help='rounds per matchup, unless the spec has t:N')
+    parser.add_argument('-s', '--seed', type=int, default=1,
+                        help='base seed (default: %(default)s)')
+    parser.add_argument('--timeout', type=int, default=0,
+                        help='seconds before a matchup is killed')
+    parser.add_argument('--crawl', default='./crawl',
+                        help='crawl binary (default: %(default)s)')
+    parser.add_argument('--resume', action='store_true',
+                        help='skip matchups already finished in the report')
+    parser.add_argument('crawl_args', nargs='*',
+                        help='extra arguments for crawl, after --')
+    opts = parser.parse_args()
+
+    matchups = read_matchups(opts.matchups)
+    rows = []
+    if opts.resume:
+        rows = [r for r in load_report(opts.report) if r['status'] == 'ok'
+                and int(r['seed']) == matchup_seed(opts.seed, r['spec'])]
+    done = set(r['spec'] for r in rows)
+    todo = [m for m in matchups if m not in done]
+
+    print('%d matchups, %d to run with %d jobs'
+          % (len(matchups), len(todo), opts.jobs), file=sys.stderr)
+
+    order = {m: i for i, m in enumerate(matchups)}
+    failed = 0
+    with ThreadPoolExecutor(max_workers=opts.jobs) as pool:
+        futures = [pool.submit(run_matchup, opts, m) for m in todo]
+        for n, future in enumerate(as_completed(futures), 1):
+            row = future.result()
+            rows.append(row)
+            rows.sort(key=lambda r: order.get(r['spec'], len(order)))
+            write_report(opts.report, rows)
+            if row['status'] != 'ok':
+                failed += 1
+            print('[%d/%d] %s: %s %s' % (n, len(todo), row['spec'],
+                                         row['status'],
+                                         row.get('a_win_rate', '')),
+                  file=sys.stderr)
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
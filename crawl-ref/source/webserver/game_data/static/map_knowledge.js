@@ -197,11 +197,57 @@ define(["jquery", "./enums", "./util"], function ($, enums, util) {
 
     }
 
+    // Packed cells are [mask, fields..., rest]; see cell_field in
+    // tileweb.h for the order of the fields.
+    var packed_fields = [["x"], ["y"], ["f"], ["mf"], ["g"], ["col"],
+                         ["t", "fg"], ["t", "base"], ["t", "bg"],
+                         ["t", "flv", "f"], ["t", "flv", "s"]];
+
+    function unpack_cell(packed, skip_pos)
+    {
+        var mask = packed[0], i = 1, val = {};
+        for (var n = 0; n < packed_fields.length; ++n)
+        {
+            if (!(mask & (1 << n)))
+                continue;
+            var v = packed[i++];
+            if (skip_pos && n < 2)
+                continue;
+            var path = packed_fields[n], obj = val;
+            for (var k = 0; k < path.length - 1; ++k)
+                obj = obj[path[k]] = obj[path[k]] || {};
+            obj[path[path.length - 1]] = v;
+        }
+
+        var rest = packed[i];
+        for (var prop in rest)
+        {
+            if (prop == "t")
+                val.t = $.extend(val.t || {}, rest.t);
+            else
+                val[prop] = rest[prop];
+        }
+        return val;
+    }
+
     function merge_diff(vals)
     {
+        var last_packed;
         $.each(vals, function (i, val)
                {
-                   merge(val);
+                   if (typeof val === "number")
+                   {
+                       // The previous cell, repeated for the next val cells
+                       for (var n = 0; n < val; ++n)
+                           merge(unpack_cell(last_packed, true));
+                   }
+                   else if ($.isArray(val))
+                   {
+                       last_packed = val;
+                       merge(unpack_cell(val, false));
+                   }
+                   else
+                       merge(val);
                });
 
         clean_monster_table();
@@ -710,8 +710,8 @@ static void _debug_destroy_doors()
 // c) Suppresses monster generation.
 // d) Converts all closed doors to floor.
 // e) Forgets map.
-// f) Counts number of turns needed to explore the level.
-void debug_test_explore()
+// f) Counts number of turns needed to explore the level, and returns it.
+int debug_test_explore()
 {
     wizard_dismiss_all_monsters(true);
     _debug_kill_traps();
@@ -728,6 +728,7 @@ void debug_test_explore()
     you.moveto(where);
 
     mprf("Explore took %d turns.", explore_turns);
+    return explore_turns;
 }
 
 void wizard_list_levels()
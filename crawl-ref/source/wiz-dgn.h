@@ -27,7 +27,7 @@ bool debug_make_trap(const coord_def& pos = you.pos());
 bool debug_make_shop(const coord_def& pos = you.pos());
 void debug_place_map(bool primary);
 void wizard_primary_vault();
-void debug_test_explore();
+int debug_test_explore();
 void wizard_abyss_speed();
 
 bool is_wizard_travel_target(const level_id l);
@@ -8,6 +8,10 @@
 #include "wiz-fsim.h"
 
 #include <cerrno>
+#ifdef UNIX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #include "beam.h"
 #include "bitary.h"
@@ -33,6 +37,7 @@
 #include "output.h"
 #include "player-equip.h"
 #include "player.h"
+#include "random.h"
 #include "ranged-attack.h"
 #include "skills.h"
 #include "species.h"
@@ -429,6 +434,139 @@ static void _do_one_fsim_round(monster &mon, fight_data &fd, bool defend)
     you.move_to_pos(you_start_pos);
 }
 
+// Runs one share of the rounds of a split simulation, on its own stream of
+// the random number generator, and adds the results to fdata.
+static void _do_fsim_batch(monster &mon, fight_data &fdata, int rounds,
+                           bool defend, uint64_t seed, int batch)
+{
+    rng::subgenerator stream(seed, batch);
+    for (int i = 0; i < rounds; i++)
+        _do_one_fsim_round(mon, fdata, defend);
+}
+
+#ifdef UNIX
+// The parts of a fight_damage_stats that rounds accumulate, as passed back
+// from a forked simulation.
+struct fsim_raw_stats
+{
+    unsigned int cumulative_damage;
+    int time_taken;
+    int hits;
+    int max_dam;
+
+    fsim_raw_stats() = default;
+    fsim_raw_stats(const fight_damage_stats &stats)
+        : cumulative_damage(stats.cumulative_damage),
+          time_taken(stats.time_taken), hits(stats.hits),
+          max_dam(stats.max_dam)
+    {
+    }
+
+    void add_to(fight_damage_stats &stats) const
+    {
+        fight_damage_stats part(stats.attacker);
+        part.cumulative_damage = cumulative_damage;
+        part.time_taken = time_taken;
+        part.hits = hits;
+        part.max_dam = max_dam;
+        stats.merge(part);
+    }
+};
+
+/**
+ * Split the rounds of a simulation between Options.fsim_jobs copies of the
+ * game: every batch but the first runs in a forked child, starting from the
+ * same player and monster as the first, and reports back through a pipe.
+ * Each batch draws from its own stream of the random number generator, so
+ * the results don't depend on how the batches are scheduled.
+ */
+static void _do_fsim_batches(monster &mon, fight_data &fdata, int iter_limit,
+                             bool defend)
+{
+    if (iter_limit < 1)
+        return;
+
+    const int jobs = min(Options.fsim_jobs, iter_limit);
+    const uint64_t seed = rng::get_uint64();
+
+    struct child_batch
+    {
+        pid_t pid;
+        int fd;
+        int batch;
+    };
+    vector<child_batch> children;
+    vector<int> leftover;
+
+    fflush(nullptr);
+    for (int batch = 1; batch < jobs; batch++)
+    {
+        const int rounds = iter_limit / jobs + (batch < iter_limit % jobs);
+        int fds[2];
+        const bool piped = !pipe(fds);
+        const pid_t pid = piped ? fork() : -1;
+        if (pid == 0)
+        {
+            close(fds[0]);
+            fight_data part;
+            _do_fsim_batch(mon, part, rounds, defend, seed, batch);
+            const fsim_raw_stats raw[2] = { part.player, part.monster };
+            const bool ok = write(fds[1], raw, sizeof(raw)) == sizeof(raw);
+            _exit(ok ? 0 : 1);
+        }
+        else if (pid == -1)
+        {
+            if (piped)
+            {
+                close(fds[0]);
+                close(fds[1]);
+            }
+            leftover.push_back(batch);
+        }
+        else
+        {
+            close(fds[1]);
+            children.push_back({pid, fds[0], batch});
+        }
+    }
+
+    _do_fsim_batch(mon, fdata, iter_limit / jobs + (0 < iter_limit % jobs),
+                   defend, seed, 0);
+
+    for (const child_batch &child : children)
+    {
+        fsim_raw_stats raw[2];
+        size_t got = 0;
+        while (got < sizeof(raw))
+        {
+            const ssize_t n = read(child.fd, (char *) raw + got,
+                                   sizeof(raw) - got);
+            if (n > 0)
+                got += n;
+            else if (n == 0 || errno != EINTR)
+                break;
+        }
+        close(child.fd);
+        waitpid(child.pid, nullptr, 0);
+
+        if (got == sizeof(raw))
+        {
+            raw[0].add_to(fdata.player);
+            raw[1].add_to(fdata.monster);
+        }
+        else
+            leftover.push_back(child.batch);
+    }
+
+    // Anything that couldn't be forked or didn't report back runs here.
+    for (int batch : leftover)
+    {
+        const int rounds = iter_limit / jobs + (batch < iter_limit % jobs);
+        _do_fsim_batch(mon, fdata, rounds, defend, seed, batch);
+    }
+}
+#endif
+
 static fight_data _get_fight_data(monster &mon, int iter_limit, bool defend)
 {
     const monster orig = mon;
@@ -449,6 +587,11 @@ static fight_data _get_fight_data(monster &mon, int iter_limit, bool defend)
     {
         msg::suppress mx;
 
+#ifdef UNIX
+        if (Options.fsim_jobs > 1)
+            _do_fsim_batches(mon, fdata, iter_limit, defend);
+        else
+#endif
         for (int i = 0; i < iter_limit; i++)
             _do_one_fsim_round(mon, fdata, defend);
     }
@@ -466,6 +609,14 @@ void fight_damage_stats::damage(int amount)
         max_dam = amount;
 }
 
+void fight_damage_stats::merge(const fight_damage_stats &other)
+{
+    cumulative_damage += other.cumulative_damage;
+    time_taken += other.time_taken;
+    hits += other.hits;
+    max_dam = max(max_dam, other.max_dam);
+}
+
 void fight_damage_stats::calc_output_stats()
 {
     av_hit_dam = hits ? double(cumulative_damage) / hits : 0.0;
@@ -19,6 +19,7 @@ struct fight_damage_stats
 
     void calc_output_stats();
     void damage(int amount);
+    void merge(const fight_damage_stats &other);
 
     string summary(const string prefix, bool tsv);
 
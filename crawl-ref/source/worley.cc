@@ -69,9 +69,11 @@ namespace worley
             double at[3], double *F,
             double (*delta)[3], uint32_t *ID);
 
-    /* The main function! */
+    /* The main function! add_samples is AddSamples, or something that gives
+       the same results for a cube. */
+    template <typename AddFn>
     static void _worley(double at[3], int32_t max_order,
-            double *F, double (*delta)[3], uint32_t *ID)
+            double *F, double (*delta)[3], uint32_t *ID, AddFn &add_samples)
     {
         double x2,y2,z2, mx2, my2, mz2;
         double new_at[3];
@@ -107,7 +109,7 @@ namespace worley
            speed of the algorithm. */
 
         /* Test the central cube for closest point(s). */
-        AddSamples(int_at[0], int_at[1], int_at[2], max_order, new_at, F, delta, ID);
+        add_samples(int_at[0], int_at[1], int_at[2], max_order, new_at, F, delta, ID);
 
         /* We test if neighbor cubes are even POSSIBLE contributors by examining the
            combinations of the sum of the squared distances from the cube's lower
@@ -124,62 +126,62 @@ namespace worley
 
         /* Test 6 facing neighbors of center cube. These are closest and most
            likely to have a close feature point. */
-        if (x2<F[max_order-1])  AddSamples(int_at[0]-1, int_at[1]  , int_at[2]  ,
+        if (x2<F[max_order-1])  add_samples(int_at[0]-1, int_at[1]  , int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (y2<F[max_order-1])  AddSamples(int_at[0]  , int_at[1]-1, int_at[2]  ,
+        if (y2<F[max_order-1])  add_samples(int_at[0]  , int_at[1]-1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (z2<F[max_order-1])  AddSamples(int_at[0]  , int_at[1]  , int_at[2]-1,
+        if (z2<F[max_order-1])  add_samples(int_at[0]  , int_at[1]  , int_at[2]-1,
                 max_order, new_at, F, delta, ID);
 
-        if (mx2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]  , int_at[2]  ,
+        if (mx2<F[max_order-1]) add_samples(int_at[0]+1, int_at[1]  , int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (my2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]+1, int_at[2]  ,
+        if (my2<F[max_order-1]) add_samples(int_at[0]  , int_at[1]+1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (mz2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]  , int_at[2]+1,
+        if (mz2<F[max_order-1]) add_samples(int_at[0]  , int_at[1]  , int_at[2]+1,
                 max_order, new_at, F, delta, ID);
 
         /* Test 12 "edge cube" neighbors if necessary. They're next closest. */
-        if ( x2+ y2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]-1, int_at[2]  ,
+        if ( x2+ y2<F[max_order-1]) add_samples(int_at[0]-1, int_at[1]-1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if ( x2+ z2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]  , int_at[2]-1,
+        if ( x2+ z2<F[max_order-1]) add_samples(int_at[0]-1, int_at[1]  , int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if ( y2+ z2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]-1, int_at[2]-1,
+        if ( y2+ z2<F[max_order-1]) add_samples(int_at[0]  , int_at[1]-1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+my2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]+1, int_at[2]  ,
+        if (mx2+my2<F[max_order-1]) add_samples(int_at[0]+1, int_at[1]+1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (mx2+mz2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]  , int_at[2]+1,
+        if (mx2+mz2<F[max_order-1]) add_samples(int_at[0]+1, int_at[1]  , int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if (my2+mz2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]+1, int_at[2]+1,
+        if (my2+mz2<F[max_order-1]) add_samples(int_at[0]  , int_at[1]+1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if ( x2+my2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]+1, int_at[2]  ,
+        if ( x2+my2<F[max_order-1]) add_samples(int_at[0]-1, int_at[1]+1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if ( x2+mz2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]  , int_at[2]+1,
+        if ( x2+mz2<F[max_order-1]) add_samples(int_at[0]-1, int_at[1]  , int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if ( y2+mz2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]-1, int_at[2]+1,
+        if ( y2+mz2<F[max_order-1]) add_samples(int_at[0]  , int_at[1]-1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+ y2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]-1, int_at[2]  ,
+        if (mx2+ y2<F[max_order-1]) add_samples(int_at[0]+1, int_at[1]-1, int_at[2]  ,
                 max_order, new_at, F, delta, ID);
-        if (mx2+ z2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]  , int_at[2]-1,
+        if (mx2+ z2<F[max_order-1]) add_samples(int_at[0]+1, int_at[1]  , int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if (my2+ z2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]+1, int_at[2]-1,
+        if (my2+ z2<F[max_order-1]) add_samples(int_at[0]  , int_at[1]+1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
 
         /* Final 8 "corner" cubes */
-        if ( x2+ y2+ z2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]-1, int_at[2]-1,
+        if ( x2+ y2+ z2<F[max_order-1]) add_samples(int_at[0]-1, int_at[1]-1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if ( x2+ y2+mz2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]-1, int_at[2]+1,
+        if ( x2+ y2+mz2<F[max_order-1]) add_samples(int_at[0]-1, int_at[1]-1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if ( x2+my2+ z2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]+1, int_at[2]-1,
+        if ( x2+my2+ z2<F[max_order-1]) add_samples(int_at[0]-1, int_at[1]+1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if ( x2+my2+mz2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]+1, int_at[2]+1,
+        if ( x2+my2+mz2<F[max_order-1]) add_samples(int_at[0]-1, int_at[1]+1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+ y2+ z2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]-1, int_at[2]-1,
+        if (mx2+ y2+ z2<F[max_order-1]) add_samples(int_at[0]+1, int_at[1]-1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+ y2+mz2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]-1, int_at[2]+1,
+        if (mx2+ y2+mz2<F[max_order-1]) add_samples(int_at[0]+1, int_at[1]-1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+my2+ z2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]+1, int_at[2]-1,
+        if (mx2+my2+ z2<F[max_order-1]) add_samples(int_at[0]+1, int_at[1]+1, int_at[2]-1,
                 max_order, new_at, F, delta, ID);
-        if (mx2+my2+mz2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]+1, int_at[2]+1,
+        if (mx2+my2+mz2<F[max_order-1]) add_samples(int_at[0]+1, int_at[1]+1, int_at[2]+1,
                 max_order, new_at, F, delta, ID);
 
         /* We're done! Convert everything to right size scale */
@@ -194,13 +196,26 @@ namespace worley
         return;
     }
 
-    static void AddSamples(int32_t xi, int32_t yi, int32_t zi, int32_t max_order,
-            double at[3], double *F,
-            double (*delta)[3], uint32_t *ID)
+    /* The feature points of one cube: their IDs, and their positions with
+       the cube's own coordinates already added in. */
+    struct cube_points
+    {
+        int32_t xi, yi, zi;
+        int32_t count;
+        uint32_t id[5];
+        double pos[5][3];
+    };
+
+    static void CubePoints(int32_t xi, int32_t yi, int32_t zi,
+            cube_points &cube)
     {
-        double dx, dy, dz, fx, fy, fz, d2;
-        int32_t count, i, j, index;
-        uint32_t seed, this_id;
+        int32_t j;
+        uint32_t seed;
+        double fx, fy, fz;
+
+        cube.xi = xi;
+        cube.yi = yi;
+        cube.zi = zi;
 
         /* Each cube has a random number seed based on the cube's ID number.
            The seed might be better if it were a nonlinear hash like Perlin uses
@@ -209,13 +224,13 @@ namespace worley
         seed=702395077*xi + 915488749*yi + 2120969693*zi;
 
         /* How many feature points are in this cube? */
-        count=Poisson_count[(seed>>24)%256]; /* 256 element lookup table. Use MSB */
+        cube.count=Poisson_count[(seed>>24)%256]; /* 256 element lookup table. Use MSB */
 
         seed=1402024253*seed+586950981; /* churn the seed with good Knuth LCG */
 
-        for (j=0; j<count; j++) /* test and insert each point into our solution */
+        for (j=0; j<cube.count; j++)
         {
-            this_id=seed;
+            cube.id[j]=seed;
             seed=1402024253*seed+586950981; /* churn */
 
             /* compute the 0..1 feature point location's XYZ */
@@ -226,10 +241,25 @@ namespace worley
             fz=(seed+0.5)*(1.0/4294967296.0);
             seed=1402024253*seed+586950981; /* churn */
 
+            cube.pos[j][0]=xi+fx;
+            cube.pos[j][1]=yi+fy;
+            cube.pos[j][2]=zi+fz;
+        }
+    }
+
+    static void AddCube(const cube_points &cube, int32_t max_order,
+            double at[3], double *F,
+            double (*delta)[3], uint32_t *ID)
+    {
+        double dx, dy, dz, d2;
+        int32_t i, j, index;
+
+        for (j=0; j<cube.count; j++) /* test and insert each point into our solution */
+        {
             /* delta from feature point to sample location */
-            dx=xi+fx-at[0];
-            dy=yi+fy-at[1];
-            dz=zi+fz-at[2];
+            dx=cube.pos[j][0]-at[0];
+            dy=cube.pos[j][1]-at[1];
+            dz=cube.pos[j][2]-at[2];
 
             /* Distance computation!  Lots of interesting variations are
                possible here!
@@ -271,7 +301,7 @@ cases.]
                 }
                 /* Insert the new point's information into the list. */
                 F[index]=d2;
-                ID[index]=this_id;
+                ID[index]=cube.id[j];
                 delta[index][0]=dx;
                 delta[index][1]=dy;
                 delta[index][2]=dz;
@@ -281,15 +311,51 @@ cases.]
         return;
     }
 
-    noise_datum noise(double x, double y, double z)
+    static void AddSamples(int32_t xi, int32_t yi, int32_t zi, int32_t max_order,
+            double at[3], double *F,
+            double (*delta)[3], uint32_t *ID)
     {
-        double point[3] = {x,y,z};
-        double F[2];
-        double delta[2][3];
-        uint32_t id[2];
+        cube_points cube;
+        CubePoints(xi, yi, zi, cube);
+        AddCube(cube, max_order, at, F, delta, ID);
+    }
+
+    /* A stand-in for AddSamples that remembers the feature points of the
+       cubes it has seen. Nearby sample points search mostly the same cubes,
+       so a batch of them only needs to work out each cube's points once. */
+    class cube_cache
+    {
+    public:
+        cube_cache() : cubes(SLOTS)
+        {
+            for (cube_points &cube : cubes)
+                cube.count = -1;
+        }
 
-        _worley(point, 2, F, delta, id);
+        void operator()(int32_t xi, int32_t yi, int32_t zi,
+                int32_t max_order, double at[3], double *F,
+                double (*delta)[3], uint32_t *ID)
+        {
+            const uint32_t slot = ((uint32_t) xi * 73856093u
+                                   ^ (uint32_t) yi * 19349663u
+                                   ^ (uint32_t) zi * 83492791u) % SLOTS;
+            cube_points &cube = cubes[slot];
+            if (cube.count < 0 || cube.xi != xi || cube.yi != yi
+                || cube.zi != zi)
+            {
+                CubePoints(xi, yi, zi, cube);
+            }
+            AddCube(cube, max_order, at, F, delta, ID);
+        }
+
+    private:
+        static const uint32_t SLOTS = 256;
+        vector<cube_points> cubes;
+    };
 
+    static noise_datum _to_datum(const double *F, double (*delta)[3],
+            const uint32_t *id)
+    {
         noise_datum datum;
         datum.distance[0] = F[0];
         datum.distance[1] = F[1];
@@ -300,4 +366,31 @@ cases.]
                 datum.pos[i][j] = delta[i][j];
         return datum;
     }
+
+    noise_datum noise(double x, double y, double z)
+    {
+        double point[3] = {x,y,z};
+        double F[2];
+        double delta[2][3];
+        uint32_t id[2];
+
+        _worley(point, 2, F, delta, id, AddSamples);
+        return _to_datum(F, delta, id);
+    }
+
+    void noise_many(const double *x, const double *y, const double *z,
+                    size_t count, noise_datum *out)
+    {
+        cube_cache cubes;
+        double F[2];
+        double delta[2][3];
+        uint32_t id[2];
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            double point[3] = {x[i], y[i], z[i]};
+            _worley(point, 2, F, delta, id, cubes);
+            out[i] = _to_datum(F, delta, id);
+        }
+    }
 }
@@ -59,6 +59,7 @@
    computation. The book lists the details of this tuning.  */
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 namespace worley
@@ -71,4 +72,10 @@ struct noise_datum
 };
 
 noise_datum noise(double x, double y, double z);
+
+// The noise at count points, the same as noise() would give for each. Points
+// close together share work, so this is much cheaper for a batch of
+// neighbouring points, such as a row of map cells, than calling noise().
+void noise_many(const double *x, const double *y, const double *z,
+                size_t count, noise_datum *out);
 }